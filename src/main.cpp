@@ -1,15 +1,78 @@
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <ctime>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
 #include <future>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <random>
+#include <string>
 #include <syncstream>
 #include <thread>
 #include <vector>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#include "thread_pool/chase_lev_deque.h"
 #include "thread_pool/coro_warmup.h"
+#include "thread_pool/cpu_topology.h"
 #include "thread_pool/fast_test.h"
+#include "thread_pool/mpmc_queue.h"
+#include "thread_pool/parallel_algorithms.h"
+#include "thread_pool/producer_cursor.h"
+#include "thread_pool/task_graph.h"
+#include "thread_pool/task_group.h"
 #include "thread_pool/thread_pool.h"
 #include "thread_pool/thread_pool_fast.h"
 #include "thread_pool/thread_pool_priority.h"
+#include "thread_pool/thread_sched.h"
+#include "thread_pool/timer_wheel.h"
+#include "thread_pool/worker_arena.h"
+
+// ============================================
+// Allocation Counting
+// ============================================
+
+// 替换全局 operator new，统计整个进程的堆分配次数 (用于衡量每次 submit 的分配开销)
+std::atomic<size_t> g_allocations{0};
+
+// GCC 看不出 new/delete 是成对替换的，会误报 malloc/free 与 new/delete 不匹配
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+size_t allocation_count() {
+    return g_allocations.load(std::memory_order_relaxed);
+}
 
 // ============================================
 // Benchmarking Utils (Retained)
@@ -29,7 +92,7 @@ void heavy_work() {
 void benchmark_fast_pool(size_t num_threads) {
     std::cout << "Testing ThreadPoolFast (" << num_threads << " threads)...\n";
     ThreadPoolFast pool(num_threads);
-    std::vector<std::future<void>> results;
+    std::vector<parallel::Future<void>> results;
     results.reserve(NUM_TASKS);
 
     auto start = std::chrono::high_resolution_clock::now();
@@ -46,6 +109,1159 @@ void benchmark_fast_pool(size_t num_threads) {
               << " tasks/s\n";
 }
 
+// 同样的负载，开启延迟统计: 对比吞吐量，并输出排队时间/执行时间的分位数
+void benchmark_latency_tracking(size_t num_threads) {
+    std::cout << "Testing latency tracking on ThreadPoolFast (" << num_threads
+              << " threads)...\n";
+    auto us = [](std::chrono::nanoseconds ns) {
+        return std::chrono::duration<double, std::micro>(ns).count();
+    };
+    for (bool tracking : {false, true}) {
+        ThreadPoolFast pool(num_threads);
+        pool.set_latency_tracking(tracking);
+        std::vector<parallel::Future<void>> results;
+        results.reserve(NUM_TASKS);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < NUM_TASKS; ++i) {
+            results.emplace_back(pool.submit(heavy_work));
+        }
+        for (auto& res : results) {
+            res.get();
+        }
+        std::chrono::duration<double> diff =
+            std::chrono::high_resolution_clock::now() - start;
+        std::cout << "  -> tracking " << (tracking ? "on:  " : "off: ")
+                  << (NUM_TASKS / diff.count()) << " tasks/s\n";
+        if (tracking) {
+            auto latency = pool.latency().total;
+            std::cout << "     queue wait p50/p99/p999: "
+                      << us(latency.queue_wait.p50()) << " / "
+                      << us(latency.queue_wait.p99()) << " / "
+                      << us(latency.queue_wait.p999()) << " us\n"
+                      << "     run time   p50/p99/p999: "
+                      << us(latency.run_time.p50()) << " / "
+                      << us(latency.run_time.p99()) << " / "
+                      << us(latency.run_time.p999()) << " us\n";
+        }
+    }
+}
+
+// 只有副作用的 void 任务: submit (丢弃 Future) 与 post 的提交开销对比
+// 任务本身几乎为空，差别主要来自共享状态的引用计数与完成通知
+template <typename Submit, typename Post>
+void measure_post_vs_submit(const char* submit_name, Submit&& submit,
+                            const char* post_name, Post&& post) {
+    for (bool use_post : {false, true}) {
+        std::atomic<int> done{0};
+        auto job = [&done] { done.fetch_add(1, std::memory_order_relaxed); };
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < NUM_TASKS; ++i) {
+            if (use_post) {
+                post(job);
+            } else {
+                submit(job);
+            }
+        }
+        auto submitted = std::chrono::high_resolution_clock::now();
+        while (done.load(std::memory_order_relaxed) < NUM_TASKS) {
+            std::this_thread::yield();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::chrono::duration<double, std::nano> per_call =
+            (submitted - start) / NUM_TASKS;
+        std::chrono::duration<double> total = end - start;
+        std::cout << "  -> " << (use_post ? post_name : submit_name) << ": "
+                  << per_call.count() << " ns/call, total " << total.count()
+                  << "s\n";
+    }
+}
+
+void benchmark_post_vs_submit(size_t num_threads) {
+    std::cout << "Comparing submit vs post for void tasks (" << num_threads
+              << " threads)...\n";
+    {
+        ThreadPoolFast pool(num_threads);
+        measure_post_vs_submit(
+            "ThreadPoolFast::submit",
+            [&](auto& job) { (void)pool.submit(job); },
+            "ThreadPoolFast::post  ", [&](auto& job) { pool.post(job); });
+    }
+    {
+        parallel::ThreadPoolPriority pool(num_threads);
+        measure_post_vs_submit(
+            "ThreadPoolPriority::submit",
+            [&](auto& job) { (void)pool.submit(job); },
+            "ThreadPoolPriority::post  ", [&](auto& job) { pool.post(job); });
+    }
+    {
+        ThreadPool pool(num_threads);
+        measure_post_vs_submit(
+            "ThreadPool::AddTask", [&](auto& job) { (void)pool.AddTask(job); },
+            "ThreadPool::Post   ", [&](auto& job) { pool.Post(job); });
+    }
+}
+
+// 多个外部线程同时 post 小任务: 提交端吞吐量与全部执行完的总时间
+void benchmark_external_producers(size_t num_threads) {
+    const int tasks = 400000;
+    std::cout << "Testing external producers posting " << tasks
+              << " tasks to ThreadPoolFast (" << num_threads
+              << " threads)...\n";
+    for (int producers : {1, 2, 4}) {
+        ThreadPoolFast pool(num_threads);
+        std::atomic<int> done{0};
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<std::thread> threads;
+        for (int p = 0; p < producers; ++p) {
+            threads.emplace_back([&] {
+                for (int i = 0; i < tasks / producers; ++i) {
+                    pool.post([&done] {
+                        done.fetch_add(1, std::memory_order_relaxed);
+                    });
+                }
+            });
+        }
+        for (auto& t : threads)
+            t.join();
+        auto submitted = std::chrono::high_resolution_clock::now();
+        while (done.load(std::memory_order_relaxed) <
+               tasks / producers * producers) {
+            std::this_thread::yield();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::chrono::duration<double, std::nano> per_post =
+            (submitted - start) / tasks;
+        std::chrono::duration<double> total = end - start;
+        std::cout << "  -> " << producers << " producer(s): "
+                  << per_post.count() << " ns/post, total " << total.count()
+                  << "s\n";
+    }
+}
+
+// 一个租户狂刷任务时，另一个租户零星的请求要排多久: 同一个注入队列 vs 按租户加权公平
+void benchmark_tenant_fairness(size_t num_threads) {
+    const int flood = 20000;
+    const int requests = 200;
+    std::cout << "Testing " << requests << " requests behind a " << flood
+              << "-task flood from another tenant on ThreadPoolFast ("
+              << num_threads << " threads)...\n";
+    auto spin_for = [](std::chrono::microseconds duration) {
+        auto until = std::chrono::steady_clock::now() + duration;
+        while (std::chrono::steady_clock::now() < until) {
+        }
+    };
+
+    for (bool tenants : {false, true}) {
+        ThreadPoolFast pool(num_threads);
+        parallel::TenantId noisy = pool.add_tenant({1, flood});
+        parallel::TenantId quiet = pool.add_tenant({1, 64});
+        std::atomic<int> flood_done{0};
+        for (int i = 0; i < flood; ++i) {
+            auto task = [&] {
+                spin_for(std::chrono::microseconds(5));
+                flood_done.fetch_add(1, std::memory_order_relaxed);
+            };
+            if (tenants) {
+                pool.try_post_as(noisy, task);
+            } else {
+                pool.post(task);
+            }
+        }
+
+        std::atomic<uint64_t> total_wait{0};
+        std::atomic<int> served{0};
+        for (int i = 0; i < requests; ++i) {
+            uint64_t submitted = parallel::latency_now();
+            auto request = [&, submitted] {
+                total_wait.fetch_add(parallel::latency_now() - submitted);
+                served.fetch_add(1);
+            };
+            if (tenants) {
+                // 队列满了 (worker 暂时没被调度到) 就等一等，丢掉请求会让下面的等待永远结束不了
+                while (!pool.try_post_as(quiet, request)) {
+                    std::this_thread::yield();
+                }
+            } else {
+                pool.post(request);
+            }
+            spin_for(std::chrono::microseconds(100));
+        }
+        while (served.load() < requests || flood_done.load() < flood) {
+            std::this_thread::yield();
+        }
+        std::cout << "  -> "
+                  << (tenants ? "per-tenant fair queues"
+                              : "shared FIFO queue     ")
+                  << ": mean request wait "
+                  << total_wait.load() / requests / 1000.0 << "us\n";
+    }
+}
+
+// 每个任务构造一个临时容器: 全局堆 vs worker arena
+// 大量挂起的定时器: 插入/取消的开销，以及同一时刻到期的一大批任务多久全部执行完
+void benchmark_timer_wheel(size_t num_threads) {
+    const int timers = 1000000;
+    const int burst = 100000;
+    std::cout << "Testing " << timers << " pending timers on ThreadPoolFast ("
+              << num_threads << " threads)...\n";
+    ThreadPoolFast pool(num_threads);
+    std::atomic<int> ran{0};
+
+    std::vector<parallel::TimerId> ids(timers);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < timers; ++i) {
+        // 1 秒到 1 小时之间，分布在时间轮的各层
+        auto delay =
+            std::chrono::milliseconds(1000 + (int64_t{i} * 7919) % 3599000);
+        ids[i] = pool.post_after(delay, [&ran] { ran.fetch_add(1); });
+    }
+    auto inserted = std::chrono::steady_clock::now();
+    size_t pending = pool.pending_timers();
+    for (parallel::TimerId id : ids) {
+        pool.cancel_timer(id);
+    }
+    auto cancelled = std::chrono::steady_clock::now();
+    std::cout << "  -> insert: "
+              << std::chrono::duration<double, std::nano>(inserted - start)
+                         .count() / timers
+              << " ns/timer (" << pending << " pending), cancel: "
+              << std::chrono::duration<double, std::nano>(cancelled -
+                                                          inserted)
+                         .count() / timers
+              << " ns/timer\n";
+
+    auto due = parallel::TimerClock::now() + std::chrono::milliseconds(50);
+    for (int i = 0; i < burst; ++i) {
+        pool.submit_at(due, [&ran] { ran.fetch_add(1); });
+    }
+    while (ran.load() < burst) {
+        std::this_thread::yield();
+    }
+    std::cout << "  -> " << burst << " timers due at once: all executed "
+              << std::chrono::duration<double, std::micro>(
+                     parallel::TimerClock::now() - due)
+                     .count()
+              << " us after the due time\n";
+}
+
+void benchmark_worker_arena(size_t num_threads) {
+    const int tasks = 20000;
+    const int items = 2000;
+    std::cout << "Testing " << tasks << " tasks with a " << items
+              << "-element temporary vector (" << num_threads
+              << " threads)...\n";
+    ThreadPoolFast pool(num_threads);
+    std::atomic<long> checksum{0};
+    auto measure = [&](const char* name, auto make_vector) {
+        size_t allocations_before = allocation_count();
+        auto start = std::chrono::high_resolution_clock::now();
+        auto done = pool.submit_n(tasks, [&](size_t t) {
+            auto values = make_vector();
+            for (int i = 0; i < items; ++i) {
+                values.push_back(static_cast<int>(t) + i);
+            }
+            checksum.fetch_add(values.back(), std::memory_order_relaxed);
+        });
+        pool.help_until_ready(done);
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed = end - start;
+        std::cout << "  -> " << name << ": " << elapsed.count() << "s, "
+                  << (allocation_count() - allocations_before)
+                  << " allocations\n";
+    };
+    measure("global heap ", [] { return std::vector<int>(); });
+    measure("worker arena", [] {
+        return std::pmr::vector<int>(parallel::current_memory_resource());
+    });
+}
+
+// 一大批 High 任务压着少量 Low 任务: 比较防饥饿开启前后 Low 任务全部完成的时间
+void benchmark_priority_aging(size_t num_threads) {
+    using namespace parallel;
+    const int high_tasks = 50000;
+    const int low_tasks = 100;
+    std::cout << "Testing " << low_tasks << " Low tasks behind " << high_tasks
+              << " High tasks on ThreadPoolPriority (" << num_threads
+              << " threads)...\n";
+    for (uint32_t max_bypass : {0u, 16u}) {
+        ThreadPoolPriority pool(num_threads);
+        pool.set_aging_policy({max_bypass});
+        std::atomic<int> low_done{0};
+        std::atomic<int> high_done{0};
+        std::atomic<double> low_seconds{0};    // 最后一个 Low 任务完成的时刻
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < low_tasks; ++i) {
+            pool.post(Priority::Low, [&] {
+                heavy_work();
+                if (low_done.fetch_add(1) + 1 == low_tasks) {
+                    std::chrono::duration<double> elapsed =
+                        std::chrono::high_resolution_clock::now() - start;
+                    low_seconds.store(elapsed.count());
+                }
+            });
+        }
+        for (int i = 0; i < high_tasks; ++i) {
+            pool.post(Priority::High, [&] {
+                heavy_work();
+                high_done.fetch_add(1);
+            });
+        }
+        while (low_seconds.load() == 0 || high_done.load() < high_tasks) {
+            std::this_thread::yield();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+
+        std::chrono::duration<double> total = end - start;
+        auto stats = pool.stats();
+        std::cout << "  -> max_bypass " << max_bypass << ": Low done after "
+                  << low_seconds.load() << "s, all done after " << total.count()
+                  << "s, Low bypassed " << stats.bypassed_by_priority[2]
+                  << " times, promoted " << stats.promoted_by_priority[2]
+                  << "\n";
+    }
+}
+
+// 过载的请求流: 把截止时间粗略映射到三个优先级 vs 直接按截止时间 (EDF) 调度
+void benchmark_deadline_scheduling(size_t num_threads) {
+    using namespace parallel;
+    const int tasks = 4000;
+    std::cout << "Testing " << tasks << " tasks with random deadlines on "
+              << "ThreadPoolPriority (" << num_threads << " threads)...\n";
+
+    // 每个任务忙等 20us；截止时间按“全部任务执行所需时间”的比例分布，略微过载
+    const auto per_task = std::chrono::microseconds(20);
+    auto spin = [per_task] {
+        auto until = std::chrono::steady_clock::now() + per_task;
+        while (std::chrono::steady_clock::now() < until) {
+        }
+    };
+    auto horizon = per_task * tasks / static_cast<long>(num_threads);
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> spread(0.1, 1.2);
+    std::vector<std::chrono::nanoseconds> offsets(tasks);
+    for (auto& offset : offsets) {
+        offset = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            horizon * spread(rng));
+    }
+
+    for (bool edf : {false, true}) {
+        ThreadPoolPriority pool(num_threads);
+        pool.set_exception_handler([](std::exception_ptr) {});    // 过期丢弃
+        std::atomic<int> missed{0};
+        std::atomic<int> done{0};
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < tasks; ++i) {
+            Deadline deadline = start + offsets[i];
+            auto body = [&, deadline] {
+                spin();
+                if (std::chrono::steady_clock::now() > deadline) {
+                    missed.fetch_add(1, std::memory_order_relaxed);
+                }
+                done.fetch_add(1, std::memory_order_relaxed);
+            };
+            if (edf) {
+                pool.post_by(deadline, body);
+            } else {
+                double fraction = static_cast<double>(offsets[i].count()) /
+                                  static_cast<double>(horizon.count());
+                pool.post(fraction < 0.4   ? Priority::High
+                          : fraction < 0.8 ? Priority::Normal
+                                           : Priority::Low,
+                          body);
+            }
+        }
+        if (edf) {
+            // 过期的任务被丢弃，不会执行 body
+            while (done.load() + pool.stats().deadline_expired < tasks) {
+                std::this_thread::yield();
+            }
+        } else {
+            while (done.load() < tasks) {
+                std::this_thread::yield();
+            }
+        }
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        auto stats = pool.stats();
+        std::cout << "  -> "
+                  << (edf ? "EDF submit_by    " : "3 priority levels") << ": "
+                  << elapsed.count() << "s, finished late "
+                  << missed.load() << ", dropped " << stats.deadline_expired
+                  << "\n";
+    }
+}
+
+// 稀疏负载下的空闲扫描: 空闲 worker 不停地找活干，外部线程一次只提交一个任务并等待。
+// 比较 3 级和 16 级的线程池 (任务放在最低的级别)，扫描开销不应随级别数增长
+void benchmark_priority_idle_scan(size_t num_threads) {
+    using namespace parallel;
+    const int round_trips = 20000;
+    std::cout << "Testing " << round_trips
+              << " submit/get round trips with yielding idle workers ("
+              << num_threads << " threads)...\n";
+
+    auto measure = [&](const char* name, auto& pool, Priority prio) {
+        pool.set_idle_policy({IdleStrategy::SpinThenYield, 128});
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < round_trips; ++i) {
+            pool.submit(prio, [] {}).get();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double, std::micro> elapsed = end - start;
+        auto stats = pool.stats();
+        std::cout << "  -> " << name << ": "
+                  << elapsed.count() / round_trips << " us/round trip, "
+                  << stats.total.steal_failures << " empty scans, "
+                  << stats.total.lock_misses << " lock misses\n";
+    };
+
+    {
+        ThreadPoolPriority pool(num_threads);
+        measure("3 levels ", pool, Priority::Low);
+    }
+    {
+        BasicThreadPoolPriority<16> pool(num_threads);
+        measure("16 levels", pool, static_cast<Priority>(15));
+    }
+}
+
+// 每个 worker 都被很长的 Low 任务占着时，陆续到来的 High 任务要等多久才开始执行:
+// 轮询分给某个 worker (只能等它做完或者被别人偷走) vs 共享通道 (最先空出来的 worker 取走)
+void benchmark_shared_lane(size_t num_threads) {
+    using namespace parallel;
+    const int high_tasks = 200;
+    std::cout << "Testing " << high_tasks
+              << " High tasks arriving behind long Low tasks on "
+              << "ThreadPoolPriority (" << num_threads << " threads)...\n";
+    auto spin_for = [](std::chrono::microseconds duration) {
+        auto until = std::chrono::steady_clock::now() + duration;
+        while (std::chrono::steady_clock::now() < until) {
+        }
+    };
+
+    for (size_t shared : {0u, 1u}) {
+        ThreadPoolPriority pool(num_threads);
+        pool.set_shared_levels(shared);
+        // Low 任务的长度参差不齐: 有的 worker 很快就空出来，有的要很久
+        std::atomic<int> low_left{static_cast<int>(num_threads) * 8};
+        for (size_t i = 0; i < num_threads * 8; ++i) {
+            pool.post(Priority::Low, [&, i] {
+                spin_for(std::chrono::microseconds(i % 4 == 0 ? 4000 : 200));
+                low_left.fetch_sub(1);
+            });
+        }
+
+        std::atomic<uint64_t> total_wait{0};
+        std::atomic<uint64_t> max_wait{0};
+        std::atomic<int> high_done{0};
+        for (int i = 0; i < high_tasks; ++i) {
+            uint64_t submitted = latency_now();
+            pool.post(Priority::High, [&, submitted] {
+                uint64_t wait = latency_now() - submitted;
+                total_wait.fetch_add(wait);
+                uint64_t seen = max_wait.load();
+                while (wait > seen &&
+                       !max_wait.compare_exchange_weak(seen, wait)) {
+                }
+                high_done.fetch_add(1);
+            });
+            spin_for(std::chrono::microseconds(50));
+        }
+        while (high_done.load() < high_tasks || low_left.load() > 0) {
+            std::this_thread::yield();
+        }
+        std::cout << "  -> "
+                  << (shared ? "shared High lane" : "round-robin     ")
+                  << ": mean wait " << total_wait.load() / high_tasks / 1000.0
+                  << "us, max wait " << max_wait.load() / 1000.0 << "us\n";
+    }
+}
+
+// 所有普通 worker 都被长 Low 任务占满时，High 任务的排队时间: 没有专用 worker vs 一个专用 worker
+void benchmark_reserved_workers(size_t num_threads) {
+    using namespace parallel;
+    const int high_tasks = 100;
+    std::cout << "Testing " << high_tasks
+              << " High tasks while every worker runs long Low tasks on "
+              << "ThreadPoolPriority (" << num_threads << " threads)...\n";
+    auto spin_for = [](std::chrono::microseconds duration) {
+        auto until = std::chrono::steady_clock::now() + duration;
+        while (std::chrono::steady_clock::now() < until) {
+        }
+    };
+
+    for (size_t reserved : {0u, 1u}) {
+        // 普通 worker 调高 nice，操作系统优先调度专用 worker
+        WorkerClasses classes;
+        classes.reserved = reserved;
+        classes.shared_sched.nice = reserved ? 5 : 0;
+        ThreadPoolPriority pool(num_threads, 0, classes);
+
+        std::atomic<bool> stop_low{false};
+        std::atomic<int> low_running{0};
+        for (size_t i = 0; i < num_threads * 4; ++i) {
+            pool.post(Priority::Low, [&] {
+                low_running.fetch_add(1);
+                spin_for(std::chrono::microseconds(
+                    stop_low.load() ? 0 : 5000));
+                low_running.fetch_sub(1);
+            });
+        }
+
+        std::atomic<uint64_t> total_wait{0};
+        std::atomic<uint64_t> max_wait{0};
+        std::atomic<int> high_done{0};
+        for (int i = 0; i < high_tasks; ++i) {
+            uint64_t submitted = latency_now();
+            pool.post(Priority::High, [&, submitted] {
+                uint64_t wait = latency_now() - submitted;
+                total_wait.fetch_add(wait);
+                uint64_t seen = max_wait.load();
+                while (wait > seen &&
+                       !max_wait.compare_exchange_weak(seen, wait)) {
+                }
+                high_done.fetch_add(1);
+            });
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        while (high_done.load() < high_tasks) {
+            std::this_thread::yield();
+        }
+        stop_low.store(true);
+        std::cout << "  -> " << reserved << " reserved worker(s)"
+                  << ": mean wait " << total_wait.load() / high_tasks / 1000.0
+                  << "us, max wait " << max_wait.load() / 1000.0 << "us\n";
+    }
+}
+
+// 三段式请求流水线: 逐段屏障 (调用方 get() 完一段再提交下一段) 与 then() 链对比
+void benchmark_pipeline(size_t num_threads) {
+    const int requests = 100000;
+    std::cout << "Testing " << requests << " three-stage requests on "
+              << "ThreadPoolFast (" << num_threads << " threads)...\n";
+    auto stage = [](int v) {
+        heavy_work();
+        return v + 1;
+    };
+
+    {
+        ThreadPoolFast pool(num_threads);
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<int> values(requests, 0);
+        std::vector<parallel::Future<int>> futures;
+        futures.reserve(requests);
+        for (int s = 0; s < 3; ++s) {
+            for (int v : values) {
+                futures.push_back(pool.submit(stage, v));
+            }
+            for (int i = 0; i < requests; ++i) {
+                values[i] = futures[i].get();
+            }
+            futures.clear();
+        }
+        std::chrono::duration<double> diff =
+            std::chrono::high_resolution_clock::now() - start;
+        std::cout << "  -> stage barriers: " << diff.count() << "s\n";
+    }
+    {
+        ThreadPoolFast pool(num_threads);
+        auto start = std::chrono::high_resolution_clock::now();
+        std::vector<parallel::Future<int>> futures;
+        futures.reserve(requests);
+        for (int i = 0; i < requests; ++i) {
+            futures.push_back(
+                pool.submit(stage, 0).then(stage).then(stage));
+        }
+        for (auto& f : futures) {
+            f.get();
+        }
+        std::chrono::duration<double> diff =
+            std::chrono::high_resolution_clock::now() - start;
+        std::cout << "  -> then() chains:  " << diff.count() << "s\n";
+    }
+}
+
+// 分层依赖 (每层的节点依赖上一层的全部节点): 逐层 submit + get() 与 TaskGraph 对比
+void benchmark_task_graph(size_t num_threads) {
+    const int layers = 50;
+    const int width = 8;
+    const int frames = 200;
+    std::cout << "Testing " << layers << "x" << width << " layered DAG, "
+              << frames << " frames (" << num_threads << " threads)...\n";
+
+    ThreadPoolFast pool(num_threads);
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<parallel::Future<void>> futures;
+    futures.reserve(width);
+    for (int f = 0; f < frames; ++f) {
+        for (int l = 0; l < layers; ++l) {
+            for (int w = 0; w < width; ++w) {
+                futures.push_back(pool.submit(heavy_work));
+            }
+            for (auto& fut : futures) {
+                fut.get();
+            }
+            futures.clear();
+        }
+    }
+    std::chrono::duration<double> diff =
+        std::chrono::high_resolution_clock::now() - start;
+    std::cout << "  -> futures + get(): " << diff.count() << "s\n";
+
+    parallel::TaskGraph graph(pool);
+    std::vector<parallel::TaskGraph::NodeId> prev;
+    std::vector<parallel::TaskGraph::NodeId> cur;
+    for (int l = 0; l < layers; ++l) {
+        for (int w = 0; w < width; ++w) {
+            cur.push_back(graph.add(heavy_work));
+            for (auto p : prev) {
+                graph.precede(p, cur.back());
+            }
+        }
+        prev = std::exchange(cur, {});
+    }
+    start = std::chrono::high_resolution_clock::now();
+    for (int f = 0; f < frames; ++f) {
+        graph.run().get();
+    }
+    diff = std::chrono::high_resolution_clock::now() - start;
+    std::cout << "  -> TaskGraph:       " << diff.count() << "s\n";
+}
+
+// 递归 fork: 每个任务在 worker 内部再提交两个子任务，直到指定深度
+void spawn_tree(ThreadPoolFast& pool, int depth, std::atomic<int>& pending,
+                std::promise<void>& all_done) {
+    if (depth > 0) {
+        pending.fetch_add(2, std::memory_order_relaxed);
+        for (int i = 0; i < 2; ++i) {
+            pool.submit([&pool, depth, &pending, &all_done] {
+                spawn_tree(pool, depth - 1, pending, all_done);
+            });
+        }
+    } else {
+        heavy_work();
+    }
+    if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        all_done.set_value();
+    }
+}
+
+void benchmark_recursive_spawn(size_t num_threads) {
+    const int depth = 18;    // 2^19 - 1 个任务
+    std::cout << "Testing recursive fork on ThreadPoolFast (depth " << depth
+              << ")...\n";
+    ThreadPoolFast pool(num_threads);
+    std::atomic<int> pending{1};
+    std::promise<void> all_done;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    pool.submit([&] { spawn_tree(pool, depth, pending, all_done); });
+    all_done.get_future().wait();
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> diff = end - start;
+    int tasks = (1 << (depth + 1)) - 1;
+    std::cout << "  -> Time: " << diff.count()
+              << "s, Throughput: " << (tasks / diff.count()) << " tasks/s\n";
+}
+
+// 绑核 + 分层窃取 vs 不绑核。真正的收益 (跨 L3 / 跨插槽流量减少) 要在多插槽机器上才看得出来
+void benchmark_pinned_pool(size_t num_threads) {
+    const auto& topology = parallel::CpuTopology::system();
+    std::vector<int> cores, l3s, nodes;
+    for (const auto& cpu : topology.cpus()) {
+        cores.push_back(cpu.core);
+        l3s.push_back(cpu.l3);
+        nodes.push_back(cpu.node);
+    }
+    auto distinct = [](std::vector<int> v) {
+        std::sort(v.begin(), v.end());
+        return std::unique(v.begin(), v.end()) - v.begin();
+    };
+    std::cout << "Testing pinned ThreadPoolFast (topology: "
+              << topology.cpus().size() << " cpus, " << distinct(cores)
+              << " cores, " << distinct(l3s) << " L3, " << distinct(nodes)
+              << " nodes)...\n";
+
+    for (bool pin : {false, true}) {
+        ThreadPoolFast pool(num_threads, pin);
+        std::atomic<int> pending{1};
+        std::promise<void> all_done;
+        auto start = std::chrono::high_resolution_clock::now();
+        pool.submit([&] { spawn_tree(pool, 16, pending, all_done); });
+        all_done.get_future().wait();
+        std::chrono::duration<double> diff =
+            std::chrono::high_resolution_clock::now() - start;
+        std::cout << "  -> " << (pin ? "pinned:   " : "unpinned: ")
+                  << diff.count() << "s\n";
+    }
+}
+
+// 单个生产者把大量小任务灌进同一个队列 (在 worker 内部提交，全部进入这个 worker 的队列)，
+// 其他 worker 只能靠窃取拿到任务。比较“每次偷一个”与 Steal-Half 批量窃取
+template <typename Pool>
+double run_flood(Pool& pool, int num_tasks) {
+    std::atomic<int> remaining{num_tasks};
+    std::promise<void> all_done;
+    auto tiny = [&] {
+        heavy_work();
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            all_done.set_value();
+    };
+
+    auto start = std::chrono::high_resolution_clock::now();
+    pool.submit([&] {
+        for (int i = 0; i < num_tasks; ++i) {
+            pool.submit(tiny);
+        }
+    });
+    all_done.get_future().wait();
+    std::chrono::duration<double> diff =
+        std::chrono::high_resolution_clock::now() - start;
+    return diff.count();
+}
+
+void print_pool_stats(const parallel::PoolStats& stats) {
+    const parallel::WorkerStats& t = stats.total;
+    std::cout << "     stats: executed " << t.executed << ", steals "
+              << t.steals << " (" << t.stolen << " tasks), failed sweeps "
+              << t.steal_failures << ", lock misses " << t.lock_misses
+              << ", parks " << t.parks << " ("
+              << std::chrono::duration<double, std::milli>(t.parked).count()
+              << "ms)\n";
+}
+
+void benchmark_steal_half(size_t num_threads) {
+    // 至少 4 个 worker，否则没有 thief
+    size_t workers = std::max<size_t>(num_threads, 4);
+    const int num_tasks = 200000;
+    std::cout << "Testing single-queue flood (" << num_tasks << " tasks, "
+              << workers << " workers)...\n";
+
+    for (size_t batch : {size_t(1), size_t(32)}) {
+        ThreadPoolFast fast(workers);
+        fast.set_steal_batch(batch);
+        double fast_time = run_flood(fast, num_tasks);
+
+        parallel::ThreadPoolPriority prio(workers);
+        prio.set_steal_batch(batch);
+        double prio_time = run_flood(prio, num_tasks);
+
+        std::cout << "  -> steal batch " << std::setw(2) << batch
+                  << ": ThreadPoolFast " << fast_time
+                  << "s, ThreadPoolPriority " << prio_time << "s\n";
+        print_pool_stats(fast.stats());
+        print_pool_stats(prio.stats());
+    }
+}
+
+// 突发的阻塞型负载 (每个任务 sleep 1ms): 固定 1 个 worker vs 自动伸缩 (1 → max)。
+// 统计突发耗时、峰值 worker 数，以及空闲一段时间后剩下的 worker 数
+void benchmark_elastic_pool(size_t num_threads) {
+    size_t max_threads = std::max<size_t>(num_threads, 4);
+    const int num_tasks = 400;
+    std::cout << "Testing elastic ThreadPoolFast (" << num_tasks
+              << " blocking tasks, 1.." << max_threads << " workers)...\n";
+
+    for (bool elastic : {false, true}) {
+        ThreadPoolFast pool(1, false, max_threads);
+        if (elastic) {
+            parallel::ElasticPolicy policy;
+            policy.linger = std::chrono::milliseconds(100);
+            pool.enable_auto_resize(policy);
+        }
+
+        size_t peak = 1;
+        auto start = std::chrono::high_resolution_clock::now();
+        auto burst = pool.submit_n(num_tasks, [](size_t) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        });
+        while (!burst.is_ready()) {
+            peak = std::max(peak, pool.size());
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        burst.get();
+        std::chrono::duration<double> diff =
+            std::chrono::high_resolution_clock::now() - start;
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        std::cout << "  -> " << (elastic ? "elastic: " : "fixed:   ")
+                  << diff.count() << "s, peak " << peak
+                  << " workers, after 500ms idle " << pool.size()
+                  << " workers\n";
+    }
+}
+
+// 同样 NUM_TASKS 个任务: 逐个 submit vs 一次 submit_n。分别统计“入队耗时”和“总耗时”
+void benchmark_bulk_submit(size_t num_threads) {
+    std::cout << "Testing bulk submission on ThreadPoolFast...\n";
+    ThreadPoolFast pool(num_threads);
+
+    {
+        std::vector<parallel::Future<void>> results;
+        results.reserve(NUM_TASKS);
+        auto start = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < NUM_TASKS; ++i) {
+            results.emplace_back(pool.submit(heavy_work));
+        }
+        auto enqueued = std::chrono::high_resolution_clock::now();
+        for (auto& res : results) {
+            res.get();
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> enqueue = enqueued - start;
+        std::chrono::duration<double> total = end - start;
+        std::cout << "  -> submit loop: enqueue " << enqueue.count()
+                  << "s, total " << total.count() << "s\n";
+    }
+
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        auto batch = pool.submit_n(NUM_TASKS, [](size_t) { heavy_work(); });
+        auto enqueued = std::chrono::high_resolution_clock::now();
+        batch.get();
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> enqueue = enqueued - start;
+        std::chrono::duration<double> total = end - start;
+        std::cout << "  -> submit_n:    enqueue " << enqueue.count()
+                  << "s, total " << total.count() << "s\n";
+    }
+}
+
+// 空闲开销与唤醒延迟:
+// 1. 空闲的线程池在一段时间内消耗的进程 CPU 时间 (轮询式休眠会周期性醒来空转)
+// 2. 逐个 submit + get 的往返延迟 (每次都要唤醒一个已休眠的 worker) 以及 submit 调用本身的耗时
+template <typename Pool>
+void measure_idle_and_latency(const char* name, Pool& pool,
+                              int rounds = 20000) {
+    // 等 worker 全部进入休眠
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    const auto idle_time = std::chrono::milliseconds(500);
+    std::clock_t cpu_start = std::clock();
+    std::this_thread::sleep_for(idle_time);
+    std::clock_t cpu_end = std::clock();
+    double idle_cpu_ms = 1000.0 * static_cast<double>(cpu_end - cpu_start) /
+                         CLOCKS_PER_SEC;
+
+    std::chrono::duration<double, std::micro> submit_time{0};
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        auto before = std::chrono::high_resolution_clock::now();
+        auto fut = pool.submit([] {});
+        submit_time += std::chrono::high_resolution_clock::now() - before;
+        fut.get();
+    }
+    std::chrono::duration<double, std::micro> total =
+        std::chrono::high_resolution_clock::now() - start;
+
+    std::cout << "  -> " << name << ": idle CPU " << idle_cpu_ms << "ms per "
+              << idle_time.count() << "ms, round trip "
+              << total.count() / rounds << "us, submit call "
+              << submit_time.count() / rounds << "us\n";
+}
+
+void benchmark_idle_and_latency(size_t num_threads) {
+    std::cout << "Measuring idle CPU and submit latency (" << num_threads
+              << " threads)...\n";
+    {
+        ThreadPoolFast pool(num_threads);
+        measure_idle_and_latency("ThreadPoolFast    ", pool);
+    }
+    {
+        parallel::ThreadPoolPriority pool(num_threads);
+        measure_idle_and_latency("ThreadPoolPriority", pool);
+    }
+
+    // 各空闲策略: 唤醒延迟 (往返时间) 与空闲 CPU 的取舍。
+    // 核心数少于 worker + 提交者时，自旋的 worker 会和提交者抢 CPU，往返时间反而变长
+    const int rounds = 2000;
+    using parallel::IdleStrategy;
+    const std::pair<IdleStrategy, const char*> policies[] = {
+        {IdleStrategy::Park, "Park         "},
+        {IdleStrategy::SpinThenPark, "SpinThenPark "},
+        {IdleStrategy::SpinThenYield, "SpinThenYield"},
+        {IdleStrategy::Spin, "Spin         "},
+    };
+    std::cout << "Idle policies on ThreadPoolFast (spin budget 128 rounds)..."
+              << "\n";
+    for (auto [strategy, name] : policies) {
+        ThreadPoolFast pool(num_threads);
+        pool.set_idle_policy({strategy, 128});
+        measure_idle_and_latency(name, pool, rounds);
+    }
+    std::cout << "Idle policies on ThreadPoolPriority...\n";
+    for (auto [strategy, name] : policies) {
+        parallel::ThreadPoolPriority pool(num_threads);
+        pool.set_idle_policy({strategy, 128});
+        measure_idle_and_latency(name, pool, rounds);
+    }
+}
+
+// 细粒度循环 (每次迭代几十纳秒): 逐元素 submit vs parallel_for
+void benchmark_parallel_for(size_t num_threads) {
+    const int n = 10000000;
+    std::cout << "Testing parallel_for on ThreadPoolFast (" << n
+              << " fine-grained iterations)...\n";
+    ThreadPoolFast pool(num_threads);
+    std::vector<float> data(n, 1.0f);
+    auto body = [&data](int i) {
+        float x = data[i];
+        for (int k = 0; k < 8; ++k) {
+            x = x * 0.5f + 1.0f;
+        }
+        data[i] = x;
+    };
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < n; ++i) {
+        body(i);
+    }
+    std::chrono::duration<double> serial =
+        std::chrono::high_resolution_clock::now() - start;
+
+    start = std::chrono::high_resolution_clock::now();
+    parallel::parallel_for(pool, 0, n, body);
+    std::chrono::duration<double> par =
+        std::chrono::high_resolution_clock::now() - start;
+
+    // 逐元素 submit 的代价太高，只跑 1/50 的元素再按比例折算
+    const int per_task = n / 50;
+    start = std::chrono::high_resolution_clock::now();
+    {
+        std::vector<parallel::Future<void>> results;
+        results.reserve(per_task);
+        for (int i = 0; i < per_task; ++i) {
+            results.push_back(pool.submit(body, i));
+        }
+        for (auto& res : results) {
+            res.get();
+        }
+    }
+    std::chrono::duration<double> submit_each =
+        (std::chrono::high_resolution_clock::now() - start) * 50;
+
+    std::cout << "  -> serial:          " << serial.count() << "s\n"
+              << "  -> parallel_for:    " << par.count() << "s (speedup "
+              << serial.count() / par.count() << "x)\n"
+              << "  -> submit per item: " << submit_each.count()
+              << "s (extrapolated)\n";
+}
+
+// 递归并行快速排序: 左半边交给 TaskGroup，右半边在当前线程继续，最后边帮忙边等待
+void parallel_quicksort(ThreadPoolFast& pool, int* first, int* last) {
+    const ptrdiff_t cutoff = 2048;
+    while (last - first > cutoff) {
+        int pivot = first[(last - first) / 2];
+        int* mid1 = std::partition(first, last, [=](int v) { return v < pivot; });
+        int* mid2 = std::partition(mid1, last, [=](int v) { return v == pivot; });
+
+        parallel::TaskGroup group(pool);
+        group.run([&pool, first, mid1] { parallel_quicksort(pool, first, mid1); });
+        parallel_quicksort(pool, mid2, last);
+        group.wait();
+        return;
+    }
+    std::sort(first, last);
+}
+
+void benchmark_parallel_quicksort(size_t num_threads) {
+    const int n = 4000000;
+    std::cout << "Testing parallel quicksort with TaskGroup (" << n
+              << " ints)...\n";
+    std::vector<int> input(n);
+    uint32_t seed = 12345;
+    for (auto& v : input) {
+        seed = seed * 1664525u + 1013904223u;
+        v = static_cast<int>(seed >> 1);
+    }
+
+    std::vector<int> data = input;
+    auto start = std::chrono::high_resolution_clock::now();
+    std::sort(data.begin(), data.end());
+    std::chrono::duration<double> serial =
+        std::chrono::high_resolution_clock::now() - start;
+
+    ThreadPoolFast pool(num_threads);
+    data = input;
+    start = std::chrono::high_resolution_clock::now();
+    pool.submit([&] { parallel_quicksort(pool, data.data(), data.data() + n); })
+        .get();
+    std::chrono::duration<double> par =
+        std::chrono::high_resolution_clock::now() - start;
+
+    std::cout << "  -> std::sort:          " << serial.count() << "s\n"
+              << "  -> parallel quicksort: " << par.count() << "s (speedup "
+              << serial.count() / par.count() << "x, sorted: "
+              << std::is_sorted(data.begin(), data.end()) << ")\n";
+}
+
+// 分批提交 (每批 batch 个任务，提交完等待全部完成)，返回稳态下平均每次提交的堆分配次数。
+// 第一批用于预热 (队列扩容、共享状态缓存填充)，不计入统计。
+template <typename SubmitFn>
+double measure_allocations_per_submit(SubmitFn submit_one) {
+    const int batch = 1024;
+    const int rounds = 50;
+    using FutureType = decltype(submit_one());
+    std::vector<FutureType> futures;
+    futures.reserve(batch);
+
+    size_t before = 0;
+    for (int round = 0; round <= rounds; ++round) {
+        if (round == 1)
+            before = allocation_count();
+        for (int i = 0; i < batch; ++i)
+            futures.push_back(submit_one());
+        for (auto& f : futures)
+            f.get();
+        futures.clear();
+    }
+    return static_cast<double>(allocation_count() - before) /
+           (static_cast<double>(batch) * rounds);
+}
+
+// 与上面相同的分批方式，但 post 没有 Future，用计数器等待每批任务执行完
+double measure_allocations_per_post(ThreadPoolFast& pool) {
+    const int batch = 1024;
+    const int rounds = 50;
+    std::atomic<int> done{0};
+
+    size_t before = 0;
+    for (int round = 0; round <= rounds; ++round) {
+        if (round == 1)
+            before = allocation_count();
+        for (int i = 0; i < batch; ++i)
+            pool.post([&done] {
+                done.fetch_add(1, std::memory_order_relaxed);
+            });
+        while (done.load(std::memory_order_relaxed) < batch * (round + 1))
+            std::this_thread::yield();
+    }
+    return static_cast<double>(allocation_count() - before) /
+           (static_cast<double>(batch) * rounds);
+}
+
+void benchmark_submit_allocations(size_t num_threads) {
+    std::cout << "Measuring heap allocations per submit...\n";
+
+    // 旧实现的等价路径: shared_ptr<packaged_task> + bind + std::function
+    double legacy = measure_allocations_per_submit([] {
+        auto task = std::make_shared<std::packaged_task<void()>>(
+            std::bind(heavy_work));
+        std::future<void> res = task->get_future();
+        std::function<void()> job([task]() { (*task)(); });
+        job();
+        return res;
+    });
+
+    ThreadPool basic(num_threads);
+    double basic_allocs =
+        measure_allocations_per_submit([&] { return basic.AddTask(heavy_work); });
+
+    ThreadPoolFast fast(num_threads);
+    double fast_allocs =
+        measure_allocations_per_submit([&] { return fast.submit(heavy_work); });
+
+    parallel::ThreadPoolPriority prio(num_threads);
+    double prio_allocs = measure_allocations_per_submit(
+        [&] { return prio.submit(parallel::Priority::Normal, heavy_work); });
+
+    double post_allocs = measure_allocations_per_post(fast);
+
+    std::cout << "  -> packaged_task + std::function: " << legacy << "\n"
+              << "  -> ThreadPool::AddTask:           " << basic_allocs << "\n"
+              << "  -> ThreadPoolFast::submit:        " << fast_allocs << "\n"
+              << "  -> ThreadPoolFast::post:          " << post_allocs << "\n"
+              << "  -> ThreadPoolPriority::submit:    " << prio_allocs << "\n";
+}
+
+// 对照组: 旧版 ThreadPoolFast::WorkQueue 的做法 (std::deque + std::mutex)
+struct MutexDeque {
+    std::deque<int> items;
+    std::mutex mtx;
+
+    void push(int v) {
+        std::lock_guard<std::mutex> lock(mtx);
+        items.push_back(v);
+    }
+
+    std::optional<int> pop() {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (items.empty())
+            return std::nullopt;
+        int v = items.back();
+        items.pop_back();
+        return v;
+    }
+
+    std::optional<int> steal() {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (items.empty())
+            return std::nullopt;
+        int v = items.front();
+        items.pop_front();
+        return v;
+    }
+};
+
+// Owner 交替 push/pop，同时 num_thieves 个线程不停窃取
+template <typename Deque>
+double run_deque_workload(int num_items, int num_thieves) {
+    Deque deque;
+    std::atomic<int> consumed{0};
+    std::atomic<bool> done{false};
+
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < num_thieves; ++i) {
+        thieves.emplace_back([&] {
+            while (!done.load(std::memory_order_acquire)) {
+                if (deque.steal()) {
+                    consumed.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < num_items; ++i) {
+        deque.push(i);
+        if (i % 2 == 1 && deque.pop()) {
+            consumed.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    while (consumed.load(std::memory_order_relaxed) < num_items) {
+        if (deque.pop()) {
+            consumed.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    done.store(true, std::memory_order_release);
+    for (auto& t : thieves)
+        t.join();
+
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+void benchmark_deque_compare() {
+    const int items = 2000000;
+    const int thieves = 2;
+    std::cout << "Comparing work-stealing deques (" << items << " items, "
+              << thieves << " thieves)...\n";
+    double mutex_time = run_deque_workload<MutexDeque>(items, thieves);
+    double chase_lev_time =
+        run_deque_workload<parallel::ChaseLevDeque<int>>(items, thieves);
+    std::cout << "  -> std::deque + mutex: " << mutex_time << "s\n"
+              << "  -> ChaseLevDeque:      " << chase_lev_time << "s ("
+              << (mutex_time / chase_lev_time) << "x)\n";
+}
+
 // ============================================
 // Unit Tests (New Day 3 Content)
 // ============================================
@@ -66,7 +1282,7 @@ TEST(ThreadPoolFast, ConcurrencyStress) {
     const int tasks_per_thread = 1000;
     std::atomic<int> counter{0};
 
-    std::vector<std::future<void>> futures;
+    std::vector<parallel::Future<void>> futures;
     for (int i = 0; i < thread_count * tasks_per_thread; ++i) {
         futures.push_back(pool.submit(
             [&] { counter.fetch_add(1, std::memory_order_relaxed); }));
@@ -95,42 +1311,1892 @@ TEST(ThreadPoolFast, ExceptionSafety) {
     EXPECT_TRUE(caught);
 }
 
-TEST(ThreadPoolPriority, Ordering) {
-    using namespace parallel;
-    ThreadPoolPriority pool(1);    // Single thread to force ordering
+TEST(ThreadPoolFast, WorkerIdentity) {
+    ThreadPoolFast outer(4);
+    ThreadPoolFast inner(1);
 
-    std::vector<int> execution_order;
-    std::vector<std::future<void>> futures;
+    EXPECT_FALSE(outer.current_worker_index().has_value());
 
-    // Fill the pool so next tasks get queued
-    auto blocker = pool.submit(Priority::Normal, [] {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-    });
+    // outer 的 worker 向另一个池提交: 不能误用自己在 outer 中的编号
+    std::vector<parallel::Future<int>> futures;
+    for (int i = 0; i < 16; ++i) {
+        futures.push_back(outer.submit([&] {
+            bool is_outer_worker = outer.current_worker_index().has_value();
+            bool is_inner_worker = inner.current_worker_index().has_value();
+            int nested = inner.submit([] { return 1; }).get();
+            return (is_outer_worker && !is_inner_worker) ? nested : 0;
+        }));
+    }
 
-    // Submit Low then High
-    futures.push_back(
-        pool.submit(Priority::Low, [&] { execution_order.push_back(1); }));
-    futures.push_back(
-        pool.submit(Priority::High, [&] { execution_order.push_back(2); }));
-    futures.push_back(
-        pool.submit(Priority::Low, [&] { execution_order.push_back(1); }));
-    futures.push_back(
-        pool.submit(Priority::High, [&] { execution_order.push_back(2); }));
+    int sum = 0;
+    for (auto& f : futures)
+        sum += f.get();
+    EXPECT_EQ(sum, 16);
+}
 
-    // Wait for blocker
-    blocker.get();
+TEST(ThreadPoolFast, NestedSubmitFromWorker) {
+    ThreadPoolFast pool(2);
+    std::atomic<int> pending{1};
+    std::promise<void> all_done;
+    pool.submit([&] { spawn_tree(pool, 10, pending, all_done); });
 
-    // Wait for all
-    for (auto& f : futures)
-        f.get();
+    auto status =
+        all_done.get_future().wait_for(std::chrono::seconds(10));
+    EXPECT_TRUE(status == std::future_status::ready);
+}
 
-    // Check if any High (2) came after Low (1)?
-    // Actually, with strict priority, ALL Highs should ideally run before Lows if they were in queue.
-    // Since we submitted L, H, L, H while busy:
-    // Queue should look like: H, H, L, L (approx, depending on implementation details)
+TEST(ThreadPoolFast, SubmitNRunsEveryIndex) {
+    ThreadPoolFast pool(4);
+    const size_t count = 10000;
+    std::vector<std::atomic<int>> hits(count);
+    std::atomic<size_t> sum{0};
 
-    // Just verify that we have some Highs
-    EXPECT_TRUE(execution_order.size() == 4);
+    pool.submit_n(count, [&](size_t i) {
+            hits[i].fetch_add(1, std::memory_order_relaxed);
+            sum.fetch_add(i, std::memory_order_relaxed);
+        })
+        .get();
+
+    bool each_once = true;
+    for (auto& h : hits)
+        each_once = each_once && h.load() == 1;
+    EXPECT_TRUE(each_once);
+    EXPECT_EQ(sum.load(), count * (count - 1) / 2);
+    EXPECT_TRUE(pool.submit_n(0, [](size_t) {}).is_ready());
+}
+
+TEST(ThreadPoolFast, SubmitBulkAndErrors) {
+    ThreadPoolFast pool(3);
+    std::atomic<int> counter{0};
+
+    std::vector<std::function<void()>> jobs;
+    for (int i = 0; i < 100; ++i) {
+        jobs.emplace_back([&counter, i] { counter.fetch_add(i); });
+    }
+    pool.submit_bulk(jobs).get();
+    EXPECT_EQ(counter.load(), 4950);
+    EXPECT_EQ(jobs.size(), 100u);    // 左值范围按拷贝提交，原对象仍然可用
+
+    // 任意一个任务失败，整批的 Future 重新抛出异常，但其余任务照常执行
+    std::atomic<int> finished{0};
+    auto fut = pool.submit_n(64, [&](size_t i) {
+        finished.fetch_add(1);
+        if (i == 17)
+            throw std::runtime_error("bad index");
+    });
+    bool caught = false;
+    try {
+        fut.get();
+    } catch (const std::runtime_error&) {
+        caught = true;
+    }
+    EXPECT_TRUE(caught);
+    EXPECT_EQ(finished.load(), 64);
+}
+
+TEST(ThreadPoolFast, SubmitNFromWorker) {
+    ThreadPoolFast pool(2);
+    std::atomic<int> counter{0};
+    auto outer = pool.submit([&] {
+        return pool.submit_n(1000, [&](size_t) { counter.fetch_add(1); });
+    });
+    outer.get().get();
+    EXPECT_EQ(counter.load(), 1000);
+}
+
+TEST(ThreadPoolFast, WakesParkedWorkers) {
+    // 休眠不再有超时: 每一次提交都必须可靠地唤醒已休眠的 worker
+    ThreadPoolFast pool(4);
+    int sum = 0;
+    for (int round = 0; round < 3; ++round) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        for (int i = 0; i < 2000; ++i) {
+            sum += pool.submit([i] { return i & 1; }).get();
+        }
+    }
+    EXPECT_EQ(sum, 3000);
+}
+
+TEST(ParallelFor, CoversEveryIndexOnce) {
+    ThreadPoolFast pool(4);
+    const int n = 100000;
+    std::vector<int> hits(n, 0);
+    parallel::parallel_for(pool, 0, n, [&](int i) { hits[i] += 1; });
+    EXPECT_TRUE(std::all_of(hits.begin(), hits.end(),
+                            [](int h) { return h == 1; }));
+
+    // 从 worker 内部嵌套调用，调用者要边等边帮忙，单线程池也不能死锁
+    ThreadPoolFast single(1);
+    long long nested = single
+                           .submit([&] {
+                               std::atomic<long long> sum{0};
+                               parallel::parallel_for(
+                                   single, 0LL, 10000LL,
+                                   [&](long long i) { sum += i; }, 16LL);
+                               return sum.load();
+                           })
+                           .get();
+    EXPECT_EQ(nested, 10000LL * 9999 / 2);
+
+    bool caught = false;
+    try {
+        parallel::parallel_for(pool, 0, 1000, [](int i) {
+            if (i == 500)
+                throw std::runtime_error("boom");
+        });
+    } catch (const std::runtime_error&) {
+        caught = true;
+    }
+    EXPECT_TRUE(caught);
+}
+
+TEST(TaskGroup, RecursiveQuicksortOnFixedPool) {
+    std::vector<int> data(200000);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = static_cast<int>((i * 7919) % 100003);
+    std::vector<int> expected = data;
+    std::sort(expected.begin(), expected.end());
+
+    // 单线程池: 每一层都在 worker 内部等待子任务，阻塞式等待必然死锁
+    for (size_t threads : {1, 3}) {
+        ThreadPoolFast pool(threads);
+        std::vector<int> copy = data;
+        pool.submit([&] {
+                parallel_quicksort(pool, copy.data(), copy.data() + copy.size());
+            })
+            .get();
+        EXPECT_TRUE(copy == expected);
+    }
+}
+
+TEST(TaskGroup, PropagatesFirstException) {
+    ThreadPoolFast pool(2);
+    parallel::TaskGroup group(pool);
+    std::atomic<int> ran{0};
+    for (int i = 0; i < 8; ++i) {
+        group.run([&ran, i] {
+            ran.fetch_add(1);
+            if (i == 3)
+                throw std::runtime_error("child failed");
+        });
+    }
+    bool caught = false;
+    try {
+        group.wait();
+    } catch (const std::runtime_error&) {
+        caught = true;
+    }
+    EXPECT_TRUE(caught);
+    EXPECT_EQ(ran.load(), 8);
+
+    // 异常取走之后，同一个 group 可以继续使用
+    group.run([&ran] { ran.fetch_add(1); });
+    group.wait();
+    EXPECT_EQ(ran.load(), 9);
+}
+
+TEST(ParallelReduce, SumAndOrder) {
+    ThreadPoolFast pool(4);
+    std::vector<long long> values(100000);
+    for (size_t i = 0; i < values.size(); ++i)
+        values[i] = static_cast<long long>(i);
+    long long sum = parallel::parallel_reduce(pool, values, 0LL, std::plus<>{});
+    EXPECT_EQ(sum, 100000LL * 99999 / 2);
+
+    // 字符串拼接只满足结合律，结果必须保持原顺序
+    std::vector<std::string> words;
+    std::string expected;
+    for (int i = 0; i < 2000; ++i) {
+        words.push_back(std::to_string(i % 10));
+        expected += words.back();
+    }
+    std::string joined = parallel::parallel_reduce(
+        pool, words, std::string(),
+        [](std::string a, const std::string& b) { return a + b; }, 7);
+    EXPECT_TRUE(joined == expected);
+
+    // 粒度为 1 时拆分最多: 各段按拆分树的顺序合并，仍然是原顺序
+    for (int round = 0; round < 20; ++round) {
+        joined = parallel::parallel_reduce(
+            pool, words, std::string(),
+            [](std::string a, const std::string& b) { return a + b; }, 1);
+        EXPECT_TRUE(joined == expected);
+    }
+}
+
+TEST(CpuTopology, ParsesSysfsAndOrdersSteals) {
+    // 伪造一棵 sysfs 目录树: 2 个节点，每个节点 1 个 L3、2 个核心，每个核心 2 个 SMT 线程
+    namespace fs = std::filesystem;
+    fs::path root = fs::temp_directory_path() / "learn_fake_sysfs_cpu";
+    fs::remove_all(root);
+    auto write = [](const fs::path& path, const std::string& text) {
+        fs::create_directories(path.parent_path());
+        std::ofstream(path) << text << "\n";
+    };
+    write(root / "online", "0-7");
+    for (int cpu = 0; cpu < 8; ++cpu) {
+        fs::path dir = root / ("cpu" + std::to_string(cpu));
+        int sibling = cpu ^ 4;    // cpu 与 cpu+4 是同一核心的两个超线程
+        int lo = std::min(cpu, sibling), hi = std::max(cpu, sibling);
+        write(dir / "topology" / "thread_siblings_list",
+              std::to_string(lo) + "," + std::to_string(hi));
+        write(dir / "cache" / "index3" / "level", "3");
+        write(dir / "cache" / "index3" / "shared_cpu_list",
+              (cpu % 4) < 2 ? "0-1,4-5" : "2-3,6-7");
+        fs::create_directories(dir / ((cpu % 4) < 2 ? "node0" : "node1"));
+    }
+
+    auto topology = parallel::CpuTopology::detect(root.string());
+    fs::remove_all(root);
+    EXPECT_EQ(topology.cpus().size(), 8u);
+
+    // 紧凑顺序: 0,4 (同核) 1,5 | 2,6 3,7
+    std::vector<int> order;
+    for (const auto& cpu : topology.compact_order())
+        order.push_back(cpu.cpu);
+    EXPECT_TRUE((order == std::vector<int>{0, 4, 1, 5, 2, 6, 3, 7}));
+
+    // worker i 绑在 order[i] 上: worker 0 先偷 SMT 兄弟 (1)，再偷同 L3 (2, 3)，最后才是远端节点
+    auto steal = parallel::build_steal_order(topology.compact_order());
+    EXPECT_TRUE((steal[0] == std::vector<size_t>{1, 2, 3, 4, 5, 6, 7}));
+    EXPECT_TRUE((steal[5] == std::vector<size_t>{4, 6, 7, 0, 1, 2, 3}));
+    EXPECT_EQ(steal[8].size(), 8u);    // 外部线程: 所有队列
+
+    // 亲和性掩码只允许 2, 5, 7: 其余 CPU 不参与分配；交集为空时不做限制
+    order.clear();
+    for (const auto& cpu : topology.restricted_to({7, 5, 2, 9}).compact_order())
+        order.push_back(cpu.cpu);
+    EXPECT_TRUE((order == std::vector<int>{5, 2, 7}));
+    EXPECT_EQ(topology.restricted_to({9}).cpus().size(), 8u);
+    EXPECT_EQ(topology.restricted_to({}).cpus().size(), 8u);
+}
+
+TEST(ThreadPoolFast, StealHalfDrainsFloodedQueue) {
+    for (size_t batch : {size_t(0), size_t(1), size_t(8)}) {
+        ThreadPoolFast pool(4);
+        pool.set_steal_batch(batch);
+        EXPECT_EQ(pool.steal_batch(), batch == 0 ? 1u : batch);
+        std::atomic<int> counter{0};
+        // 全部任务从 worker 内部提交，进入同一个 deque，其他 worker 只能窃取
+        pool.submit([&] {
+                return pool.submit_n(5000, [&](size_t) { counter.fetch_add(1); });
+            })
+            .get()
+            .get();
+        EXPECT_EQ(counter.load(), 5000);
+    }
+}
+
+TEST(ThreadPoolFast, PinnedWorkers) {
+    ThreadPoolFast pool(2, true);
+    std::atomic<int> counter{0};
+    pool.submit_n(1000, [&](size_t) { counter.fetch_add(1); }).get();
+    EXPECT_EQ(counter.load(), 1000);
+    bool pinned = pool.worker_cpu(0).has_value();
+    EXPECT_TRUE(pinned == !parallel::CpuTopology::system().cpus().empty());
+    // worker 只绑在进程允许运行的 CPU 上
+    std::vector<int> allowed = parallel::allowed_cpus();
+    for (size_t i = 0; pinned && !allowed.empty() && i < 2; ++i) {
+        EXPECT_TRUE(std::find(allowed.begin(), allowed.end(),
+                              *pool.worker_cpu(i)) != allowed.end());
+    }
+}
+
+TEST(ThreadPoolFast, ResizeKeepsInFlightTasks) {
+    ThreadPoolFast pool(4, false, 4);
+    EXPECT_EQ(pool.capacity(), 4u);
+    std::atomic<int> counter{0};
+    std::vector<parallel::Future<void>> futures;
+    // 一边提交 (外部 + worker 内部)，一边反复扩容/缩容，任务一个都不能丢
+    for (size_t round = 0; round < 20; ++round) {
+        futures.push_back(
+            pool.submit_n(500, [&](size_t) { counter.fetch_add(1); }));
+        futures.push_back(pool.submit([&] {
+            // 只剩一个 worker 时不能阻塞等待自己的子任务，边等边执行
+            pool.help_until_ready(
+                pool.submit_n(100, [&](size_t) { counter.fetch_add(1); }));
+        }));
+        pool.resize(round % 4 + 1);
+        EXPECT_EQ(pool.size(), round % 4 + 1);
+    }
+    for (auto& f : futures) {
+        f.get();
+    }
+    EXPECT_EQ(counter.load(), 20 * 600);
+
+    pool.resize(0);    // 至少保留一个 worker
+    EXPECT_EQ(pool.size(), 1u);
+    pool.resize(100);
+    EXPECT_EQ(pool.size(), 4u);
+}
+
+TEST(ThreadPoolFast, AutoResizeGrowsAndShrinks) {
+    ThreadPoolFast pool(1, false, 3);
+    parallel::ElasticPolicy policy;
+    policy.grow_after = std::chrono::milliseconds(2);
+    policy.linger = std::chrono::milliseconds(20);
+    policy.sample_interval = std::chrono::milliseconds(1);
+    pool.enable_auto_resize(policy);
+
+    // 阻塞型任务把唯一的 worker 占满，排队的任务应该触发扩容
+    size_t peak = 1;
+    auto batch = pool.submit_n(200, [](size_t) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    });
+    while (!batch.is_ready()) {
+        peak = std::max(peak, pool.size());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    batch.get();
+    EXPECT_TRUE(peak > 1);
+
+    // 空闲一段时间后退回到 min_threads
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (pool.size() > 1 && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    EXPECT_EQ(pool.size(), 1u);
+}
+
+// 计数在任务完成 (Future 就绪) 之后才累加，等它追上来
+template <typename GetStats>
+parallel::PoolStats wait_for_executed(GetStats get_stats, uint64_t expected) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    parallel::PoolStats stats = get_stats();
+    while (stats.total.executed < expected &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+        stats = get_stats();
+    }
+    return stats;
+}
+
+TEST(ThreadPoolFast, StatsCountTasksAndSteals) {
+    ThreadPoolFast pool(4);
+    pool.submit([&] { return pool.submit_n(5000, [](size_t) {}); })
+        .get()
+        .get();
+    auto stats = wait_for_executed([&] { return pool.stats(); }, 5001);
+    EXPECT_EQ(stats.workers.size(), pool.capacity());
+    EXPECT_EQ(stats.total.executed, 5001u);
+    // 偷来的任务可能再次被别的 worker 偷走，stolen 不一定小于 executed
+    EXPECT_TRUE(stats.total.steals <= stats.total.stolen);
+    EXPECT_EQ(stats.total.queue_depth, 0u);
+    EXPECT_TRUE(stats.executed_by_priority.empty());
+}
+
+TEST(LatencyHistogram, PercentilesAndMerge) {
+    parallel::LatencyHistogram histogram;
+    for (uint64_t ns = 1; ns <= 1000; ++ns) {
+        histogram.record(ns);
+    }
+    auto snapshot = histogram.snapshot();
+    EXPECT_EQ(snapshot.count(), 1000u);
+    // 分位数是所在桶的上界: 不小于真实值，误差不超过 1/32
+    auto within = [](std::chrono::nanoseconds got, int64_t expected) {
+        return got.count() >= expected && got.count() <= expected * 33 / 32;
+    };
+    EXPECT_TRUE(within(snapshot.p50(), 500));
+    EXPECT_TRUE(within(snapshot.p99(), 990));
+    EXPECT_TRUE(within(snapshot.p999(), 999));
+
+    snapshot.merge(histogram.snapshot());
+    EXPECT_EQ(snapshot.count(), 2000u);
+    EXPECT_TRUE(within(snapshot.p50(), 500));
+    EXPECT_EQ(parallel::HistogramSnapshot().p99().count(), 0);
+}
+
+TEST(ThreadPoolFast, LatencyTracking) {
+    ThreadPoolFast pool(2);
+    pool.submit_n(100, [](size_t) {}).get();    // 未开启: 不记录
+    pool.set_latency_tracking(true);
+    pool.submit_n(1000, [](size_t) {}).get();
+    pool.submit([] {}).get();
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (pool.latency().total.run_time.count() < 1001 &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    auto latency = pool.latency().total;
+    EXPECT_EQ(latency.queue_wait.count(), 1001u);
+    EXPECT_EQ(latency.run_time.count(), 1001u);
+    EXPECT_TRUE(latency.queue_wait.p50() <= latency.queue_wait.p999());
+}
+
+TEST(ThreadPoolFast, PostRoutesExceptionsToHandler) {
+    ThreadPoolFast pool(2);
+    std::atomic<int> ran{0};
+    std::atomic<int> errors{0};
+    pool.set_exception_handler([&](std::exception_ptr error) {
+        try {
+            std::rethrow_exception(error);
+        } catch (const std::runtime_error&) {
+            errors.fetch_add(1);
+        }
+    });
+
+    for (int i = 0; i < 100; ++i) {
+        pool.post([&ran](int v) { ran.fetch_add(v); }, 1);
+    }
+    pool.post([] { throw std::runtime_error("post failed"); });
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((ran.load() < 100 || errors.load() < 1) &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(ran.load(), 100);
+    EXPECT_EQ(errors.load(), 1);
+
+    // 小任务连同异常去处一起放在 InlineTask 的内联缓冲区里，post 不分配内存
+    auto small = [&ran] { ran.fetch_add(1); };
+    EXPECT_TRUE(parallel::InlineTask::stores_inline<
+                parallel::detail::PostedCall<decltype(small)>>);
+}
+
+TEST(ThreadPoolPriority, PostRunsAtPriority) {
+    using namespace parallel;
+    ThreadPoolPriority pool(2);
+    std::atomic<int> ran{0};
+    pool.post(Priority::High, [&] { ran.fetch_add(1); });
+    pool.post([&] { ran.fetch_add(1); });
+    pool.post(Priority::Low, [&](int v) { ran.fetch_add(v); }, 1);
+    pool.submit(Priority::Low, [] {}).get();
+
+    auto stats = wait_for_executed([&] { return pool.stats(); }, 4);
+    EXPECT_EQ(ran.load(), 3);
+    EXPECT_EQ(stats.executed_by_priority[0], 1u);
+    EXPECT_EQ(stats.executed_by_priority[1], 1u);
+    EXPECT_EQ(stats.executed_by_priority[2], 2u);
+}
+
+TEST(ThreadPoolFast, IdlePolicies) {
+    using parallel::IdleStrategy;
+    ThreadPoolFast pool(2);
+    for (auto strategy : {IdleStrategy::Park, IdleStrategy::SpinThenPark,
+                          IdleStrategy::SpinThenYield, IdleStrategy::Spin}) {
+        pool.set_idle_policy({strategy, 64});
+        EXPECT_TRUE(pool.idle_policy().strategy == strategy);
+        int sum = 0;
+        for (int i = 0; i < 200; ++i) {
+            sum += pool.submit([i] { return i; }).get();
+        }
+        EXPECT_EQ(sum, 19900);
+    }
+
+    // 一直自旋: 空闲的 worker 仍然算作空闲，但不再休眠
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_TRUE(pool.has_idle_workers());
+    uint64_t parks = pool.stats().total.parks;
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(pool.stats().total.parks, parks);
+    pool.set_idle_policy({IdleStrategy::Park, 0});
+}
+
+TEST(ThreadPoolPriority, IdlePolicies) {
+    using namespace parallel;
+    ThreadPoolPriority pool(2);
+    pool.set_idle_policy({IdleStrategy::SpinThenYield, 16});
+    int sum = 0;
+    for (int i = 0; i < 100; ++i) {
+        sum += pool.submit(Priority::High, [i] { return i; }).get();
+    }
+    EXPECT_EQ(sum, 4950);
+    pool.set_idle_policy({IdleStrategy::SpinThenPark, 16});
+    EXPECT_EQ(pool.submit([] { return 1; }).get(), 1);
+}
+
+TEST(ThreadPoolFast, TenantWeightedShares) {
+    ThreadPoolFast pool(1);
+    std::atomic<bool> release{false};
+    std::atomic<bool> blocked{false};
+    pool.post([&] {
+        blocked.store(true);
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    while (!blocked.load()) {
+        std::this_thread::yield();
+    }
+
+    // 两个租户都积压着 400 个任务: 权重 3:1，前 200 个里大约 150 个属于 heavy
+    parallel::TenantId heavy = pool.add_tenant({3, 1024});
+    parallel::TenantId light = pool.add_tenant({1, 1024});
+    EXPECT_EQ(heavy, 1u);
+    EXPECT_EQ(light, 2u);
+    std::mutex mtx;
+    std::string order;
+    for (int i = 0; i < 400; ++i) {
+        for (auto [tenant, name] : {std::pair{heavy, 'h'}, {light, 'l'}}) {
+            EXPECT_TRUE(pool.try_post_as(tenant, [&, name = name] {
+                std::lock_guard<std::mutex> lock(mtx);
+                order.push_back(name);
+            }));
+        }
+    }
+    release.store(true);
+
+    auto stats = wait_for_executed([&] { return pool.stats(); }, 801);
+    EXPECT_EQ(stats.tenants.size(), 3u);
+    EXPECT_EQ(stats.tenants[heavy].executed, 400u);
+    EXPECT_EQ(stats.tenants[light].executed, 400u);
+    EXPECT_EQ(stats.tenants[heavy].weight, 3u);
+    std::lock_guard<std::mutex> lock(mtx);
+    auto heavy_first =
+        std::count(order.begin(), order.begin() + 200, 'h');
+    EXPECT_TRUE(heavy_first >= 140 && heavy_first <= 160);
+}
+
+TEST(ThreadPoolFast, TenantRepickWhenChosenQueueRaces) {
+    ThreadPoolFast pool(4);
+    // hot 的权重更大，队列看起来非空时大多会被选中；它被生产者和其他 worker
+    // 不停地填入、取空，选中后 try_pop 经常失败。这时必须改选 cold，不能空手返回
+    parallel::TenantId hot = pool.add_tenant({4, 4096});
+    parallel::TenantId cold = pool.add_tenant({1, 4096});
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> hot_accepted{0};
+    std::vector<std::thread> producers;
+    for (int p = 0; p < 2; ++p) {
+        producers.emplace_back([&] {
+            while (!stop.load()) {
+                if (pool.try_post_as(hot, [] {})) {
+                    hot_accepted.fetch_add(1);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::atomic<int> cold_ran{0};
+    for (int i = 0; i < 400; ++i) {
+        EXPECT_TRUE(pool.try_post_as(cold, [&] { cold_ran.fetch_add(1); }));
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (cold_ran.load() < 400 &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(cold_ran.load(), 400);
+    stop.store(true);
+    for (auto& t : producers) {
+        t.join();
+    }
+
+    // 租户计数在 worker 的总执行数之后才累加: 等租户计数本身追上来
+    deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    auto stats = pool.stats();
+    while (stats.tenants[hot].executed + stats.tenants[cold].executed <
+               hot_accepted.load() + 400 &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+        stats = pool.stats();
+    }
+    EXPECT_EQ(stats.tenants[hot].executed, hot_accepted.load());
+    EXPECT_EQ(stats.tenants[cold].executed, 400u);
+}
+
+TEST(TimerWheel, FiresOnExactTicksAcrossLevels) {
+    using namespace parallel;
+    TimerWheel wheel(1000);
+    std::vector<std::vector<InlineTask>> out(2);
+    std::vector<uint64_t> fired;
+    auto run_due = [&] {
+        for (auto& tasks : out) {
+            for (auto& task : tasks) {
+                task();
+            }
+            tasks.clear();
+        }
+    };
+
+    // 分别落在第 0 / 1 / 2 / 3 层，另有一个已经过去的时刻和一个被取消的
+    std::vector<uint64_t> expiries = {1003, 1300, 71000, 20001000};
+    for (uint64_t e : expiries) {
+        wheel.add(e, 1, [&fired, e] { fired.push_back(e); });
+    }
+    wheel.add(10, 0, [&fired] { fired.push_back(10); });
+    TimerId dropped = wheel.add(1500, 0, [&fired] { fired.push_back(1500); });
+    InlineTask removed;
+    EXPECT_TRUE(wheel.cancel(dropped, removed));
+    EXPECT_TRUE(!wheel.cancel(dropped, removed));
+    EXPECT_EQ(wheel.size(), 5u);
+
+    wheel.advance(1000, out);
+    run_due();
+    EXPECT_EQ(fired, std::vector<uint64_t>{10});
+    for (uint64_t e : expiries) {
+        EXPECT_TRUE(wheel.next_due().value() <= e);
+        wheel.advance(e - 1, out);
+        run_due();
+        EXPECT_TRUE(fired.back() != e);
+        wheel.advance(e, out);
+        run_due();
+        EXPECT_EQ(fired.back(), e);
+    }
+    EXPECT_EQ(fired.size(), 5u);
+    EXPECT_TRUE(!wheel.next_due().has_value());
+
+    // 周期任务: 每 100 个 tick 一次，上一次没执行完时跳过
+    auto body = std::make_shared<detail::PeriodicBody>(
+        InlineTask([&fired] { fired.push_back(0); }));
+    TimerId every = wheel.add_periodic(20001100, 100, 0, body);
+    wheel.advance(20001100, out);
+    wheel.advance(20001200, out);
+    EXPECT_EQ(out[0].size(), 1u);
+    run_due();
+    wheel.advance(20001300, out);
+    EXPECT_EQ(out[0].size(), 1u);
+    EXPECT_TRUE(wheel.cancel(every, removed));
+    run_due();    // 取消之前已经交出的那一次也不再执行
+    EXPECT_EQ(fired.size(), 6u);
+    EXPECT_EQ(wheel.size(), 0u);
+}
+
+TEST(ThreadPoolFast, DelayedAndPeriodicTasks) {
+    using namespace std::chrono_literals;
+    ThreadPoolFast pool(2);
+    auto start = parallel::TimerClock::now();
+    auto later = pool.submit_after(
+        20ms, [start] { return parallel::TimerClock::now() - start; });
+    auto at = pool.submit_at(start + 5ms, [] { return 3; });
+
+    std::atomic<int> dropped_ran{0};
+    parallel::TimerId dropped =
+        pool.post_after(10ms, [&] { dropped_ran.fetch_add(1); });
+    EXPECT_TRUE(pool.cancel_timer(dropped));
+    EXPECT_TRUE(!pool.cancel_timer(dropped));
+
+    std::atomic<int> ticks{0};
+    parallel::TimerId every =
+        pool.submit_every(2ms, [&] { ticks.fetch_add(1); });
+    EXPECT_EQ(at.get(), 3);
+    EXPECT_TRUE(later.get() >= 20ms);
+    while (ticks.load() < 3) {
+        std::this_thread::yield();
+    }
+    EXPECT_TRUE(pool.cancel_timer(every));
+    int after_cancel = ticks.load();
+    std::this_thread::sleep_for(10ms);
+    EXPECT_TRUE(ticks.load() <= after_cancel + 1);    // 取消时可能正在执行一次
+    EXPECT_EQ(dropped_ran.load(), 0);
+
+    // 析构时丢弃还没到期的定时器，不等待
+    pool.post_after(1h, [] {});
+    EXPECT_EQ(pool.pending_timers(), 1u);
+}
+
+TEST(ThreadPoolFast, TenantQueueLimit) {
+    ThreadPoolFast pool(1);
+    std::atomic<bool> release{false};
+    std::atomic<bool> blocked{false};
+    pool.post([&] {
+        blocked.store(true);
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    while (!blocked.load()) {
+        std::this_thread::yield();
+    }
+
+    // 超过上限的提交被拒绝，不影响其他租户
+    parallel::TenantId noisy = pool.add_tenant({1, 8});
+    std::atomic<int> ran{0};
+    int accepted = 0;
+    for (int i = 0; i < 10; ++i) {
+        accepted += pool.try_post_as(noisy, [&] { ran.fetch_add(1); });
+    }
+    EXPECT_EQ(accepted, 8);
+    bool rejected = false;
+    try {
+        pool.submit_as(noisy, [] {}).get();
+    } catch (const parallel::TenantQueueFull&) {
+        rejected = true;
+    }
+    EXPECT_TRUE(rejected);
+    auto other = pool.submit_as(parallel::kDefaultTenant, [] { return 5; });
+    EXPECT_EQ(pool.stats().tenants[noisy].queued, 8u);
+    release.store(true);
+    EXPECT_EQ(other.get(), 5);
+
+    auto stats = wait_for_executed([&] { return pool.stats(); }, 10);
+    EXPECT_EQ(ran.load(), 8);
+    EXPECT_EQ(stats.tenants[noisy].rejected, 3u);
+    EXPECT_EQ(stats.tenants[noisy].executed, 8u);
+    EXPECT_TRUE(stats.tenants[noisy].busy_ns > 0);
+
+    // 槽位用完之后注册失败
+    bool overflow = false;
+    try {
+        for (size_t i = 0; i < ThreadPoolFast::kMaxTenants; ++i) {
+            pool.add_tenant();
+        }
+    } catch (const std::length_error&) {
+        overflow = true;
+    }
+    EXPECT_TRUE(overflow);
+}
+
+TEST(ThreadPoolFast, SubmitAsStaysInTenantQueue) {
+    ThreadPoolFast pool(1);
+    std::atomic<bool> release{false};
+    std::atomic<bool> blocked{false};
+    pool.post([&] {
+        blocked.store(true);
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    while (!blocked.load()) {
+        std::this_thread::yield();
+    }
+
+    // 多个提交者同时挤向只有 8 个槽位的租户队列: 放不进去的一律按拒绝处理，
+    // 不会绕到 worker 的 inbox 里 (那样既不受上限约束，也不计入租户统计)
+    parallel::TenantId tenant = pool.add_tenant({1, 8});
+    std::mutex mtx;
+    std::vector<parallel::Future<int>> futures;
+    std::vector<std::thread> producers;
+    for (int p = 0; p < 4; ++p) {
+        producers.emplace_back([&] {
+            for (int i = 0; i < 50; ++i) {
+                auto f = pool.submit_as(tenant, [] { return 1; });
+                std::lock_guard<std::mutex> lock(mtx);
+                futures.push_back(std::move(f));
+            }
+        });
+    }
+    for (auto& t : producers) {
+        t.join();
+    }
+    EXPECT_TRUE(pool.stats().tenants[tenant].queued <= 8u);
+    release.store(true);
+
+    uint64_t accepted = 0;
+    uint64_t rejected = 0;
+    for (auto& f : futures) {
+        try {
+            accepted += static_cast<uint64_t>(f.get());
+        } catch (const parallel::TenantQueueFull&) {
+            ++rejected;
+        }
+    }
+    EXPECT_EQ(accepted + rejected, 200u);
+    EXPECT_TRUE(accepted <= 8u);
+    // 租户计数在任务 (和它的 Future) 完成之后才累加，等它追上来
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    auto stats = pool.stats();
+    while (stats.tenants[tenant].executed < accepted &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+        stats = pool.stats();
+    }
+    EXPECT_EQ(stats.tenants[tenant].rejected, rejected);
+    EXPECT_EQ(stats.tenants[tenant].executed, accepted);
+}
+
+TEST(ThreadPoolFast, InjectionQueueBackpressure) {
+    ThreadPoolFast pool(1);
+    std::atomic<bool> release{false};
+    std::atomic<bool> blocked{false};
+    pool.post([&] {
+        blocked.store(true);
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    while (!blocked.load()) {
+        std::this_thread::yield();
+    }
+
+    // worker 被占住: 注入队列写满后 try_post 返回 false，post 退回到 inbox 照常入队
+    std::atomic<size_t> ran{0};
+    size_t accepted = 0;
+    while (pool.try_post([&ran] { ran.fetch_add(1); })) {
+        ++accepted;
+    }
+    EXPECT_EQ(accepted, pool.injection_capacity());
+    pool.post([&ran] { ran.fetch_add(1); });
+    EXPECT_EQ(pool.stats().total.queue_depth, accepted + 1);
+
+    release.store(true);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (ran.load() < accepted + 1 &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    EXPECT_EQ(ran.load(), accepted + 1);
+}
+
+TEST(ThreadPoolFast, InjectionQueueNotStarvedByLocalWork) {
+    // 唯一的 worker 不断派生本地子任务，外部提交的任务仍然要在有限步内执行
+    ThreadPoolFast pool(1);
+    std::atomic<bool> external_ran{false};
+    std::atomic<int> hops{0};
+    std::atomic<int> ran_at{-1};
+    std::function<void()> hop = [&] {
+        if (!external_ran.load() && hops.fetch_add(1) < 10000000) {
+            pool.post(hop);
+        }
+    };
+    pool.post(hop);
+    while (hops.load() == 0) {
+        std::this_thread::yield();
+    }
+    int posted_at = hops.load();
+    pool.post([&] {
+        ran_at.store(hops.load());
+        external_ran.store(true);
+    });
+    while (!external_ran.load()) {
+        std::this_thread::yield();
+    }
+    EXPECT_TRUE(ran_at.load() - posted_at < 100000);
+}
+
+TEST(WorkerArena, BumpRewindAndGrow) {
+    parallel::WorkerArena arena(256);
+    EXPECT_EQ(arena.reserved(), 0u);
+
+    void* first = arena.allocate(24, 8);
+    void* aligned = arena.allocate(32, 64);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(aligned) % 64, 0u);
+    auto mark = arena.checkpoint();
+
+    // 超过块大小: 追加新块，旧块保留
+    void* big = arena.allocate(1000, 16);
+    EXPECT_TRUE(big != nullptr);
+    EXPECT_TRUE(arena.reserved() >= 256u + 1000u);
+
+    // 退回之后同样的请求拿到同样的地址，不再申请新块
+    size_t reserved = arena.reserved();
+    arena.rewind(mark);
+    EXPECT_TRUE(arena.allocate(1000, 16) == big);
+    arena.reset();
+    EXPECT_EQ(arena.used(), 0u);
+    EXPECT_TRUE(arena.allocate(24, 8) == first);
+    EXPECT_EQ(arena.reserved(), reserved);
+}
+
+TEST(ThreadPoolFast, WorkerArenaResetsPerTask) {
+    ThreadPoolFast pool(1);
+    EXPECT_TRUE(parallel::current_worker_arena() == nullptr);
+
+    // 任务内的 pmr 容器只在第一次申请内存块，之后每个任务都从同一个位置开始
+    auto task = [] {
+        size_t before = allocation_count();
+        auto* arena = parallel::current_worker_arena();
+        size_t start = arena->used();
+        std::pmr::vector<int> values(arena);
+        for (int i = 0; i < 1000; ++i) {
+            values.push_back(i);
+        }
+        EXPECT_EQ(start, 0u);
+        return allocation_count() - before;
+    };
+    pool.submit(task).get();
+    size_t allocations = 0;
+    for (int i = 0; i < 10; ++i) {
+        allocations += pool.submit(task).get();
+    }
+    EXPECT_EQ(allocations, 0u);
+
+    // 嵌套执行的任务只回收自己的部分
+    auto nested = pool.submit([&pool] {
+        auto* arena = parallel::current_worker_arena();
+        std::pmr::vector<int> outer({1, 2, 3}, arena);
+        size_t used = arena->used();
+        auto inner = pool.submit([] {
+            std::pmr::vector<int> scratch(100, 7,
+                                          parallel::current_memory_resource());
+            return scratch.size();
+        });
+        pool.help_until_ready(inner);
+        return inner.get() == 100 && arena->used() == used &&
+               outer[2] == 3;
+    });
+    EXPECT_TRUE(nested.get());
+}
+
+TEST(ThreadPoolPriority, WorkerArena) {
+    using namespace parallel;
+    ThreadPoolPriority pool(1);
+    auto used = pool.submit(Priority::High, [] {
+        std::pmr::string text(current_memory_resource());
+        text.assign(500, 'x');
+        return current_worker_arena()->used();
+    });
+    EXPECT_TRUE(used.get() >= 500u);
+    EXPECT_EQ(pool.submit([] { return current_worker_arena()->used(); }).get(),
+              0u);
+}
+
+TEST(ThreadPoolPriority, AgingBoundsLowPriorityBypass) {
+    using namespace parallel;
+    for (uint32_t max_bypass : {0u, 4u}) {
+        ThreadPoolPriority pool(1);
+        pool.set_aging_policy({max_bypass});
+        EXPECT_EQ(pool.aging_policy().max_bypass, max_bypass);
+
+        // 先占住唯一的 worker，让所有任务都排进同一个队列
+        std::atomic<bool> release{false};
+        std::atomic<bool> blocked{false};
+        pool.post([&] {
+            blocked.store(true);
+            while (!release.load()) {
+                std::this_thread::yield();
+            }
+        });
+        while (!blocked.load()) {
+            std::this_thread::yield();
+        }
+
+        std::mutex mtx;
+        std::string seen;
+        auto record = [&](char level) {
+            std::lock_guard<std::mutex> lock(mtx);
+            seen.push_back(level);
+        };
+        for (int i = 0; i < 5; ++i) {
+            pool.post(Priority::Low, record, 'L');
+        }
+        for (int i = 0; i < 20; ++i) {
+            pool.post(Priority::High, record, 'H');
+        }
+        release.store(true);
+        auto stats = wait_for_executed([&] { return pool.stats(); }, 26);
+        std::lock_guard<std::mutex> lock(mtx);
+
+        if (max_bypass == 0) {
+            // 关闭时是严格优先级: Low 等到 High 全部执行完
+            EXPECT_EQ(seen, std::string(20, 'H') + std::string(5, 'L'));
+            EXPECT_EQ(stats.promoted_by_priority[2], 0u);
+        } else {
+            EXPECT_EQ(seen.substr(0, 10), std::string("HHHHLHHHHL"));
+            // 最后一个 Low 执行时已经没有 High 了，不算提前
+            EXPECT_EQ(stats.promoted_by_priority[2], 4u);
+        }
+        EXPECT_TRUE(stats.bypassed_by_priority[2] >= 20u);
+        EXPECT_EQ(stats.bypassed_by_priority[0], 0u);
+    }
+}
+
+TEST(ThreadPoolPriority, DeadlineTasksRunEarliestFirst) {
+    using namespace parallel;
+    using namespace std::chrono_literals;
+    ThreadPoolPriority pool(1);
+    std::atomic<bool> release{false};
+    std::atomic<bool> blocked{false};
+    pool.post([&] {
+        blocked.store(true);
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    while (!blocked.load()) {
+        std::this_thread::yield();
+    }
+
+    std::mutex mtx;
+    std::string order;
+    auto record = [&](char name) {
+        std::lock_guard<std::mutex> lock(mtx);
+        order.push_back(name);
+        return name;
+    };
+    auto now = std::chrono::steady_clock::now();
+    pool.post(Priority::High, record, 'H');
+    auto c = pool.submit_by(now + 30s, record, 'c');
+    auto a = pool.submit_by(now + 10s, record, 'a');
+    auto b = pool.submit_by(now + 20s, record, 'b');
+    release.store(true);
+
+    // 截止时间任务按截止时间先后执行，并且排在 High 之前
+    EXPECT_EQ(c.get(), 'c');
+    EXPECT_EQ(a.get(), 'a');
+    EXPECT_EQ(b.get(), 'b');
+    wait_for_executed([&] { return pool.stats(); }, 5);
+    std::lock_guard<std::mutex> lock(mtx);
+    EXPECT_EQ(order, std::string("abcH"));
+}
+
+TEST(ThreadPoolPriority, ExpiredDeadlinesAreDropped) {
+    using namespace parallel;
+    ThreadPoolPriority pool(2);
+    std::atomic<int> ran{0};
+    std::atomic<int> dropped{0};
+    pool.set_exception_handler([&](std::exception_ptr error) {
+        try {
+            std::rethrow_exception(error);
+        } catch (const DeadlineExceeded&) {
+            dropped.fetch_add(1);
+        }
+    });
+
+    auto past = std::chrono::steady_clock::now() - std::chrono::seconds(1);
+    auto expired = pool.submit_by(past, [&] { return ran.fetch_add(1); });
+    bool threw = false;
+    try {
+        expired.get();
+    } catch (const DeadlineExceeded&) {
+        threw = true;
+    }
+    EXPECT_TRUE(threw);
+    pool.post_by(past, [&] { ran.fetch_add(1); });
+
+    auto future = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    EXPECT_EQ(pool.submit_by(future, [] { return 7; }).then([](int v) {
+                      return v * 2;
+                  }).get(),
+              14);
+
+    auto stats = wait_for_executed([&] { return pool.stats(); }, 4);
+    EXPECT_EQ(ran.load(), 0);
+    EXPECT_EQ(dropped.load(), 1);
+    EXPECT_EQ(stats.deadline_expired, 2u);
+    EXPECT_EQ(stats.deadline_late, 0u);
+    EXPECT_EQ(stats.deadline_executed, 3u);
+}
+
+TEST(ThreadPoolPriority, CustomLevelCount) {
+    using namespace parallel;
+    BasicThreadPoolPriority<5> pool(1);
+    EXPECT_EQ(pool.kLevels, 5u);
+    std::atomic<bool> release{false};
+    std::atomic<bool> blocked{false};
+    pool.post([&] {
+        blocked.store(true);
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    while (!blocked.load()) {
+        std::this_thread::yield();
+    }
+
+    // 从最低的级别往上提交，执行顺序应该反过来；越界的级别按 Normal (第 1 级) 处理，同一级别内先进先出
+    std::mutex mtx;
+    std::string order;
+    for (int level : {4, 3, 2, 9, 1, 0}) {
+        pool.post(static_cast<Priority>(level), [&, level] {
+            std::lock_guard<std::mutex> lock(mtx);
+            order.push_back(static_cast<char>('0' + level));
+        });
+    }
+    release.store(true);
+
+    auto stats = wait_for_executed([&] { return pool.stats(); }, 7);
+    EXPECT_EQ(stats.executed_by_priority.size(), 5u);
+    EXPECT_EQ(stats.executed_by_priority[1], 3u);    // Normal 的阻塞任务 + 1 + 越界的 9
+    EXPECT_EQ(stats.executed_by_priority[4], 1u);
+    EXPECT_EQ(pool.latency().by_priority.size(), 5u);
+    std::lock_guard<std::mutex> lock(mtx);
+    EXPECT_EQ(order, std::string("091234"));
+}
+
+TEST(ThreadPoolPriority, SingleLevelIsFifo) {
+    using namespace parallel;
+    BasicThreadPoolPriority<1> pool(1);
+    std::vector<int> order;
+    std::vector<Future<void>> futures;
+    auto blocker = pool.submit(
+        [] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); });
+    futures.push_back(pool.submit(Priority::Low, [&] { order.push_back(0); }));
+    futures.push_back(pool.submit(Priority::High, [&] { order.push_back(1); }));
+    futures.push_back(
+        pool.submit(Priority::Normal, [&] { order.push_back(2); }));
+    blocker.get();
+    for (auto& f : futures) {
+        f.get();
+    }
+    EXPECT_EQ(order, (std::vector<int>{0, 1, 2}));
+    EXPECT_EQ(pool.stats().executed_by_priority.size(), 1u);
+}
+
+TEST(ThreadPoolPriority, SharedLanesKeepPriorityOrder) {
+    using namespace parallel;
+    ThreadPoolPriority pool(1);
+    EXPECT_EQ(pool.shared_levels(), 1u);
+    pool.set_shared_levels(9);
+    EXPECT_EQ(pool.shared_levels(), 3u);
+    pool.set_shared_levels(2);
+
+    std::atomic<bool> release{false};
+    std::atomic<bool> blocked{false};
+    pool.post(Priority::Low, [&] {
+        blocked.store(true);
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    while (!blocked.load()) {
+        std::this_thread::yield();
+    }
+
+    // 超过通道容量的部分退回到本地队列；之后关闭通道，已经在通道里的任务也不能丢
+    const int per_level = static_cast<int>(pool.kSharedLaneCapacity) + 50;
+    std::mutex mtx;
+    std::vector<int> order;
+    for (int level : {2, 1, 0}) {
+        for (int i = 0; i < per_level; ++i) {
+            pool.post(static_cast<Priority>(level), [&, level] {
+                std::lock_guard<std::mutex> lock(mtx);
+                order.push_back(level);
+            });
+        }
+    }
+    EXPECT_EQ(pool.stats().total.queue_depth,
+              static_cast<uint64_t>(3 * per_level));
+    pool.set_shared_levels(0);
+    release.store(true);
+
+    wait_for_executed([&] { return pool.stats(); }, 3 * per_level + 1);
+    std::lock_guard<std::mutex> lock(mtx);
+    EXPECT_EQ(order.size(), static_cast<size_t>(3 * per_level));
+    EXPECT_TRUE(std::is_sorted(order.begin(), order.end()));
+}
+
+TEST(ThreadPoolPriority, ReservedWorkersOnlyRunHigh) {
+    using namespace parallel;
+    WorkerClasses classes;
+    classes.reserved = 1;
+    ThreadPoolPriority pool(1, 1, classes);
+    EXPECT_EQ(pool.reserved_workers(), 1u);
+    pool.set_shared_levels(0);    // High 留在本地队列里，专用 worker 也要找得到
+
+    // 唯一的普通 worker 被 Low 任务占住
+    std::atomic<bool> release{false};
+    std::atomic<bool> blocked{false};
+    pool.post(Priority::Low, [&] {
+        blocked.store(true);
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    while (!blocked.load()) {
+        std::this_thread::yield();
+    }
+
+    std::atomic<bool> normal_ran{false};
+    pool.post(Priority::Normal, [&] { normal_ran.store(true); });
+    for (int i = 0; i < 20; ++i) {
+        EXPECT_EQ(pool.submit(Priority::High, [] { return 7; }).get(), 7);
+    }
+    pool.set_shared_levels(1);
+    EXPECT_EQ(pool.submit(Priority::High, [] { return 8; }).get(), 8);
+    EXPECT_TRUE(!normal_ran.load());
+
+    release.store(true);
+    wait_for_executed([&] { return pool.stats(); }, 23);
+    EXPECT_TRUE(normal_ran.load());
+    PoolStats stats = pool.stats();
+    EXPECT_EQ(stats.reserved_workers.size(), 1u);
+    EXPECT_EQ(stats.reserved_workers[0].executed, 21u);
+    EXPECT_EQ(stats.executed_by_priority[0], 21u);
+}
+
+#ifdef __linux__
+TEST(ThreadSched, AppliesNiceAndAllowedCpus) {
+    using namespace parallel;
+    std::vector<int> allowed = allowed_cpus();
+    EXPECT_TRUE(!allowed.empty());
+
+    std::thread([&] {
+        // 不在允许范围内的 CPU 被忽略，亲和性不变
+        ThreadSchedParams outside;
+        outside.cpus = {-1, CPU_SETSIZE};
+        EXPECT_TRUE(!apply_thread_sched(outside).affinity);
+        EXPECT_EQ(allowed_cpus(), allowed);
+
+        ThreadSchedParams params;
+        params.nice = 3;
+        params.cpus = {allowed.back(), CPU_SETSIZE};
+        AppliedSched applied = apply_thread_sched(params);
+        EXPECT_TRUE(applied.nice && applied.affinity && !applied.realtime);
+        EXPECT_EQ(getpriority(PRIO_PROCESS, static_cast<id_t>(gettid())), 3);
+        EXPECT_EQ(allowed_cpus(), std::vector<int>{allowed.back()});
+
+        // 没有实时调度的权限时退回 nice
+        ThreadSchedParams realtime;
+        realtime.realtime_priority = 1;
+        realtime.nice = 4;
+        applied = apply_thread_sched(realtime);
+        if (applied.realtime) {
+            EXPECT_EQ(sched_getscheduler(0), SCHED_FIFO);
+        } else {
+            EXPECT_TRUE(applied.nice);
+            EXPECT_EQ(getpriority(PRIO_PROCESS, static_cast<id_t>(gettid())),
+                      4);
+        }
+    }).join();
+}
+#endif
+
+TEST(ThreadPoolPriority, TimersKeepPriority) {
+    using namespace parallel;
+    ThreadPoolPriority pool(1);
+    std::atomic<bool> release{false};
+    std::atomic<bool> blocked{false};
+    pool.post(Priority::Low, [&] {
+        blocked.store(true);
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+    });
+    while (!blocked.load()) {
+        std::this_thread::yield();
+    }
+
+    // 同一时刻到期: 按各自的优先级入队，High 先执行
+    std::mutex mtx;
+    std::string order;
+    auto due = TimerClock::now() + std::chrono::milliseconds(5);
+    for (char c : {'l', 'n', 'h'}) {
+        Priority prio = c == 'h'   ? Priority::High
+                        : c == 'n' ? Priority::Normal
+                                   : Priority::Low;
+        pool.submit_at(prio, due, [&, c] {
+            std::lock_guard<std::mutex> lock(mtx);
+            order.push_back(c);
+        });
+    }
+    while (pool.stats().total.queue_depth < 3) {
+        std::this_thread::yield();
+    }
+    release.store(true);
+    wait_for_executed([&] { return pool.stats(); }, 4);
+    std::lock_guard<std::mutex> lock(mtx);
+    EXPECT_EQ(order, std::string("hnl"));
+}
+
+TEST(ThreadPoolPriority, Ordering) {
+    using namespace parallel;
+    ThreadPoolPriority pool(1);    // Single thread to force ordering
+
+    std::vector<int> execution_order;
+    std::vector<parallel::Future<void>> futures;
+
+    // Fill the pool so next tasks get queued
+    auto blocker = pool.submit(Priority::Normal, [] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    });
+
+    // Submit Low then High
+    futures.push_back(
+        pool.submit(Priority::Low, [&] { execution_order.push_back(1); }));
+    futures.push_back(
+        pool.submit(Priority::High, [&] { execution_order.push_back(2); }));
+    futures.push_back(
+        pool.submit(Priority::Low, [&] { execution_order.push_back(1); }));
+    futures.push_back(
+        pool.submit(Priority::High, [&] { execution_order.push_back(2); }));
+
+    // Wait for blocker
+    blocker.get();
+
+    // Wait for all
+    for (auto& f : futures)
+        f.get();
+
+    // Check if any High (2) came after Low (1)?
+    // Actually, with strict priority, ALL Highs should ideally run before Lows if they were in queue.
+    // Since we submitted L, H, L, H while busy:
+    // Queue should look like: H, H, L, L (approx, depending on implementation details)
+
+    // Just verify that we have some Highs
+    EXPECT_TRUE(execution_order.size() == 4);
+}
+
+TEST(ThreadPoolPriority, WorkerIdentity) {
+    using namespace parallel;
+    ThreadPoolPriority outer(3);
+    ThreadPoolPriority inner(1);
+
+    auto fut = outer.submit(Priority::High, [&] {
+        return inner.submit(Priority::Low, [] { return 7; }).get() +
+               static_cast<int>(outer.current_worker_index().has_value());
+    });
+    EXPECT_EQ(fut.get(), 8);
+}
+
+TEST(ThreadPoolPriority, WakesParkedWorkers) {
+    parallel::ThreadPoolPriority pool(3);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    int sum = 0;
+    for (int i = 0; i < 2000; ++i) {
+        sum += pool.submit([] { return 1; }).get();
+    }
+    EXPECT_EQ(sum, 2000);
+}
+
+TEST(ThreadPoolPriority, StealHalfKeepsPriorityLevel) {
+    using namespace parallel;
+    ThreadPoolPriority pool(3);
+    pool.set_steal_batch(16);
+    std::atomic<int> high{0}, low{0};
+    // 两批任务都从 worker 内部提交，进入同一个 worker 的两个优先级队列
+    auto [a, b] = pool.submit([&] {
+                          auto h = pool.submit_n(Priority::High, 3000, [&](size_t) {
+                              high.fetch_add(1);
+                          });
+                          auto l = pool.submit_n(Priority::Low, 3000, [&](size_t) {
+                              low.fetch_add(1);
+                          });
+                          return std::make_pair(std::move(h), std::move(l));
+                      })
+                      .get();
+    a.get();
+    b.get();
+    EXPECT_EQ(high.load(), 3000);
+    EXPECT_EQ(low.load(), 3000);
+}
+
+TEST(ThreadPoolPriority, ResizeKeepsInFlightTasks) {
+    using namespace parallel;
+    ThreadPoolPriority pool(4, 4);
+    std::atomic<int> counter{0};
+    std::vector<Future<void>> futures;
+    for (size_t round = 0; round < 20; ++round) {
+        Priority prio = static_cast<Priority>(round % 3);
+        futures.push_back(
+            pool.submit_n(prio, 500, [&](size_t) { counter.fetch_add(1); }));
+        pool.resize(round % 4 + 1);
+        EXPECT_EQ(pool.size(), round % 4 + 1);
+    }
+    for (auto& f : futures) {
+        f.get();
+    }
+    EXPECT_EQ(counter.load(), 20 * 500);
+}
+
+TEST(ThreadPoolPriority, StatsSplitByPriority) {
+    using namespace parallel;
+    ThreadPoolPriority pool(2);
+    auto high = pool.submit_n(Priority::High, 10, [](size_t) {});
+    auto low = pool.submit_n(Priority::Low, 20, [](size_t) {});
+    high.get();
+    low.get();
+    auto stats = wait_for_executed([&] { return pool.stats(); }, 30);
+    EXPECT_EQ(stats.total.executed, 30u);
+    EXPECT_EQ(stats.executed_by_priority.size(), 3u);
+    EXPECT_EQ(stats.executed_by_priority[0], 10u);
+    EXPECT_EQ(stats.executed_by_priority[1], 0u);
+    EXPECT_EQ(stats.executed_by_priority[2], 20u);
+}
+
+TEST(ThreadPoolPriority, LatencySplitByPriority) {
+    using namespace parallel;
+    ThreadPoolPriority pool(1);
+    pool.set_latency_tracking(true);
+
+    // 唯一的 worker 被占住 20ms，后面的 Low 任务至少排队这么久
+    auto blocker = pool.submit(Priority::Normal, [] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    });
+    auto low = pool.submit(Priority::Low, [] {});
+    auto high = pool.submit(Priority::High, [] {});
+    blocker.get();
+    low.get();
+    high.get();
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (pool.latency().total.run_time.count() < 3 &&
+           std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::yield();
+    }
+    auto latency = pool.latency();
+    EXPECT_EQ(latency.by_priority.size(), 3u);
+    EXPECT_EQ(latency.total.run_time.count(), 3u);
+    EXPECT_EQ(latency.by_priority[0].run_time.count(), 1u);
+    EXPECT_EQ(latency.by_priority[1].run_time.count(), 1u);
+    EXPECT_EQ(latency.by_priority[2].queue_wait.count(), 1u);
+    EXPECT_TRUE(latency.by_priority[1].run_time.p50() >=
+                std::chrono::milliseconds(15));
+    EXPECT_TRUE(latency.by_priority[2].queue_wait.p50() >=
+                std::chrono::milliseconds(15));
+}
+
+TEST(ThreadPoolPriority, BulkSubmission) {
+    using namespace parallel;
+    ThreadPoolPriority pool(2);
+    std::atomic<int> counter{0};
+
+    auto a = pool.submit_n(Priority::High, 500,
+                           [&](size_t) { counter.fetch_add(1); });
+    std::vector<std::function<void()>> jobs(
+        50, [&] { counter.fetch_add(10); });
+    auto b = pool.submit_bulk(Priority::Low, std::move(jobs));
+    a.get();
+    b.get();
+    EXPECT_EQ(counter.load(), 1000);
+}
+
+TEST(ProducerCursorCache, KeepsCursorPerPool) {
+    parallel::ProducerCursorCache cache;
+    std::atomic<size_t> seed_a{0};
+    std::atomic<size_t> seed_b{10};
+    int a = 0;
+    int b = 0;
+
+    // 交替使用两个池: 各自的游标连续前进，起点只领取一次
+    for (size_t i = 0; i < 4; ++i) {
+        EXPECT_EQ(cache.get(&a, seed_a)++, i);
+        EXPECT_EQ(cache.get(&b, seed_b)++, 10 + i);
+    }
+    EXPECT_EQ(seed_a.load(), 1u);
+    EXPECT_EQ(seed_b.load(), 11u);
+
+    // 超过容量后最久没用的 a 被挤掉，再次使用时重新领取起点；b 刚用过，仍然保留
+    std::vector<int> others(parallel::ProducerCursorCache::kEntries - 1);
+    std::atomic<size_t> seed_other{0};
+    cache.get(&b, seed_b);
+    for (int& other : others) {
+        cache.get(&other, seed_other);
+    }
+    EXPECT_EQ(cache.get(&b, seed_b), 14u);
+    EXPECT_EQ(cache.get(&a, seed_a), 1u);
+    EXPECT_EQ(seed_a.load(), 2u);
+}
+
+TEST(ThreadPoolPriority, InterleavedPoolsKeepRoundRobin) {
+    using namespace parallel;
+    ThreadPoolPriority first(4);
+    ThreadPoolPriority second(4);
+    std::atomic<bool> release{false};
+    std::atomic<int> blocked{0};
+    for (ThreadPoolPriority* pool : {&first, &second}) {
+        pool->set_shared_levels(0);
+        for (int i = 0; i < 4; ++i) {
+            pool->post(Priority::Low, [&] {
+                blocked.fetch_add(1);
+                while (!release.load()) {
+                    std::this_thread::yield();
+                }
+            });
+        }
+    }
+    while (blocked.load() < 8) {
+        std::this_thread::yield();
+    }
+
+    // 所有 worker 都被占住: 交替向两个池提交，每个池的任务仍然依次落在各个 worker 上
+    for (int i = 0; i < 8; ++i) {
+        first.post(Priority::Low, [] {});
+        second.post(Priority::Low, [] {});
+    }
+    for (ThreadPoolPriority* pool : {&first, &second}) {
+        auto stats = pool->stats();
+        for (const auto& worker : stats.workers) {
+            EXPECT_EQ(worker.queue_depth, 2u);
+        }
+    }
+    release.store(true);
+    wait_for_executed([&] { return first.stats(); }, 12);
+    wait_for_executed([&] { return second.stats(); }, 12);
+}
+
+TEST(ThreadPool, AddTaskWithArguments) {
+    ThreadPool pool(2);
+    auto fut = pool.AddTask([](int a, int b) { return a + b; }, 2, 3);
+    EXPECT_EQ(fut.get(), 5);
+}
+
+TEST(ThreadPool, PostWithoutFuture) {
+    ThreadPool pool(2);
+    std::atomic<int> sum{0};
+    std::atomic<int> errors{0};
+    pool.SetExceptionHandler([&](std::exception_ptr) { errors.fetch_add(1); });
+    for (int i = 1; i <= 10; ++i) {
+        pool.Post([&sum](int v) { sum.fetch_add(v); }, i);
+    }
+    pool.Post([] { throw std::logic_error("boom"); });
+
+    auto stats = wait_for_executed([&] { return pool.GetStats(); }, 11);
+    EXPECT_EQ(stats.total.executed, 11u);
+    EXPECT_EQ(sum.load(), 55);
+    EXPECT_EQ(errors.load(), 1);
+}
+
+TEST(ThreadPool, DestructorDrainsThenChains) {
+    // 析构时还在执行的任务: 工作线程把队列取空再退出，then() 的回调同样会执行
+    parallel::Future<int> chained;
+    {
+        ThreadPool pool(1);
+        chained = pool.AddTask([] {
+                          std::this_thread::sleep_for(
+                              std::chrono::milliseconds(20));
+                          return 4;
+                      })
+                      .then([](int v) { return v + 1; })
+                      .then([](int v) { return v * 2; });
+    }
+    EXPECT_EQ(chained.get(), 10);
+}
+
+TEST(ThreadPool, StatsCountTasksAndWaits) {
+    ThreadPool pool(2);
+    for (int i = 0; i < 100; ++i) {
+        pool.AddTask([] {}).get();
+    }
+    auto stats = wait_for_executed([&] { return pool.GetStats(); }, 100);
+    EXPECT_EQ(stats.workers.size(), 2u);
+    EXPECT_EQ(stats.total.executed, 100u);
+    // 逐个提交并等待，线程每次都会在条件变量上等待下一个任务
+    EXPECT_TRUE(stats.total.parks > 0);
+}
+
+TEST(InlineTask, SmallCallablesStayInline) {
+    int value = 0;
+    auto small = [&value] { value += 1; };
+    auto large = [text = std::string(64, 'x'), &value] {
+        value += static_cast<int>(text.size());
+    };
+    EXPECT_TRUE(parallel::InlineTask::stores_inline<decltype(small)>);
+    EXPECT_FALSE(parallel::InlineTask::stores_inline<decltype(large)>);
+
+    size_t before = allocation_count();
+    parallel::InlineTask task(small);
+    parallel::InlineTask moved(std::move(task));
+    moved();
+    EXPECT_EQ(allocation_count(), before);
+    EXPECT_FALSE(static_cast<bool>(task));
+
+    parallel::InlineTask boxed(std::move(large));
+    boxed();
+    EXPECT_EQ(value, 65);
+}
+
+TEST(InlineTask, ReleasesCapturedState) {
+    auto shared = std::make_shared<int>(7);
+    {
+        parallel::InlineTask task([shared] { (void)*shared; });
+        EXPECT_EQ(shared.use_count(), 2);
+        task.reset();
+        EXPECT_EQ(shared.use_count(), 1);
+    }
+    EXPECT_EQ(shared.use_count(), 1);
+}
+
+TEST(Future, PackagedTaskRecyclesState) {
+    // 预热当前线程的共享状态缓存
+    parallel::package_task([] { return 0; });
+
+    size_t before = allocation_count();
+    for (int i = 0; i < 100; ++i) {
+        auto [task, future] = parallel::package_task([i] { return i * 2; });
+        task();
+        EXPECT_EQ(future.get(), i * 2);
+    }
+    EXPECT_EQ(allocation_count(), before);
+}
+
+TEST(Future, BrokenPromiseWhenTaskDropped) {
+    auto [task, future] = parallel::package_task([] { return 1; });
+    task.reset();    // 任务未执行就被丢弃
+
+    bool caught = false;
+    try {
+        future.get();
+    } catch (const std::future_error& e) {
+        caught = e.code() == std::future_errc::broken_promise;
+    }
+    EXPECT_TRUE(caught);
+}
+
+TEST(Future, ThenRunsOnThePool) {
+    ThreadPoolFast pool(2);
+    std::atomic<bool> on_worker{false};
+    auto text = pool.submit([] { return 2; })
+                    .then([&](int v) {
+                        on_worker = pool.current_worker_index().has_value();
+                        return v * 3;
+                    })
+                    .then([](int v) { return std::to_string(v); });
+    EXPECT_EQ(text.get(), std::string("6"));
+    EXPECT_TRUE(on_worker.load());
+
+    // 取值形式: 前一个任务失败时不调用 fn，异常直接传下去
+    std::atomic<bool> called{false};
+    auto skipped = pool.submit([]() -> int { throw std::runtime_error("x"); })
+                       .then([&](int v) {
+                           called = true;
+                           return v;
+                       });
+    bool threw = false;
+    try {
+        skipped.get();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    EXPECT_TRUE(threw);
+    EXPECT_FALSE(called.load());
+
+    // Future 形式: 自己处理异常
+    auto recovered =
+        pool.submit([]() -> int { throw std::runtime_error("x"); })
+            .then([](parallel::Future<int> f) {
+                try {
+                    return f.get();
+                } catch (const std::runtime_error&) {
+                    return -1;
+                }
+            });
+    EXPECT_EQ(recovered.get(), -1);
+
+    // 单线程池上的长链: 每一段都是新任务，没有 worker 阻塞等待上一段
+    ThreadPoolFast single(1);
+    auto chain = single.submit([] { return 0; });
+    for (int i = 0; i < 100; ++i) {
+        chain = std::move(chain).then([](int v) { return v + 1; });
+    }
+    EXPECT_EQ(chain.get(), 100);
+}
+
+TEST(Future, WhenAllAndWhenAny) {
+    ThreadPoolFast pool(2);
+    std::vector<parallel::Future<int>> parts;
+    for (int i = 1; i <= 8; ++i) {
+        parts.push_back(pool.submit([i] { return i; }));
+    }
+    auto sum = parallel::when_all(std::move(parts))
+                   .then([](std::vector<parallel::Future<int>> done) {
+                       int total = 0;
+                       for (auto& f : done) {
+                           total += f.get();
+                       }
+                       return total;
+                   });
+    EXPECT_EQ(sum.get(), 36);
+
+    auto [number, word] = parallel::when_all(pool.submit([] { return 7; }),
+                                             pool.submit([] {
+                                                 return std::string("seven");
+                                             }))
+                              .get();
+    EXPECT_EQ(number.get(), 7);
+    EXPECT_EQ(word.get(), std::string("seven"));
+
+    // 第 0 个任务一直等到 when_any 完成之后才返回
+    std::atomic<bool> release{false};
+    std::vector<parallel::Future<int>> racers;
+    racers.push_back(pool.submit([&] {
+        while (!release.load()) {
+            std::this_thread::yield();
+        }
+        return 0;
+    }));
+    racers.push_back(pool.submit([] { return 1; }));
+    auto first = parallel::when_any(std::move(racers)).get();
+    release = true;
+    EXPECT_EQ(first.index, 1u);
+    EXPECT_EQ(first.future.get(), 1);
+
+    auto none = parallel::when_any(std::vector<parallel::Future<int>>{}).get();
+    EXPECT_EQ(none.index, parallel::WhenAnyResult<int>::npos);
+}
+
+TEST(Future, ThenKeepsPoolAndPriority) {
+    using namespace parallel;
+    ThreadPoolPriority prio(2);
+    auto high = prio.submit(Priority::High, [] { return 1; })
+                    .then([](int v) { return v + 1; });
+    EXPECT_EQ(high.get(), 2);
+    auto stats = wait_for_executed([&] { return prio.stats(); }, 2);
+    EXPECT_EQ(stats.executed_by_priority[0], 2u);
+
+    ThreadPool basic(2);
+    auto chained = basic.AddTask([] { return 20; }).then([](int v) {
+        return v + 1;
+    });
+    EXPECT_EQ(chained.get(), 21);
+}
+
+TEST(TaskGraph, RunsInDependencyOrderAndReruns) {
+    ThreadPoolFast pool(4);
+    parallel::TaskGraph graph(pool);
+
+    // 菱形: a → (b, c) → d，再挂一条 d → e 的链
+    std::atomic<int> step{0};
+    std::vector<int> order(5, -1);
+    auto record = [&](int node) {
+        return [&order, &step, node] { order[node] = step.fetch_add(1); };
+    };
+    auto a = graph.add(record(0));
+    auto b = graph.add(record(1));
+    auto c = graph.add(record(2));
+    auto d = graph.add(record(3));
+    auto e = graph.add(record(4));
+    graph.precede(a, b);
+    graph.precede(a, c);
+    graph.precede(b, d);
+    graph.precede(c, d);
+    graph.precede(d, e);
+
+    graph.run().get();
+    EXPECT_EQ(order[0], 0);
+    EXPECT_TRUE(order[1] < order[3] && order[2] < order[3]);
+    EXPECT_EQ(order[4], 4);
+
+    // 结构不变时重复执行不分配内存 (先跑几遍，让各个队列扩容到位)
+    for (int i = 0; i < 3; ++i) {
+        graph.run_and_wait();
+    }
+    size_t before = allocation_count();
+    for (int i = 0; i < 10; ++i) {
+        step = 0;
+        graph.run_and_wait();
+    }
+    EXPECT_EQ(allocation_count(), before);
+    EXPECT_EQ(order[4], 4);
+}
+
+TEST(TaskGraph, ErrorsAndCycles) {
+    ThreadPoolFast pool(1);
+    parallel::TaskGraph graph(pool);
+    std::atomic<bool> after_ran{false};
+    auto fail = graph.add([] { throw std::runtime_error("node failed"); });
+    auto after = graph.add([&] { after_ran = true; });
+    graph.precede(fail, after);
+
+    bool threw = false;
+    try {
+        graph.run().get();
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    EXPECT_TRUE(threw);
+    EXPECT_FALSE(after_ran.load());
+
+    graph.precede(after, fail);
+    bool cycle = false;
+    try {
+        graph.run();
+    } catch (const std::invalid_argument&) {
+        cycle = true;
+    }
+    EXPECT_TRUE(cycle);
+}
+
+TEST(ChaseLevDeque, OwnerLifoThiefFifo) {
+    parallel::ChaseLevDeque<int> deque(2);    // 小容量，顺便覆盖扩容
+    for (int i = 0; i < 100; ++i)
+        deque.push(i);
+
+    EXPECT_EQ(deque.size(), 100u);
+    EXPECT_EQ(deque.steal().value_or(-1), 0);    // thief 从顶部拿最旧的
+    EXPECT_EQ(deque.pop().value_or(-1), 99);     // owner 从底部拿最新的
+
+    int remaining = 0;
+    while (deque.pop())
+        ++remaining;
+    EXPECT_EQ(remaining, 98);
+    EXPECT_FALSE(deque.steal().has_value());
+}
+
+TEST(ChaseLevDeque, ConcurrentStealTakesEachItemOnce) {
+    const int num_items = 200000;
+    parallel::ChaseLevDeque<int> deque;
+    std::vector<std::atomic<int>> seen(num_items);
+    std::atomic<int> consumed{0};
+
+    std::vector<std::thread> thieves;
+    for (int t = 0; t < 3; ++t) {
+        thieves.emplace_back([&] {
+            while (consumed.load(std::memory_order_acquire) < num_items) {
+                if (auto v = deque.steal()) {
+                    seen[*v].fetch_add(1, std::memory_order_relaxed);
+                    consumed.fetch_add(1, std::memory_order_acq_rel);
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < num_items; ++i) {
+        deque.push(i);
+        if (i % 3 == 0) {
+            if (auto v = deque.pop()) {
+                seen[*v].fetch_add(1, std::memory_order_relaxed);
+                consumed.fetch_add(1, std::memory_order_acq_rel);
+            }
+        }
+    }
+    while (auto v = deque.pop()) {
+        seen[*v].fetch_add(1, std::memory_order_relaxed);
+        consumed.fetch_add(1, std::memory_order_acq_rel);
+    }
+    for (auto& t : thieves)
+        t.join();
+
+    int duplicates_or_lost = 0;
+    for (auto& s : seen) {
+        if (s.load() != 1)
+            ++duplicates_or_lost;
+    }
+    EXPECT_EQ(duplicates_or_lost, 0);
+}
+
+TEST(MpmcQueue, FullEmptyAndWraparound) {
+    parallel::MpmcQueue<int> queue(3);    // 向上取整为 4
+    EXPECT_EQ(queue.capacity(), 4u);
+    EXPECT_FALSE(queue.try_pop().has_value());
+
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 4; ++i) {
+            EXPECT_TRUE(queue.try_push(round * 10 + i));
+        }
+        int overflow = 99;
+        EXPECT_FALSE(queue.try_push(std::move(overflow)));
+        EXPECT_EQ(queue.size(), 4u);
+        for (int i = 0; i < 4; ++i) {
+            EXPECT_EQ(queue.try_pop().value_or(-1), round * 10 + i);
+        }
+        EXPECT_TRUE(queue.empty());
+    }
+}
+
+TEST(MpmcQueue, ConcurrentProducersAndConsumers) {
+    const int per_producer = 50000;
+    const int producers = 3;
+    const int num_items = per_producer * producers;
+    parallel::MpmcQueue<int> queue(64);    // 小容量: 频繁写满和读空
+    std::vector<std::atomic<int>> seen(num_items);
+    std::atomic<int> consumed{0};
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            for (int i = p * per_producer; i < (p + 1) * per_producer; ++i) {
+                int item = i;
+                while (!queue.try_push(std::move(item))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (int c = 0; c < 3; ++c) {
+        threads.emplace_back([&] {
+            while (consumed.load(std::memory_order_acquire) < num_items) {
+                if (auto v = queue.try_pop()) {
+                    seen[*v].fetch_add(1, std::memory_order_relaxed);
+                    consumed.fetch_add(1, std::memory_order_acq_rel);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    int duplicates_or_lost = 0;
+    for (auto& s : seen) {
+        if (s.load() != 1)
+            ++duplicates_or_lost;
+    }
+    EXPECT_EQ(duplicates_or_lost, 0);
 }
 
 // ============================================
@@ -182,6 +3248,29 @@ int main(int argc, char** argv) {
         std::cout << "\n>>> Running Benchmarks...\n";
         size_t threads = std::thread::hardware_concurrency();
         benchmark_fast_pool(threads);
+        benchmark_latency_tracking(threads);
+        benchmark_post_vs_submit(threads);
+        benchmark_external_producers(threads);
+        benchmark_tenant_fairness(threads);
+        benchmark_timer_wheel(threads);
+        benchmark_worker_arena(threads);
+        benchmark_priority_aging(threads);
+        benchmark_deadline_scheduling(threads);
+        benchmark_priority_idle_scan(threads);
+        benchmark_shared_lane(threads);
+        benchmark_reserved_workers(threads);
+        benchmark_pipeline(threads);
+        benchmark_task_graph(threads);
+        benchmark_recursive_spawn(threads);
+        benchmark_pinned_pool(threads);
+        benchmark_bulk_submit(threads);
+        benchmark_steal_half(threads);
+        benchmark_elastic_pool(threads);
+        benchmark_parallel_for(threads);
+        benchmark_parallel_quicksort(threads);
+        benchmark_deque_compare();
+        benchmark_submit_allocations(threads);
+        benchmark_idle_and_latency(threads);
     }
 
     return 0;
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+#include "inline_task.h"
+
+namespace parallel {
+
+namespace detail {
+
+template <typename T, bool = std::is_trivially_copyable_v<T>>
+struct is_lock_free_atomic : std::false_type {};
+
+template <typename T>
+struct is_lock_free_atomic<T, true>
+    : std::bool_constant<std::atomic<T>::is_always_lock_free> {};
+
+// 槽位方案 A: 指针/整数等小类型，直接存成 std::atomic<T>
+template <typename T>
+struct AtomicSlot {
+    using Snapshot = T;
+
+    void store(T&& item) { cell.store(item, std::memory_order_relaxed); }
+
+    void store_raw(const Snapshot& snapshot) {
+        cell.store(snapshot, std::memory_order_relaxed);
+    }
+
+    Snapshot load() const { return cell.load(std::memory_order_relaxed); }
+
+    static T extract(const Snapshot& snapshot) { return snapshot; }
+
+    std::atomic<T> cell;
+};
+
+// 槽位方案 B: InlineTask 这类可平凡重定位的大对象，拆成若干个 64 位原子字逐字读写。
+// thief 在 CAS 之前读到的可能是“撕裂”的字节，但 CAS 失败时这些字节会被直接丢弃；
+// CAS 成功则说明没有人改写过这个槽位，按字节重建出的对象就是完整的。
+template <typename T>
+struct WordSlot {
+    static constexpr size_t kWords = (sizeof(T) + 7) / 8;
+
+    struct Snapshot {
+        alignas(T) std::uint64_t words[kWords];
+    };
+
+    void store(T&& item) {
+        Snapshot snapshot{};
+        std::memcpy(snapshot.words, static_cast<const void*>(&item),
+                    sizeof(T));
+        // 所有权已经按字节转移进槽位: 在原地重建一个空对象，旧对象不再析构
+        ::new (static_cast<void*>(&item)) T();
+        store_raw(snapshot);
+    }
+
+    void store_raw(const Snapshot& snapshot) {
+        for (size_t w = 0; w < kWords; ++w) {
+            words[w].store(snapshot.words[w], std::memory_order_relaxed);
+        }
+    }
+
+    Snapshot load() const {
+        Snapshot snapshot;
+        for (size_t w = 0; w < kWords; ++w) {
+            snapshot.words[w] = words[w].load(std::memory_order_relaxed);
+        }
+        return snapshot;
+    }
+
+    // 只有赢得 CAS 之后才调用: 把快照里的对象“搬”出来交给调用者。
+    // words 是 uint64_t 数组，不能为 T 提供存储: 先把字节复制进 unsigned char 存储，
+    // 在那里按重定位约定得到 T 对象，再移动出来。移走后的空对象不析构
+    // (见 is_trivially_relocatable)
+    static T extract(const Snapshot& snapshot) {
+        alignas(T) unsigned char storage[sizeof(T)];
+        std::memcpy(storage, snapshot.words, sizeof(T));
+        return std::move(*std::launder(reinterpret_cast<T*>(storage)));
+    }
+
+    std::atomic<std::uint64_t> words[kWords];
+};
+
+template <typename T>
+using DequeSlot =
+    std::conditional_t<is_lock_free_atomic<T>::value, AtomicSlot<T>,
+                       WordSlot<T>>;
+
+}    // namespace detail
+
+/**
+ * @brief Chase-Lev 无锁工作窃取双端队列 (Work-Stealing Deque)
+ *
+ * **算法来源**: Chase & Lev (SPAA'05)。内存序采用 Lê 等人 (PPoPP'13)
+ * 针对 C11 弱内存模型证明过的版本。
+ *
+ * **访问规则**:
+ * 1.  **Owner (唯一的所有者线程)**: 只在底部 (bottom) `push` / `pop`，LIFO。
+ *     - 常见路径只有普通的 load/store + fence，**没有任何原子 RMW**。
+ *     - 只有队列剩最后一个元素时，才需要一次 CAS 与窃取者“裁决”归属。
+ * 2.  **Thief (任意其他线程)**: 只在顶部 (top) `steal`，FIFO，用 CAS 推进 top。
+ *     - 多个 thief 之间、thief 与 owner 之间都不需要锁。
+ *
+ * **扩容**: 环形缓冲区写满时由 owner 扩容为两倍。旧缓冲区可能仍被并发的
+ * thief 读取，所以不能立即释放，统一保存在 `rings_` 中，随队列一起析构。
+ *
+ * @tparam T 元素类型。thief 会在 CAS 成功之前“投机地”读出槽位，扩容时旧环里的
+ *           元素也只是按字节复制，因此 T 必须可平凡重定位:
+ *           - 指针、整数等无锁原子类型直接存放；
+ *           - `InlineTask` 这类对象按 64 位字存放 (见 detail::WordSlot)。
+ */
+template <typename T>
+class ChaseLevDeque {
+    static_assert(is_trivially_relocatable_v<T>,
+                  "ChaseLevDeque 要求元素可平凡重定位 (指针或 InlineTask)");
+
+   public:
+    explicit ChaseLevDeque(size_t capacity = 256) {
+        auto ring = std::make_unique<Ring>(
+            static_cast<int64_t>(std::bit_ceil(capacity < 2 ? 2 : capacity)));
+        ring_.store(ring.get(), std::memory_order_relaxed);
+        rings_.push_back(std::move(ring));
+    }
+
+    ChaseLevDeque(const ChaseLevDeque&) = delete;
+    ChaseLevDeque& operator=(const ChaseLevDeque&) = delete;
+
+    ~ChaseLevDeque() {
+        // 析构剩余元素 (此时已经没有并发访问)
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            while (pop()) {
+            }
+        }
+    }
+
+    /**
+     * @brief [Owner] 压入底部
+     */
+    void push(T item) {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_acquire);
+        Ring* ring = ring_.load(std::memory_order_relaxed);
+
+        if (b - t > ring->capacity - 1) {
+            ring = grow(ring, b, t);
+        }
+
+        ring->put(b, std::move(item));
+        // release: 保证 thief (acquire 读 bottom) 看到新的 bottom 时，也一定能看到槽位里的数据。
+        // 论文里写的是 release fence + relaxed store，这里用等价的 release store，
+        // 在 x86 上同样只是一条普通的 mov，而且 ThreadSanitizer 能正确理解。
+        bottom_.store(b + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief [Owner] 从底部弹出 (LIFO)
+     */
+    std::optional<T> pop() {
+        int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        Ring* ring = ring_.load(std::memory_order_relaxed);
+        // 先“预占”底部元素，再读 top。
+        // seq_cst fence 保证: 要么 thief 看到我们缩小后的 bottom，要么我们看到它推进后的 top。
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top_.load(std::memory_order_relaxed);
+
+        std::optional<T> result;
+        if (t <= b) {
+            Snapshot snapshot = ring->get(b);
+            bool won = true;
+            if (t == b) {
+                // 只剩最后一个元素: 与 thief 竞争，用 CAS 裁决
+                won = top_.compare_exchange_strong(t, t + 1,
+                                                   std::memory_order_seq_cst,
+                                                   std::memory_order_relaxed);
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+            if (won) {
+                result.emplace(Slot::extract(snapshot));
+            }
+        } else {
+            // 队列本来就是空的，恢复 bottom
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    /**
+     * @brief [Thief] 从顶部窃取 (FIFO)
+     *
+     * 队列为空或者 CAS 竞争失败都返回 std::nullopt，调用者换个受害者即可。
+     */
+    std::optional<T> steal() {
+        int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom_.load(std::memory_order_acquire);
+
+        if (t < b) {
+            Ring* ring = ring_.load(std::memory_order_acquire);
+            Snapshot snapshot = ring->get(t);    // 投机读取，CAS 成功后才算数
+            if (top_.compare_exchange_strong(t, t + 1,
+                                             std::memory_order_seq_cst,
+                                             std::memory_order_relaxed)) {
+                return Slot::extract(snapshot);
+            }
+        }
+        return std::nullopt;
+    }
+
+    // 近似元素个数 (并发修改时只是一个快照)
+    size_t size() const {
+        int64_t b = bottom_.load(std::memory_order_relaxed);
+        int64_t t = top_.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    size_t capacity() const {
+        return static_cast<size_t>(
+            ring_.load(std::memory_order_relaxed)->capacity);
+    }
+
+   private:
+    using Slot = detail::DequeSlot<T>;
+    using Snapshot = typename Slot::Snapshot;
+
+    // 容量为 2 的幂的环形缓冲区，下标用 & mask 取模
+    struct Ring {
+        explicit Ring(int64_t cap)
+            : capacity(cap),
+              mask(cap - 1),
+              slots(std::make_unique<Slot[]>(static_cast<size_t>(cap))) {}
+
+        void put(int64_t i, T&& item) { slots[i & mask].store(std::move(item)); }
+
+        void put_raw(int64_t i, const Snapshot& snapshot) {
+            slots[i & mask].store_raw(snapshot);
+        }
+
+        Snapshot get(int64_t i) const { return slots[i & mask].load(); }
+
+        int64_t capacity;
+        int64_t mask;
+        std::unique_ptr<Slot[]> slots;
+    };
+
+    // [Owner] 扩容: 把 [top, bottom) 按字节拷贝到两倍大小的新环里。
+    // 旧环中的字节保持不变，正在读旧环的 thief 依然能读到完整的元素。
+    Ring* grow(Ring* old_ring, int64_t b, int64_t t) {
+        auto ring = std::make_unique<Ring>(old_ring->capacity * 2);
+        for (int64_t i = t; i < b; ++i) {
+            ring->put_raw(i, old_ring->get(i));
+        }
+        Ring* raw = ring.get();
+        rings_.push_back(std::move(ring));
+        ring_.store(raw, std::memory_order_release);
+        return raw;
+    }
+
+    // top 与 bottom 分别被 thief 和 owner 高频写入，放在不同的 Cache Line
+    alignas(64) std::atomic<int64_t> top_{0};
+    alignas(64) std::atomic<int64_t> bottom_{0};
+    alignas(64) std::atomic<Ring*> ring_{nullptr};
+
+    // 所有分配过的环 (最后一个是当前环)，只由 owner 修改
+    std::vector<std::unique_ptr<Ring>> rings_;
+};
+
+}    // namespace parallel
@@ -49,7 +49,7 @@ struct ScheduleOn {
     bool await_ready() { return false; }
 
     void await_suspend(std::coroutine_handle<> h) {
-        pool->submit([h]() mutable { h.resume(); });
+        pool->post([h]() mutable { h.resume(); });
     }
 
     void await_resume() {}
@@ -0,0 +1,195 @@
+#include "cpu_topology.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace parallel {
+
+namespace {
+
+std::string read_line(const std::filesystem::path& path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+// 解析 sysfs 的 CPU 列表格式，例如 "0-3,8,10-11"
+std::vector<int> parse_cpu_list(const std::string& text) {
+    std::vector<int> result;
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        size_t dash = item.find('-');
+        try {
+            int lo = std::stoi(item.substr(0, dash));
+            int hi = dash == std::string::npos ? lo
+                                               : std::stoi(item.substr(dash + 1));
+            for (int cpu = lo; cpu <= hi; ++cpu) {
+                result.push_back(cpu);
+            }
+        } catch (const std::exception&) {
+            // 格式不对就忽略这一项
+        }
+    }
+    return result;
+}
+
+// 列表中编号最小的 CPU，作为该组的 id；读不到时返回 fallback
+int first_cpu(const std::filesystem::path& list_file, int fallback) {
+    std::vector<int> cpus = parse_cpu_list(read_line(list_file));
+    if (cpus.empty()) {
+        return fallback;
+    }
+    return *std::min_element(cpus.begin(), cpus.end());
+}
+
+CpuInfo read_cpu(const std::filesystem::path& root, int cpu) {
+    namespace fs = std::filesystem;
+    fs::path dir = root / ("cpu" + std::to_string(cpu));
+    std::error_code ec;
+
+    CpuInfo info;
+    info.cpu = cpu;
+    info.core = first_cpu(dir / "topology" / "thread_siblings_list", cpu);
+    info.l3 = 0;
+    info.node = 0;
+
+    for (const auto& entry : fs::directory_iterator(dir / "cache", ec)) {
+        if (read_line(entry.path() / "level") == "3") {
+            info.l3 = first_cpu(entry.path() / "shared_cpu_list", 0);
+            break;
+        }
+    }
+
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.size() > 4 && name.compare(0, 4, "node") == 0) {
+            try {
+                info.node = std::stoi(name.substr(4));
+            } catch (const std::exception&) {
+            }
+            break;
+        }
+    }
+    return info;
+}
+
+}    // namespace
+
+const CpuTopology& CpuTopology::system() {
+    static const CpuTopology topology =
+        detect("/sys/devices/system/cpu").restricted_to(allowed_cpus());
+    return topology;
+}
+
+CpuTopology CpuTopology::detect(const std::string& sysfs_cpu_root) {
+    std::filesystem::path root(sysfs_cpu_root);
+    CpuTopology topology;
+    for (int cpu : parse_cpu_list(read_line(root / "online"))) {
+        topology.cpus_.push_back(read_cpu(root, cpu));
+    }
+    return topology;
+}
+
+CpuTopology CpuTopology::restricted_to(const std::vector<int>& allowed) const {
+    CpuTopology restricted;
+    for (const CpuInfo& info : cpus_) {
+        if (std::find(allowed.begin(), allowed.end(), info.cpu) !=
+            allowed.end()) {
+            restricted.cpus_.push_back(info);
+        }
+    }
+    return restricted.cpus_.empty() ? *this : restricted;
+}
+
+std::vector<CpuInfo> CpuTopology::compact_order() const {
+    std::vector<CpuInfo> order = cpus_;
+    // 同一核心的 SMT 兄弟排在一起，其次是同一 L3、同一节点
+    std::sort(order.begin(), order.end(),
+              [](const CpuInfo& a, const CpuInfo& b) {
+                  return std::tie(a.node, a.l3, a.core, a.cpu) <
+                         std::tie(b.node, b.l3, b.core, b.cpu);
+              });
+    return order;
+}
+
+int CpuTopology::distance(const CpuInfo& a, const CpuInfo& b) {
+    if (a.core == b.core)
+        return 0;
+    if (a.node == b.node && a.l3 == b.l3)
+        return 1;
+    if (a.node == b.node)
+        return 2;
+    return 3;
+}
+
+std::vector<std::vector<size_t>> build_steal_order(
+    const std::vector<CpuInfo>& worker_cpus) {
+    size_t n = worker_cpus.size();
+    std::vector<std::vector<size_t>> order(n + 1);
+
+    for (size_t self = 0; self < n; ++self) {
+        auto& victims = order[self];
+        for (size_t step = 1; step < n; ++step) {
+            victims.push_back((self + step) % n);    // 先按环形顺序排好
+        }
+        // 稳定排序: 距离相同的受害者保持环形顺序
+        std::stable_sort(victims.begin(), victims.end(),
+                         [&](size_t a, size_t b) {
+                             return CpuTopology::distance(worker_cpus[self],
+                                                          worker_cpus[a]) <
+                                    CpuTopology::distance(worker_cpus[self],
+                                                          worker_cpus[b]);
+                         });
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+        order[n].push_back(i);
+    }
+    return order;
+}
+
+bool pin_current_thread(int cpu) {
+#ifdef __linux__
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+std::vector<int> allowed_cpus() {
+    std::vector<int> cpus;
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    return cpus;
+}
+
+}    // namespace parallel
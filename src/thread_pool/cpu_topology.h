@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace parallel {
+
+/**
+ * @brief 一个逻辑 CPU 在缓存/内存层次中的位置
+ *
+ * 各个 id 只用于判断“是否相同”，取值为该组中编号最小的逻辑 CPU (或 NUMA 节点号)。
+ */
+struct CpuInfo {
+    int cpu = -1;     // 逻辑 CPU 编号，-1 表示未知 (未绑核)
+    int core = -1;    // 物理核心: SMT 兄弟线程相同
+    int l3 = -1;      // 共享的末级缓存 (L3 / cluster)
+    int node = -1;    // NUMA 节点
+};
+
+/**
+ * @brief 从 `/sys/devices/system/cpu` 读取的 CPU 拓扑
+ *
+ * 读取的内容:
+ * - `online`: 在线的逻辑 CPU 列表
+ * - `cpuN/topology/thread_siblings_list`: SMT 兄弟线程 (同一物理核心)
+ * - `cpuN/cache/indexK/{level,shared_cpu_list}`: 共享 L3 的 CPU
+ * - `cpuN/nodeM`: 所属 NUMA 节点
+ *
+ * 任何一项读不到 (非 Linux、容器里没有挂载 sysfs 等) 都退化为“各自独立的核心、
+ * 同一个 L3、同一个节点”，调用方无需特殊处理。
+ *
+ * `online` 不考虑进程的亲和性掩码 (taskset / cgroup cpuset)，`system()` 会再与
+ * `allowed_cpus()` 取交集，线程池不会把 worker 绑到不允许运行的 CPU 上。
+ */
+class CpuTopology {
+   public:
+    // 进程内只探测一次，只包含第一次调用时允许运行的 CPU
+    static const CpuTopology& system();
+
+    // 从指定的 sysfs 目录探测 (测试时可以传入伪造的目录树)
+    static CpuTopology detect(const std::string& sysfs_cpu_root);
+
+    const std::vector<CpuInfo>& cpus() const { return cpus_; }
+
+    // 只保留 allowed 中的 CPU。allowed 为空 (读不到亲和性) 或交集为空时原样返回
+    CpuTopology restricted_to(const std::vector<int>& allowed) const;
+
+    /**
+     * @brief 按“紧凑”顺序排列的 CPU: 同一节点 → 同一 L3 → 同一核心的 CPU 相邻
+     *
+     * 线程池按这个顺序给 worker 分配 CPU，相邻编号的 worker 共享尽可能多的缓存。
+     */
+    std::vector<CpuInfo> compact_order() const;
+
+    /**
+     * @brief 两个 CPU 之间的“距离”
+     * @return 0: 同一物理核心 (SMT 兄弟)；1: 共享 L3；2: 同一 NUMA 节点；3: 跨节点
+     */
+    static int distance(const CpuInfo& a, const CpuInfo& b);
+
+   private:
+    std::vector<CpuInfo> cpus_;
+};
+
+/**
+ * @brief 为每个 worker 生成分层的窃取顺序
+ *
+ * 受害者按与自己的距离排序 (SMT 兄弟 → 同 L3 → 同节点 → 远端)，距离相同的按环形顺序
+ * (index+1, index+2, ...) 排列，避免所有 thief 都先去偷同一个队列。
+ * 未绑核时所有距离相同，结果退化为普通的环形顺序。
+ *
+ * @param worker_cpus 每个 worker 所在的 CPU
+ * @return 大小为 worker 数 + 1: 第 i 项是 worker i 的受害者列表 (不含自己)，
+ *         最后一项是外部线程使用的顺序 (所有队列)
+ */
+std::vector<std::vector<size_t>> build_steal_order(
+    const std::vector<CpuInfo>& worker_cpus);
+
+// 把当前线程绑定到指定的逻辑 CPU。不支持的平台或失败时返回 false
+bool pin_current_thread(int cpu);
+
+// 当前线程允许运行的逻辑 CPU (已经包含 cgroup cpuset 的限制)，读不到时返回空
+std::vector<int> allowed_cpus();
+
+}    // namespace parallel
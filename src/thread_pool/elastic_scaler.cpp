@@ -0,0 +1,73 @@
+#include "elastic_scaler.h"
+
+#include <algorithm>
+
+namespace parallel {
+
+AutoScaler::AutoScaler(ElasticPolicy policy,
+                       std::function<LoadSample()> sample,
+                       std::function<void(size_t)> resize)
+    : policy_(policy), sample_(std::move(sample)), resize_(std::move(resize)) {
+    thread_ = std::thread([this] { run(); });
+}
+
+AutoScaler::~AutoScaler() {
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+void AutoScaler::run() {
+    using Clock = std::chrono::steady_clock;
+
+    const auto min_interval =
+        std::max(policy_.sample_interval, std::chrono::milliseconds(1));
+    const auto max_interval = std::max(min_interval, policy_.linger);
+    auto interval = min_interval;
+
+    // 两种状态各自开始的时刻，状态中断时清零
+    Clock::time_point saturated_since{};
+    Clock::time_point idle_since{};
+
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (!cv_.wait_for(lock, interval, [this] { return stop_; })) {
+        LoadSample load = sample_();
+        auto now = Clock::now();
+
+        bool saturated = load.idle == 0 && load.backlog > 0;
+        bool idle = load.idle > 0;
+
+        saturated_since = saturated ? (saturated_since == Clock::time_point{}
+                                           ? now
+                                           : saturated_since)
+                                    : Clock::time_point{};
+        idle_since = idle ? (idle_since == Clock::time_point{} ? now
+                                                               : idle_since)
+                          : Clock::time_point{};
+
+        size_t target = load.workers;
+        if (saturated && now - saturated_since >= policy_.grow_after &&
+            load.workers < policy_.max_threads) {
+            target = load.workers + 1;
+            saturated_since = now;    // 每次只加一个，再观察一个周期
+        } else if (idle && now - idle_since >= policy_.linger &&
+                   load.workers > policy_.min_threads) {
+            target = load.workers - 1;
+            idle_since = now;
+        }
+
+        if (target != load.workers) {
+            resize_(target);
+        }
+
+        // 已经缩到最小且完全空闲: 逐步放慢采样；一旦有负载立即恢复
+        bool quiet = idle && load.backlog == 0 &&
+                     load.workers <= policy_.min_threads;
+        interval = quiet ? std::min(interval * 2, max_interval) : min_interval;
+    }
+}
+
+}    // namespace parallel
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace parallel {
+
+/**
+ * @brief 自动伸缩策略
+ */
+struct ElasticPolicy {
+    size_t min_threads = 1;
+    size_t max_threads = 0;    // 0 表示线程池容量上限
+
+    // 所有 worker 都在忙、且一直有任务在排队，持续这么久就增加一个 worker
+    std::chrono::milliseconds grow_after{10};
+
+    // 一直有 worker 空闲，持续这么久就退役一个 worker
+    std::chrono::milliseconds linger{1000};
+
+    // 采样间隔。线程池缩到 min_threads 且完全空闲时，间隔逐步放大到 linger，
+    // 避免监控线程本身在夜间空转
+    std::chrono::milliseconds sample_interval{5};
+};
+
+/**
+ * @brief 线程池负载的一次采样
+ */
+struct LoadSample {
+    size_t workers = 0;    // 当前活跃的 worker 数
+    size_t idle = 0;       // 正在休眠的 worker 数
+    size_t backlog = 0;    // 排队中的任务数 (近似值)
+};
+
+/**
+ * @brief 自动伸缩的监控线程 (ThreadPoolFast / ThreadPoolPriority 共用)
+ *
+ * **判断依据**:
+ * 1.  **扩容**: 没有空闲 worker 且有任务在排队，说明新任务的排队时间在上升。
+ *     这种状态持续 `grow_after` 就加一个 worker (不超过 max_threads)。
+ * 2.  **缩容**: 有 worker 在休眠，说明算力过剩。持续 `linger` 就退役一个 worker
+ *     (不少于 min_threads)。
+ *
+ * 监控线程只负责决策，真正的扩容/缩容由线程池的 `resize` 完成。
+ * 采样和调整都在监控线程上进行，不影响 submit 的快路径。
+ */
+class AutoScaler {
+   public:
+    AutoScaler(ElasticPolicy policy, std::function<LoadSample()> sample,
+               std::function<void(size_t)> resize);
+    ~AutoScaler();
+
+    AutoScaler(const AutoScaler&) = delete;
+    AutoScaler& operator=(const AutoScaler&) = delete;
+
+   private:
+    void run();
+
+    ElasticPolicy policy_;
+    std::function<LoadSample()> sample_;
+    std::function<void(size_t)> resize_;
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::thread thread_;
+};
+
+}    // namespace parallel
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <thread>
+
+#include "worker_parker.h"
+
+namespace parallel {
+
+/**
+ * @brief worker 找不到任务时的等待方式
+ *
+ * 唤醒延迟与空闲 CPU 是一对此消彼长的量:
+ * - `Park`: 立即 futex 休眠。空闲时不占 CPU，但每次唤醒都要经过内核调度 (几到几十微秒)。
+ * - `SpinThenPark`: 先自旋 `spin_rounds` 轮，仍然没有任务再休眠。短暂的空档不进内核。
+ * - `SpinThenYield`: 先自旋，之后一直 `yield` 而不休眠。让出时间片给同核的其他线程，
+ *   但 worker 始终处于可运行状态。
+ * - `Spin`: 一直自旋。唤醒延迟最低 (提交者也不需要 notify)，但每个空闲 worker 占满一个核心，
+ *   只适合独占核心的低延迟通道。
+ */
+enum class IdleStrategy : uint8_t {
+    Park,
+    SpinThenPark,
+    SpinThenYield,
+    Spin,
+};
+
+struct IdlePolicy {
+    IdleStrategy strategy = IdleStrategy::Park;
+
+    // 自旋预算: 每轮先 pause kPausesPerRound 次，再把本地队列和所有受害者扫描一遍
+    uint32_t spin_rounds = 128;
+
+    static constexpr uint32_t kPausesPerRound = 32;
+};
+
+// 自旋等待提示 (x86 的 pause / ARM 的 yield): 降低功耗，让出流水线给 SMT 兄弟线程
+inline void cpu_relax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+/**
+ * @brief 单个 worker 的空闲退避状态 (worker 线程的局部变量)
+ *
+ * 每次扫描没有找到任务时调用 `next()`，它要么原地等一会儿并返回 Retry (调用者重新扫描)，
+ * 要么返回 Park (调用者走两阶段休眠)。找到任务后调用 `reset()`。
+ * 自旋期间在 WorkerParker 上登记为自旋者，“有没有空闲 worker”的判断不会漏掉它们。
+ */
+class IdleBackoff {
+   public:
+    enum class Action { Retry, Park };
+
+    explicit IdleBackoff(WorkerParker& parker) : parker_(parker) {}
+
+    ~IdleBackoff() { stop_spinning(); }
+
+    IdleBackoff(const IdleBackoff&) = delete;
+    IdleBackoff& operator=(const IdleBackoff&) = delete;
+
+    Action next(const IdlePolicy& policy) noexcept {
+        if (policy.strategy == IdleStrategy::Park) {
+            reset();
+            return Action::Park;
+        }
+        if (!spinning_) {
+            parker_.begin_spinning();
+            spinning_ = true;
+        }
+        if (policy.strategy == IdleStrategy::Spin ||
+            rounds_ < policy.spin_rounds) {
+            ++rounds_;
+            for (uint32_t i = 0; i < IdlePolicy::kPausesPerRound; ++i) {
+                cpu_relax();
+            }
+            return Action::Retry;
+        }
+        if (policy.strategy == IdleStrategy::SpinThenYield) {
+            std::this_thread::yield();
+            return Action::Retry;
+        }
+        // 自旋预算用完: 休眠，醒来后重新开始计算预算
+        reset();
+        return Action::Park;
+    }
+
+    void reset() noexcept {
+        rounds_ = 0;
+        stop_spinning();
+    }
+
+   private:
+    void stop_spinning() noexcept {
+        if (spinning_) {
+            parker_.end_spinning();
+            spinning_ = false;
+        }
+    }
+
+    WorkerParker& parker_;
+    uint32_t rounds_ = 0;
+    bool spinning_ = false;
+};
+
+}    // namespace parallel
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace parallel {
+
+/**
+ * @brief “可平凡重定位” (Trivially Relocatable) 标记
+ *
+ * 如果把一个对象的字节原样 memcpy 到新地址、并且不再对旧地址调用析构，
+ * 得到的新对象依然有效，就称它是可平凡重定位的。
+ * - 所有可平凡拷贝 (trivially copyable) 的类型天然满足。
+ * - 持有堆指针的“独占所有权”类型 (例如 InlineTask) 也满足，但需要显式特化声明。
+ *
+ * 无锁队列 (ChaseLevDeque) 依赖这个性质按字节搬运任务，约定如下:
+ * - 字节复制到对齐合适的新存储 (例如 `alignas(T) unsigned char[sizeof(T)]`) 之后，
+ *   新存储里就是一个 T 对象，通过 `std::launder` 访问；
+ * - 旧地址上的对象随之结束生命周期: 不再析构，也不再访问。要复用那块内存，先在原地构造新对象；
+ * - 从临时存储里移动出去之后，留下的空对象同样不析构。所以特化这个 trait 的类型，
+ *   移动后的状态不能持有任何资源 (InlineTask 移动后就是空任务)。
+ */
+template <typename T>
+struct is_trivially_relocatable : std::is_trivially_copyable<T> {};
+
+template <typename T>
+inline constexpr bool is_trivially_relocatable_v =
+    is_trivially_relocatable<T>::value;
+
+/**
+ * @brief 只可移动、带内联缓冲区的类型擦除任务 (替代 std::function<void()>)
+ *
+ * **为什么不用 std::function**:
+ * 1.  `std::function` 要求可拷贝，`packaged_task` 只能移动，只好再套一层 `shared_ptr`。
+ * 2.  libstdc++ 的 `std::function` 内联缓冲只有 16 字节，稍大的 lambda 就会上堆。
+ *
+ * **InlineTask 的做法**:
+ * 1.  **Small Buffer (48 字节)**: 可平凡重定位、且放得下的可调用对象直接构造在对象内部，
+ *     整个 InlineTask 恰好 64 字节 (一条 Cache Line)，提交时零堆分配。
+ * 2.  **Move-Only**: 不要求可拷贝，移动构造就是按字节拷贝 + 清空源对象。
+ * 3.  **放不下的对象**: 退化为在堆上分配，缓冲区里只存一个指针，语义不变。
+ */
+class InlineTask {
+   public:
+    static constexpr size_t kInlineSize = 48;
+    static constexpr size_t kInlineAlign = 16;
+
+    // 判断某个可调用对象能否直接存进内联缓冲区
+    template <typename F>
+    static constexpr bool stores_inline =
+        sizeof(F) <= kInlineSize && alignof(F) <= kInlineAlign &&
+        is_trivially_relocatable_v<F>;
+
+    InlineTask() noexcept = default;
+
+    template <typename F>
+        requires(!std::same_as<std::decay_t<F>, InlineTask> &&
+                 std::invocable<std::decay_t<F>&>)
+    InlineTask(F&& f) {    // 允许从 lambda 隐式转换，和 std::function 一致
+        using Fn = std::decay_t<F>;
+        if constexpr (stores_inline<Fn>) {
+            ::new (static_cast<void*>(storage_)) Fn(std::forward<F>(f));
+            invoke_ = [](void* storage) {
+                std::invoke(*static_cast<Fn*>(storage));
+            };
+            if constexpr (!std::is_trivially_destructible_v<Fn>) {
+                destroy_ = [](void* storage) noexcept {
+                    static_cast<Fn*>(storage)->~Fn();
+                };
+            }
+        } else {
+            // 放不下: 堆上构造，缓冲区只存指针
+            Fn* boxed = new Fn(std::forward<F>(f));
+            std::memcpy(storage_, &boxed, sizeof(boxed));
+            invoke_ = [](void* storage) { std::invoke(*unbox<Fn>(storage)); };
+            destroy_ = [](void* storage) noexcept { delete unbox<Fn>(storage); };
+        }
+    }
+
+    InlineTask(InlineTask&& other) noexcept { relocate_from(other); }
+
+    InlineTask& operator=(InlineTask&& other) noexcept {
+        if (this != &other) {
+            reset();
+            relocate_from(other);
+        }
+        return *this;
+    }
+
+    InlineTask(const InlineTask&) = delete;
+    InlineTask& operator=(const InlineTask&) = delete;
+
+    ~InlineTask() { reset(); }
+
+    explicit operator bool() const noexcept { return invoke_ != nullptr; }
+
+    void operator()() { invoke_(storage_); }
+
+    // 销毁持有的可调用对象，回到空状态
+    void reset() noexcept {
+        if (destroy_ != nullptr) {
+            destroy_(storage_);
+        }
+        invoke_ = nullptr;
+        destroy_ = nullptr;
+    }
+
+   private:
+    using InvokeFn = void (*)(void*);
+    using DestroyFn = void (*)(void*) noexcept;
+
+    template <typename Fn>
+    static Fn* unbox(void* storage) noexcept {
+        Fn* boxed;
+        std::memcpy(&boxed, storage, sizeof(boxed));
+        return boxed;
+    }
+
+    // 缓冲区里的对象都是可平凡重定位的 (或者只是一个堆指针)，按字节搬走即可
+    void relocate_from(InlineTask& other) noexcept {
+        std::memcpy(storage_, other.storage_, kInlineSize);
+        invoke_ = other.invoke_;
+        destroy_ = other.destroy_;
+        other.invoke_ = nullptr;
+        other.destroy_ = nullptr;
+    }
+
+    alignas(kInlineAlign) std::byte storage_[kInlineSize];
+    InvokeFn invoke_ = nullptr;
+    DestroyFn destroy_ = nullptr;
+};
+
+static_assert(sizeof(InlineTask) == 64, "InlineTask 应该正好占一条 Cache Line");
+
+template <>
+struct is_trivially_relocatable<InlineTask> : std::true_type {};
+
+}    // namespace parallel
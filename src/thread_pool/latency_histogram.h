@@ -0,0 +1,252 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "inline_task.h"
+#include "pool_stats.h"
+#include "task_future.h"
+
+namespace parallel {
+
+// 延迟统计使用的时钟 (steady_clock，单位纳秒)
+inline uint64_t latency_now() noexcept {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+}
+
+/**
+ * @brief 对数-线性 (HDR 风格) 直方图的桶布局
+ *
+ * 每个 2 的幂区间 [2^k, 2^(k+1)) 再均分成 32 个线性子桶，相对误差不超过 1/32 (约 3%)。
+ * 小于 32ns 的值每 1ns 一个桶；超过 2^44 ns (约 4.9 小时) 的值都计入最后一个桶。
+ * 桶的数量是固定的，两个直方图按下标相加就能合并。
+ */
+struct HistogramLayout {
+    static constexpr unsigned kSubBucketBits = 5;
+    static constexpr uint64_t kSubBuckets = uint64_t{1} << kSubBucketBits;
+    static constexpr unsigned kMaxBits = 44;
+    static constexpr size_t kBuckets =
+        (kMaxBits - kSubBucketBits + 1) * kSubBuckets;
+
+    static constexpr size_t index(uint64_t value) noexcept {
+        if (value < kSubBuckets) {
+            return static_cast<size_t>(value);
+        }
+        unsigned msb = static_cast<unsigned>(std::bit_width(value)) - 1;
+        if (msb >= kMaxBits) {
+            return kBuckets - 1;
+        }
+        unsigned shift = msb - kSubBucketBits + 1;
+        return static_cast<size_t>(shift * kSubBuckets +
+                                   (value >> (shift - 1)) - kSubBuckets);
+    }
+
+    // 桶内的最大值 (报告分位数时使用，偏保守)
+    static constexpr uint64_t upper_bound(size_t index) noexcept {
+        if (index < kSubBuckets) {
+            return index;
+        }
+        uint64_t shift = index / kSubBuckets;
+        uint64_t sub = index % kSubBuckets + kSubBuckets;
+        return ((sub + 1) << (shift - 1)) - 1;
+    }
+};
+
+static_assert(HistogramLayout::index(31) == 31);
+static_assert(HistogramLayout::index(32) == 32);
+static_assert(HistogramLayout::index(64) == 64);
+static_assert(HistogramLayout::upper_bound(HistogramLayout::index(1000)) >=
+              1000);
+
+/**
+ * @brief 直方图快照: 普通的计数数组，可以合并、求分位数
+ */
+class HistogramSnapshot {
+   public:
+    HistogramSnapshot() : buckets_(HistogramLayout::kBuckets, 0) {}
+
+    void merge(const HistogramSnapshot& other) {
+        for (size_t i = 0; i < buckets_.size(); ++i) {
+            buckets_[i] += other.buckets_[i];
+        }
+        count_ += other.count_;
+    }
+
+    uint64_t count() const { return count_; }
+
+    /**
+     * @brief 分位数 (q 取 0..1)，返回所在桶的上界；没有样本时返回 0
+     */
+    std::chrono::nanoseconds percentile(double q) const {
+        if (count_ == 0) {
+            return std::chrono::nanoseconds(0);
+        }
+        q = q < 0 ? 0 : (q > 1 ? 1 : q);
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count_));
+        rank = rank == 0 ? 1 : rank;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets_.size(); ++i) {
+            seen += buckets_[i];
+            if (seen >= rank) {
+                return std::chrono::nanoseconds(HistogramLayout::upper_bound(i));
+            }
+        }
+        return std::chrono::nanoseconds(
+            HistogramLayout::upper_bound(buckets_.size() - 1));
+    }
+
+    std::chrono::nanoseconds p50() const { return percentile(0.50); }
+    std::chrono::nanoseconds p99() const { return percentile(0.99); }
+    std::chrono::nanoseconds p999() const { return percentile(0.999); }
+
+   private:
+    friend class LatencyHistogram;
+
+    std::vector<uint64_t> buckets_;
+    uint64_t count_ = 0;
+};
+
+/**
+ * @brief 单写者直方图: 只有所属的 worker 记录，任意线程可以取快照
+ *
+ * 记录一次只是对一个桶做 relaxed 的 load + store，没有锁，也没有 RMW。
+ */
+class LatencyHistogram {
+   public:
+    void record(uint64_t value) noexcept {
+        buckets_[HistogramLayout::index(value)].add();
+    }
+
+    HistogramSnapshot snapshot() const {
+        HistogramSnapshot s;
+        for (size_t i = 0; i < buckets_.size(); ++i) {
+            s.buckets_[i] = buckets_[i].load();
+            s.count_ += s.buckets_[i];
+        }
+        return s;
+    }
+
+   private:
+    std::array<StatCounter, HistogramLayout::kBuckets> buckets_;
+};
+
+/**
+ * @brief 一个 worker (或一个 worker 的一个优先级) 的两种延迟: 排队时间与执行时间
+ */
+struct alignas(64) LatencyRecorder {
+    LatencyHistogram queue_wait;    // 提交 → 开始执行
+    LatencyHistogram run_time;      // 开始执行 → 执行结束
+};
+
+// 合并后的延迟分布
+struct LatencyStats {
+    HistogramSnapshot queue_wait;
+    HistogramSnapshot run_time;
+
+    void merge(const LatencyRecorder& recorder) {
+        queue_wait.merge(recorder.queue_wait.snapshot());
+        run_time.merge(recorder.run_time.snapshot());
+    }
+
+    void merge(const LatencyStats& other) {
+        queue_wait.merge(other.queue_wait);
+        run_time.merge(other.run_time);
+    }
+};
+
+// 整个线程池的延迟快照
+struct PoolLatency {
+    LatencyStats total;
+    std::vector<LatencyStats> by_priority;    // 下标为优先级 (只有 ThreadPoolPriority 填写)
+};
+
+namespace detail {
+
+// 当前线程正在执行的任务应记录到哪里。由 worker 在执行任务前设置，其他线程为 nullptr
+inline thread_local LatencyRecorder* tls_latency_sink = nullptr;
+
+// 开启延迟统计时，提交的任务外面包这一层: 记下提交时刻，执行时计算排队与执行时间
+template <typename Fn>
+struct TimedCall {
+    Fn fn;
+    uint64_t submitted;
+
+    void operator()() {
+        LatencyRecorder* sink = tls_latency_sink;
+        if (sink == nullptr) {    // 外部线程帮忙执行的任务不计入
+            fn();
+            return;
+        }
+        uint64_t start = latency_now();
+        fn();
+        uint64_t finish = latency_now();
+        sink->queue_wait.record(start > submitted ? start - submitted : 0);
+        sink->run_time.record(finish - start);
+    }
+};
+
+// 临时切换 tls_latency_sink，离开作用域时恢复 (用于嵌套执行其他任务的场景)
+class ScopedLatencySink {
+   public:
+    explicit ScopedLatencySink(LatencyRecorder* sink) noexcept
+        : saved_(std::exchange(tls_latency_sink, sink)) {}
+    ~ScopedLatencySink() { tls_latency_sink = saved_; }
+
+    ScopedLatencySink(const ScopedLatencySink&) = delete;
+    ScopedLatencySink& operator=(const ScopedLatencySink&) = delete;
+
+   private:
+    LatencyRecorder* saved_;
+};
+
+// package_task_with 的 wrap 参数: 把 PackagedCall 包进 TimedCall
+struct StampSubmit {
+    uint64_t submitted;
+
+    template <typename Fn>
+    TimedCall<std::decay_t<Fn>> operator()(Fn&& fn) const {
+        return {std::forward<Fn>(fn), submitted};
+    }
+};
+
+/**
+ * @brief 生成入队的任务: submitted 为 0 表示未开启延迟统计，不包装
+ */
+template <typename Fn>
+InlineTask make_timed_task(Fn&& fn, uint64_t submitted) {
+    if (submitted == 0) {
+        return InlineTask(std::forward<Fn>(fn));
+    }
+    return InlineTask(StampSubmit{submitted}(std::forward<Fn>(fn)));
+}
+
+}    // namespace detail
+
+template <typename Fn>
+struct is_trivially_relocatable<detail::TimedCall<Fn>>
+    : std::bool_constant<is_trivially_relocatable_v<Fn>> {};
+
+/**
+ * @brief submit 用的 package_task: submitted 非 0 时任务带上提交时刻 (见 TimedCall)
+ */
+template <typename F, typename... Args>
+    requires std::invocable<F, Args...>
+auto package_timed_task(uint64_t submitted, F&& f, Args&&... args)
+    -> std::pair<InlineTask, Future<std::invoke_result_t<F, Args...>>> {
+    if (submitted == 0) {
+        return package_task(std::forward<F>(f), std::forward<Args>(args)...);
+    }
+    return package_task_with(detail::StampSubmit{submitted},
+                             std::forward<F>(f), std::forward<Args>(args)...);
+}
+
+}    // namespace parallel
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace parallel {
+
+/**
+ * @brief 有界无锁多生产者多消费者队列 (Dmitry Vyukov 的环形缓冲区算法)
+ *
+ * **结构**: 容量为 2 的幂的环形数组，每个槽位带一个序号 `sequence`:
+ * - 序号 == 入队位置: 槽位空闲，生产者 CAS 推进 `enqueue_pos_` 占住它，写入后把序号改为 pos + 1；
+ * - 序号 == 出队位置 + 1: 槽位有数据，消费者 CAS 推进 `dequeue_pos_` 占住它，
+ *   取走后把序号改为 pos + capacity (留给下一圈的生产者)。
+ *
+ * 生产者之间只争抢 `enqueue_pos_`，消费者之间只争抢 `dequeue_pos_`，两者在不同的缓存行上；
+ * 每次操作一次 CAS，没有锁，也没有堆分配 (缓冲区在构造时一次性分配)。
+ * 写满时 `try_push` 立即返回 false，由调用者决定退避还是改走其他路径 (背压)。
+ *
+ * T 需要可默认构造、可移动赋值。
+ */
+template <typename T>
+class MpmcQueue {
+   public:
+    // capacity 向上取整到 2 的幂 (至少为 2)
+    explicit MpmcQueue(size_t capacity)
+        : mask_(std::bit_ceil(capacity < 2 ? size_t{2} : capacity) - 1),
+          cells_(std::make_unique<Cell[]>(mask_ + 1)) {
+        for (size_t i = 0; i <= mask_; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    /**
+     * @brief 入队
+     * @return 队列已满时返回 false，此时 item 没有被移动
+     */
+    bool try_push(T&& item) {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false;    // 上一圈的数据还没被取走: 已满
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(item);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 出队，队列为空时返回 std::nullopt
+    std::optional<T> try_pop() {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &cells_[pos & mask_];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            auto diff =
+                static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                if (dequeue_pos_.compare_exchange_weak(
+                        pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return std::nullopt;    // 这个位置还没有生产者写入: 为空
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        std::optional<T> item(std::move(cell->value));
+        cell->value = T();
+        cell->sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return item;
+    }
+
+    /**
+     * @brief 近似元素个数 (包括已被占住、尚未写完/取完的槽位)
+     *
+     * 与 push/pop 并发时只是快照。`empty()` 返回 false 时，
+     * 数据可能还在写入途中，紧接着的 try_pop 仍可能失败。
+     */
+    size_t size() const noexcept {
+        size_t tail = dequeue_pos_.load(std::memory_order_relaxed);
+        size_t head = enqueue_pos_.load(std::memory_order_relaxed);
+        return head > tail ? head - tail : 0;
+    }
+
+    bool empty() const noexcept { return size() == 0; }
+
+    size_t capacity() const noexcept { return mask_ + 1; }
+
+   private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value{};
+    };
+
+    const size_t mask_;
+    std::unique_ptr<Cell[]> cells_;
+
+    // 生产者和消费者各自的游标独占缓存行，互不干扰
+    alignas(64) std::atomic<size_t> enqueue_pos_{0};
+    alignas(64) std::atomic<size_t> dequeue_pos_{0};
+};
+
+}    // namespace parallel
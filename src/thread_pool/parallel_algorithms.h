@@ -0,0 +1,222 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+
+#include "task_future.h"
+#include "thread_pool_fast.h"
+
+namespace parallel {
+
+namespace detail {
+
+/**
+ * @brief 一次 parallel_for / parallel_reduce 调用的共享状态 (位于调用者的栈上)
+ *
+ * 拆分出去的任务只捕获 (状态指针, 区间, 结果槽)，32 字节，放得进 InlineTask 的内联缓冲区。
+ * 最后一个结束的任务通过 Promise 通知调用者；Promise::set_value 先把共享状态指针
+ * 取出来再写结果，之后不再访问本对象，所以调用者看到完成后立刻销毁它是安全的。
+ */
+template <typename Index, typename Leaf>
+struct SplitState {
+    SplitState(ThreadPoolFast& p, Leaf& l, Index g)
+        : pool(p), leaf(l), grain(g) {}
+
+    ThreadPoolFast& pool;
+    Leaf& leaf;    // leaf(part, lo, hi): 顺序处理 [lo, hi)，结果记在 part 里
+    Index grain;
+
+    std::atomic<size_t> pending{1};    // 调用者自己算 1 个
+    std::atomic<bool> failed{false};
+    std::exception_ptr error;
+    Promise<void> done;
+
+    void finish_one() {
+        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            if (error) {
+                done.set_exception(error);
+            } else {
+                done.set_value();
+            }
+        }
+    }
+
+    void record(std::exception_ptr e) noexcept {
+        if (!failed.exchange(true, std::memory_order_acq_rel)) {
+            error = std::move(e);
+        }
+    }
+};
+
+/**
+ * @brief parallel_reduce 的部分结果: 每个 run_split 调用 (调用者自己和每个拆出去的任务) 一个
+ *
+ * 一次调用先顺序处理自己区间的前缀，每次拆分都从剩余区间切走尾部，所以它自己的结果在前，
+ * 拆出去的子区间按拆分的先后从后往前排列。子节点插在链表头，链表就是按位置从前到后的顺序，
+ * 汇合之后沿着这棵拆分树依次合并即可，不需要加锁，也不需要排序。
+ */
+template <typename T>
+struct ReducePart {
+    std::optional<T> acc;                     // 本次调用处理过的块的累加值
+    std::unique_ptr<ReducePart> first_child;  // 拆出去的子区间中位置最靠前的
+    std::unique_ptr<ReducePart> next;         // 同一父节点下位置紧随其后的兄弟
+};
+
+// parallel_for 没有部分结果
+inline std::nullptr_t fork_part(std::nullptr_t) { return nullptr; }
+
+// 拆分时由父调用创建子节点 (只有父调用自己访问自己的链表)
+template <typename T>
+ReducePart<T>* fork_part(ReducePart<T>* parent) {
+    auto child = std::make_unique<ReducePart<T>>();
+    child->next = std::move(parent->first_child);
+    parent->first_child = std::move(child);
+    return parent->first_child.get();
+}
+
+/**
+ * @brief 懒惰二分 (Lazy Binary Splitting)
+ *
+ * 按 grain 大小一块一块地顺序处理 [lo, hi)。每处理一块之前问一次线程池:
+ * “现在拆出去有人要吗?” (`has_idle_workers`)。只有有空闲的窃取者时，
+ * 才把剩余区间的后一半作为新任务压入队列，自己继续处理前一半。
+ * 所有线程都忙的时候一次拆分都不做，任务开销只有一次原子读。
+ */
+template <typename Index, typename Leaf, typename Part>
+void run_split(SplitState<Index, Leaf>& state, Index lo, Index hi, Part part) {
+    try {
+        while (lo < hi) {
+            while (hi - lo > state.grain && state.pool.has_idle_workers()) {
+                Index mid = lo + (hi - lo) / 2;
+                Part child = fork_part(part);
+                state.pending.fetch_add(1, std::memory_order_relaxed);
+                // 异常和完成都经由 state 汇报，用 post 省掉 Future 的共享状态
+                state.pool.post([s = &state, mid, hi, child] {
+                    run_split(*s, mid, hi, child);
+                });
+                hi = mid;
+            }
+            Index end = hi - lo > state.grain ? lo + state.grain : hi;
+            state.leaf(part, lo, end);
+            lo = end;
+        }
+    } catch (...) {
+        state.record(std::current_exception());
+    }
+    state.finish_one();
+}
+
+// 自动粒度: 每个线程大约 64 块，既足够细以便负载均衡，又让“是否拆分”的检查可以忽略不计
+template <typename Index>
+Index auto_grain(Index count, size_t num_threads) {
+    size_t blocks = std::max<size_t>(num_threads, 1) * 64;
+    return std::max<Index>(1, static_cast<Index>(count / blocks));
+}
+
+// 调用者在当前线程处理整个区间 (按需拆分)，然后边帮忙执行任务边等待所有子任务结束
+template <typename Index, typename Leaf, typename Part>
+void run_and_join(ThreadPoolFast& pool, Index first, Index last, Index grain,
+                  Leaf& leaf, Part root) {
+    SplitState<Index, Leaf> state(pool, leaf, grain);
+    Future<void> done = state.done.get_future();
+
+    run_split(state, first, last, root);
+
+    // 汇合: 调用者可能就是 worker，不能干等，边执行排队中的任务边等待
+    pool.help_until_ready(done);
+    done.get();    // 重新抛出第一个异常
+}
+
+}    // namespace detail
+
+/**
+ * @brief 并行执行 body(i)，i ∈ [first, last)
+ *
+ * 调用线程本身也参与计算，可以从 worker 线程内部嵌套调用。
+ * 拆分采用懒惰二分: 只有存在空闲线程时才拆分，细粒度循环 (每次迭代几十纳秒) 也能接近线性加速。
+ *
+ * @param grain 最小拆分粒度 (迭代次数)，0 表示自动选择
+ * @throws body 抛出的第一个异常 (在所有已开始的块结束之后重新抛出)
+ */
+template <std::integral Index, typename Body>
+    requires std::invocable<Body&, Index>
+void parallel_for(ThreadPoolFast& pool, Index first, Index last, Body&& body,
+                  Index grain = 0) {
+    if (first >= last) {
+        return;
+    }
+    if (grain <= 0) {
+        grain = detail::auto_grain<Index>(last - first, pool.size());
+    }
+
+    auto leaf = [&body](std::nullptr_t, Index lo, Index hi) {
+        for (Index i = lo; i < hi; ++i) {
+            std::invoke(body, i);
+        }
+    };
+    detail::run_and_join(pool, first, last, grain, leaf, nullptr);
+}
+
+/**
+ * @brief 并行归约: op(...op(op(identity, r[0]), r[1])..., r[n-1])
+ *
+ * 每个任务在自己负责的连续区间上顺序累加，最后按区间顺序合并各段结果，
+ * 因此 op 只需要满足结合律 (不要求交换律，例如字符串拼接也可以)。
+ * identity 必须是 op 的单位元: 每一段都从 identity 开始累加。
+ *
+ * @param grain 最小拆分粒度 (元素个数)，0 表示自动选择
+ */
+template <std::ranges::random_access_range R, typename T, typename Op>
+    requires std::ranges::sized_range<R> &&
+             std::invocable<Op&, T, std::ranges::range_reference_t<R>> &&
+             std::invocable<Op&, T, T>
+T parallel_reduce(ThreadPoolFast& pool, R&& range, T identity, Op op,
+                  size_t grain = 0) {
+    size_t count = static_cast<size_t>(std::ranges::size(range));
+    if (count == 0) {
+        return identity;
+    }
+    if (grain == 0) {
+        grain = detail::auto_grain<size_t>(count, pool.size());
+    }
+
+    // 每次 run_split 调用把自己处理过的块累加进自己的 ReducePart，没有共享写入
+    using Part = detail::ReducePart<T>;
+    Part root;
+    auto begin = std::ranges::begin(range);
+
+    auto leaf = [&](Part* part, size_t lo, size_t hi) {
+        T acc = part->acc ? std::move(*part->acc) : identity;
+        for (size_t i = lo; i < hi; ++i) {
+            acc = std::invoke(op, std::move(acc), begin[i]);
+        }
+        part->acc = std::move(acc);
+    };
+    detail::run_and_join<size_t>(pool, 0, count, grain, leaf, &root);
+
+    // 按拆分树的顺序 (也就是区间顺序) 合并: 先是节点自己，再依次是它的子节点
+    T result = std::move(identity);
+    auto fold = [&](auto& self, Part& part) -> void {
+        if (part.acc) {
+            result = std::invoke(op, std::move(result), std::move(*part.acc));
+        }
+        for (Part* child = part.first_child.get(); child != nullptr;
+             child = child->next.get()) {
+            self(self, *child);
+        }
+    };
+    fold(fold, root);
+    return result;
+}
+
+}    // namespace parallel
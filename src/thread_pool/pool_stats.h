@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace parallel {
+
+/**
+ * @brief 单写者计数器: 只有一个线程 (所属的 worker) 写，任意线程可以读
+ *
+ * 写入是 relaxed 的 load + store，而不是 fetch_add: 没有 lock 前缀的 RMW，
+ * 代价与普通的 `++x` 相同。读者 (stats 快照) 可能读到稍旧的值，但不会读到撕裂的值。
+ */
+class StatCounter {
+   public:
+    void add(uint64_t n = 1) noexcept {
+        value_.store(value_.load(std::memory_order_relaxed) + n,
+                     std::memory_order_relaxed);
+    }
+
+    uint64_t load() const noexcept {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    std::atomic<uint64_t> value_{0};
+};
+
+/**
+ * @brief 一个 worker 的统计快照
+ */
+struct WorkerStats {
+    uint64_t executed = 0;          // 执行的任务数
+    uint64_t steals = 0;            // 成功的窃取次数
+    uint64_t stolen = 0;            // 窃取得到的任务数 (Steal-Half 一次可以拿多个)
+    uint64_t steal_failures = 0;    // 遍历所有受害者都没偷到的次数
+    uint64_t lock_misses = 0;       // 窃取时 try_lock 失败的次数
+    uint64_t parks = 0;             // 真正进入休眠的次数
+    std::chrono::nanoseconds parked{0};    // 休眠的总时长
+    size_t queue_depth = 0;    // 采样时队列中的任务数 (不是累计值)
+
+    WorkerStats& operator+=(const WorkerStats& other) {
+        executed += other.executed;
+        steals += other.steals;
+        stolen += other.stolen;
+        steal_failures += other.steal_failures;
+        lock_misses += other.lock_misses;
+        parks += other.parks;
+        parked += other.parked;
+        queue_depth += other.queue_depth;
+        return *this;
+    }
+};
+
+/**
+ * @brief 一个租户的使用量快照 (ThreadPoolFast 的 add_tenant)
+ */
+struct TenantStats {
+    uint32_t weight = 0;      // 当前权重
+    uint64_t executed = 0;    // 从租户队列取出执行的任务数 (任务内部派生的子任务不计入)
+    uint64_t busy_ns = 0;     // 这些任务的执行时长之和
+    uint64_t queued = 0;      // 排队中的任务数 (采样值)
+    uint64_t rejected = 0;    // 因超过 max_queued 被拒绝的提交数
+};
+
+/**
+ * @brief 整个线程池的统计快照 (由 `stats()` 按需汇总)
+ */
+struct PoolStats {
+    std::vector<WorkerStats> workers;    // 每个 worker 槽位一项
+    WorkerStats total;                   // 所有 worker 之和，加上外部线程帮忙执行的任务
+
+    // 按优先级统计的执行任务数，下标为优先级 (只有 ThreadPoolPriority 填写)
+    std::vector<uint64_t> executed_by_priority;
+
+    // 饥饿统计 (只有 ThreadPoolPriority 填写，下标为优先级):
+    // bypassed: 该级别有任务在等，但 worker 选择了更高级别的次数
+    // promoted: 因为被越过太多次，由防饥饿策略提前执行的次数
+    std::vector<uint64_t> bypassed_by_priority;
+    std::vector<uint64_t> promoted_by_priority;
+
+    // 截止时间任务 (只有 ThreadPoolPriority 的 submit_by / post_by 填写)
+    uint64_t deadline_executed = 0;    // 从 EDF 队列取出执行的任务数 (含过期丢弃的)
+    uint64_t deadline_expired = 0;     // 开始前已过期，没有执行
+    uint64_t deadline_late = 0;        // 按时开始，但完成时已过期
+
+    // 按租户的使用量，下标为 TenantId (只有 ThreadPoolFast 在 add_tenant 之后填写)
+    std::vector<TenantStats> tenants;
+
+    // 只执行最高级任务的专用 worker (只有 ThreadPoolPriority 填写)，已计入 total
+    std::vector<WorkerStats> reserved_workers;
+};
+
+/**
+ * @brief 每个 worker 私有的计数器，独占缓存行
+ *
+ * **低开销**: 热路径上只写自己缓存行里的计数器，没有共享原子变量，没有 false sharing。
+ * 汇总的代价由调用 `stats()` 的线程承担。
+ */
+struct alignas(64) WorkerCounters {
+    StatCounter executed;
+    StatCounter steals;
+    StatCounter stolen;
+    StatCounter steal_failures;
+    StatCounter lock_misses;
+    StatCounter parks;
+    StatCounter parked_ns;
+
+    // 记录一次休眠 (start 为进入休眠前的时刻)
+    void record_park(std::chrono::steady_clock::time_point start) noexcept {
+        parks.add();
+        parked_ns.add(static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - start)
+                .count()));
+    }
+
+    WorkerStats snapshot() const {
+        WorkerStats s;
+        s.executed = executed.load();
+        s.steals = steals.load();
+        s.stolen = stolen.load();
+        s.steal_failures = steal_failures.load();
+        s.lock_misses = lock_misses.load();
+        s.parks = parks.load();
+        s.parked = std::chrono::nanoseconds(parked_ns.load());
+        return s;
+    }
+};
+
+}    // namespace parallel
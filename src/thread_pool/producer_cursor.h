@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace parallel {
+
+/**
+ * @brief 外部提交者的轮询游标缓存: 每个提交线程一份，按池记录下一次投递的队列
+ *
+ * 只记一个池的游标时，交替向两个池提交的线程每次切换都要重新领取起点
+ * (一次共享的 fetch_add)，而且丢掉了原来的轮询位置。这里保留最近用过的
+ * kEntries 个池，命中时只读写线程私有的数据；满了以后挤掉最久没用的一项。
+ *
+ * 条目按最近使用排在前面，常见的“一直向同一个池提交”在第一项就命中。
+ * 池析构后留下的条目不会被访问，只会慢慢被挤掉；新池恰好复用同一地址时
+ * 沿用旧的位置也无妨，它只是一个起点。
+ */
+class ProducerCursorCache {
+   public:
+    static constexpr size_t kEntries = 8;
+
+    // pool 的游标 (调用者自增)。不在缓存中时从 seed 领取一个起点
+    size_t& get(const void* pool, std::atomic<size_t>& seed) {
+        if (entries_[0].pool == pool) {
+            return entries_[0].next;
+        }
+        size_t hit = 1;
+        while (hit < kEntries && entries_[hit].pool != pool) {
+            ++hit;
+        }
+        Entry entry;
+        if (hit == kEntries) {
+            entry = {pool, seed.fetch_add(1, std::memory_order_relaxed)};
+            hit = kEntries - 1;    // 最后一项最久没用，被挤掉
+        } else {
+            entry = entries_[hit];
+        }
+        for (; hit > 0; --hit) {
+            entries_[hit] = entries_[hit - 1];
+        }
+        entries_[0] = entry;
+        return entries_[0].next;
+    }
+
+   private:
+    struct Entry {
+        const void* pool = nullptr;
+        size_t next = 0;
+    };
+
+    Entry entries_[kEntries];
+};
+
+}    // namespace parallel
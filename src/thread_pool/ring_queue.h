@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace parallel {
+
+/**
+ * @brief 可增长的环形双端队列 (替代 std::deque 作为加锁任务队列的底层容器)
+ *
+ * **为什么不用 std::deque**: libstdc++ 的 deque 以 512 字节为一块分配内存，
+ * 64 字节的 InlineTask 每 8 个就要分配一块，弹出后又立刻释放，
+ * 在高频 push/pop 的任务队列里相当于每 8 次提交一次 malloc/free。
+ *
+ * **RingQueue 的做法**: 一整块容量为 2 的幂的环形缓冲区，写满时扩容为两倍，
+ * 之后一直复用，稳态下 push/pop 不触发任何堆分配。
+ * 不是线程安全的，由使用者 (线程池的队列锁) 保护。
+ */
+template <typename T>
+class RingQueue {
+   public:
+    RingQueue() = default;
+
+    RingQueue(const RingQueue&) = delete;
+    RingQueue& operator=(const RingQueue&) = delete;
+
+    ~RingQueue() {
+        clear();
+        if (slots_ != nullptr) {
+            std::allocator<T>().deallocate(slots_, capacity_);
+        }
+    }
+
+    bool empty() const noexcept { return size_ == 0; }
+
+    size_t size() const noexcept { return size_; }
+
+    T& front() noexcept { return slots_[head_]; }
+
+    T& back() noexcept { return slots_[(head_ + size_ - 1) & (capacity_ - 1)]; }
+
+    void push_back(T&& item) {
+        if (size_ == capacity_) {
+            grow();
+        }
+        std::construct_at(&slots_[(head_ + size_) & (capacity_ - 1)],
+                          std::move(item));
+        ++size_;
+    }
+
+    void pop_front() noexcept {
+        std::destroy_at(&slots_[head_]);
+        head_ = (head_ + 1) & (capacity_ - 1);
+        --size_;
+    }
+
+    void pop_back() noexcept {
+        std::destroy_at(&back());
+        --size_;
+    }
+
+    void clear() noexcept {
+        while (!empty()) {
+            pop_front();
+        }
+    }
+
+   private:
+    void grow() {
+        size_t new_capacity = capacity_ == 0 ? 16 : capacity_ * 2;
+        T* new_slots = std::allocator<T>().allocate(new_capacity);
+        for (size_t i = 0; i < size_; ++i) {
+            T& item = slots_[(head_ + i) & (capacity_ - 1)];
+            std::construct_at(&new_slots[i], std::move(item));
+            std::destroy_at(&item);
+        }
+        if (slots_ != nullptr) {
+            std::allocator<T>().deallocate(slots_, capacity_);
+        }
+        slots_ = new_slots;
+        capacity_ = new_capacity;
+        head_ = 0;
+    }
+
+    T* slots_ = nullptr;
+    size_t capacity_ = 0;    // 总是 0 或 2 的幂
+    size_t head_ = 0;
+    size_t size_ = 0;
+};
+
+}    // namespace parallel
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <utility>
+
+#include "inline_task.h"
+#include "task_future.h"
+
+namespace parallel {
+
+namespace detail {
+
+/**
+ * @brief 一批任务共享的完成计数器 (submit_n / submit_bulk 使用)
+ *
+ * 整批任务只对应一个 Future<void>:
+ * - 每个任务结束时 `remaining_` 减一，最后一个任务负责写入结果并释放本对象。
+ * - 任意一个任务抛出异常，Future 最终会重新抛出第一个异常。
+ */
+class BatchCompletion {
+   public:
+    explicit BatchCompletion(size_t count) : remaining_(count) {}
+
+    virtual ~BatchCompletion() = default;
+
+    Future<void> get_future() { return promise_.get_future(); }
+
+    // 某个任务结束 (error 为空表示成功)
+    void finish_one(std::exception_ptr error) noexcept {
+        if (error && !failed_.exchange(true, std::memory_order_acq_rel)) {
+            error_ = std::move(error);
+        }
+        if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            if (error_) {
+                promise_.set_exception(error_);
+            } else {
+                promise_.set_value();
+            }
+            delete this;
+        }
+    }
+
+   private:
+    std::atomic<size_t> remaining_;
+    std::atomic<bool> failed_{false};
+    std::exception_ptr error_;
+    Promise<void> promise_;
+};
+
+// submit_n 的整批状态: 所有任务共享同一个 fn，每个任务只携带自己的下标
+template <typename Fn>
+class IndexedBatch : public BatchCompletion {
+   public:
+    IndexedBatch(size_t count, Fn fn)
+        : BatchCompletion(count), fn_(std::move(fn)) {}
+
+    void run(size_t index) { std::invoke(fn_, index); }
+
+   private:
+    Fn fn_;
+};
+
+/**
+ * @brief 批次中的单个任务
+ *
+ * 执行后向批次报告结果；如果没被执行就被丢弃 (例如线程池析构)，
+ * 则报告 broken_promise，保证整批的 Future 不会永远等待。
+ */
+template <typename Body>
+class BatchItem {
+   public:
+    BatchItem(BatchCompletion* batch, Body body)
+        : batch_(batch), body_(std::move(body)) {}
+
+    BatchItem(BatchItem&& other) noexcept
+        : batch_(std::exchange(other.batch_, nullptr)),
+          body_(std::move(other.body_)) {}
+
+    BatchItem(const BatchItem&) = delete;
+    BatchItem& operator=(const BatchItem&) = delete;
+    BatchItem& operator=(BatchItem&&) = delete;
+
+    ~BatchItem() {
+        if (batch_ != nullptr) {
+            batch_->finish_one(std::make_exception_ptr(
+                std::future_error(std::future_errc::broken_promise)));
+        }
+    }
+
+    void operator()() {
+        std::exception_ptr error;
+        try {
+            std::invoke(body_);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        std::exchange(batch_, nullptr)->finish_one(std::move(error));
+    }
+
+   private:
+    BatchCompletion* batch_;
+    Body body_;
+};
+
+// submit_n 中每个任务的执行体: 调用共享 fn 的第 index 次
+template <typename Fn>
+struct IndexedCall {
+    IndexedBatch<Fn>* batch;
+    size_t index;
+
+    void operator()() { batch->run(index); }
+};
+
+}    // namespace detail
+
+template <typename Body>
+struct is_trivially_relocatable<detail::BatchItem<Body>>
+    : std::bool_constant<is_trivially_relocatable_v<Body>> {};
+
+}    // namespace parallel
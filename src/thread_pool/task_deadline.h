@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+
+#include "inline_task.h"
+#include "latency_histogram.h"
+
+namespace parallel {
+
+// submit_by 的截止时间 (单调时钟)
+using Deadline = std::chrono::steady_clock::time_point;
+
+/**
+ * @brief 任务开始执行时已经过了截止时间: 任务体不会被调用
+ *
+ * submit_by 的 Future 会收到这个异常；post_by 的任务把它交给线程池的异常处理函数。
+ */
+class DeadlineExceeded : public std::runtime_error {
+   public:
+    DeadlineExceeded()
+        : std::runtime_error("task deadline expired before it started") {}
+};
+
+namespace detail {
+
+// 截止时间的整数表示 (与 latency_now 同一时钟)，小于 0 的时刻按 0 处理
+inline uint64_t deadline_ns(Deadline deadline) noexcept {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  deadline.time_since_epoch())
+                  .count();
+    return ns > 0 ? static_cast<uint64_t>(ns) : 0;
+}
+
+// 截止时间统计: 只在错过截止时间时写入，正常路径不碰这两个共享计数
+struct DeadlineCounters {
+    std::atomic<uint64_t> expired{0};    // 开始前已过期，被丢弃
+    std::atomic<uint64_t> late{0};       // 按时开始，但完成时已过期
+};
+
+// submit_by / post_by 的任务体: 开始前检查截止时间，过期则抛出 DeadlineExceeded 而不执行
+template <typename Fn>
+struct DeadlineCall {
+    Fn fn;
+    uint64_t deadline;
+    DeadlineCounters* counters;
+
+    std::invoke_result_t<Fn&> operator()() {
+        if (latency_now() > deadline) {
+            counters->expired.fetch_add(1, std::memory_order_relaxed);
+            throw DeadlineExceeded();
+        }
+        if constexpr (std::is_void_v<std::invoke_result_t<Fn&>>) {
+            std::invoke(fn);
+            check_late();
+        } else {
+            std::invoke_result_t<Fn&> result = std::invoke(fn);
+            check_late();
+            return result;
+        }
+    }
+
+    void check_late() const noexcept {
+        if (latency_now() > deadline) {
+            counters->late.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+};
+
+}    // namespace detail
+
+template <typename Fn>
+struct is_trivially_relocatable<detail::DeadlineCall<Fn>>
+    : std::bool_constant<is_trivially_relocatable_v<Fn>> {};
+
+}    // namespace parallel
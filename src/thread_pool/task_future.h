@@ -0,0 +1,586 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include "inline_task.h"
+
+namespace parallel {
+
+namespace detail {
+
+/**
+ * @brief 共享状态的小块内存缓存 (thread-local free list)
+ *
+ * 每次 submit 都需要一块共享状态让 worker 回写结果。这些块大小固定且生命周期很短，
+ * 所以释放时不还给 malloc，而是挂到当前线程的空闲链表上，下次分配直接复用。
+ * - 没有任何锁或原子操作: 链表是 thread_local 的。
+ * - 有上限 (kMaxCached)，防止某个线程只释放不分配时无限囤积内存。
+ */
+class StateBlockCache {
+   public:
+    // 共享状态里带一个 InlineTask 作为 then() 的回调槽，std::string 大小的结果也能放下
+    static constexpr size_t kBlockSize = 192;
+    static constexpr size_t kMaxCached = 4096;
+
+    static void* allocate(size_t size, size_t align) {
+        if (!cacheable(size, align)) {
+            return ::operator new(size, std::align_val_t(align));
+        }
+        FreeList& list = local();
+        if (list.head != nullptr) {
+            Node* node = list.head;
+            list.head = node->next;
+            --list.count;
+            return node;
+        }
+        return ::operator new(kBlockSize);
+    }
+
+    static void deallocate(void* ptr, size_t size, size_t align) noexcept {
+        if (!cacheable(size, align)) {
+            ::operator delete(ptr, size, std::align_val_t(align));
+            return;
+        }
+        FreeList& list = local();
+        if (list.count >= kMaxCached) {
+            ::operator delete(ptr, kBlockSize);
+            return;
+        }
+        list.head = ::new (ptr) Node{list.head};
+        ++list.count;
+    }
+
+   private:
+    struct Node {
+        Node* next;
+    };
+
+    struct FreeList {
+        Node* head = nullptr;
+        size_t count = 0;
+
+        ~FreeList() {
+            while (head != nullptr) {
+                Node* next = head->next;
+                ::operator delete(head, kBlockSize);
+                head = next;
+            }
+        }
+    };
+
+    static bool cacheable(size_t size, size_t align) noexcept {
+        return size <= kBlockSize &&
+               align <= __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+    }
+
+    static FreeList& local() {
+        thread_local FreeList list;
+        return list;
+    }
+};
+
+}    // namespace detail
+
+/**
+ * @brief 执行器接口: then() 的回调通过它回到线程池
+ *
+ * 三个线程池都实现了这个接口，它们返回的 Future 会记住自己来自哪个执行器。
+ * schedule 会在任务完成的线程上被调用 (通常是 worker)，不能阻塞。
+ */
+class Executor {
+   public:
+    virtual void schedule(InlineTask task) = 0;
+
+   protected:
+    ~Executor() = default;
+};
+
+namespace detail {
+
+/**
+ * @brief Future/Promise 之间的共享状态 (与类型无关的部分)
+ *
+ * **等待机制**: 不用 mutex + condition_variable，而是直接在 `status_` 上
+ * `std::atomic::wait` (Linux 上就是 futex)。只有真的有人在等的时候，
+ * 完成方才需要 notify，绝大多数情况下 set_value 只是一条原子写。
+ *
+ * **回调 (then)**: 状态里有一个回调槽。登记方先写好回调再置 kContinuation 位，
+ * 完成方置 kReady 位；两次 fetch_or 中后发生的一方负责执行回调，恰好执行一次。
+ */
+class StateBase {
+   public:
+    bool is_ready() const noexcept {
+        return (status_.load(std::memory_order_acquire) & kReady) != 0;
+    }
+
+    void wait() const noexcept {
+        uint32_t status = status_.load(std::memory_order_acquire);
+        while ((status & kReady) == 0) {
+            // 先登记“有人在等”，完成方看到这个标记才会 notify
+            if ((status & kWaited) == 0 &&
+                !status_.compare_exchange_weak(status, status | kWaited,
+                                               std::memory_order_acq_rel,
+                                               std::memory_order_acquire)) {
+                continue;
+            }
+            status_.wait(status | kWaited, std::memory_order_acquire);
+            status = status_.load(std::memory_order_acquire);
+        }
+    }
+
+    /**
+     * @brief 登记完成后的回调 (每个状态只能登记一次)
+     *
+     * executor 非空时回调交给它调度，否则在完成的线程上直接执行。
+     * 已经完成时立即在当前线程调度/执行。
+     */
+    void set_continuation(Executor* executor, InlineTask continuation) {
+        continuation_ = std::move(continuation);
+        executor_ = executor;
+        if (status_.fetch_or(kContinuation, std::memory_order_acq_rel) &
+            kReady) {
+            run_continuation();
+        }
+    }
+
+   protected:
+    enum : uint32_t { kWaited = 1, kReady = 2, kContinuation = 4 };
+
+    void mark_ready() noexcept {
+        uint32_t status = status_.fetch_or(kReady, std::memory_order_acq_rel);
+        if (status & kWaited) {
+            status_.notify_all();
+        }
+        if (status & kContinuation) {
+            run_continuation();
+        }
+    }
+
+    std::exception_ptr error_;
+    std::atomic<uint32_t> refs_{1};
+    mutable std::atomic<uint32_t> status_{0};
+    Executor* executor_ = nullptr;
+    InlineTask continuation_;
+
+   private:
+    void run_continuation() noexcept {
+        InlineTask continuation = std::move(continuation_);
+        if (executor_ != nullptr) {
+            executor_->schedule(std::move(continuation));
+        } else {
+            continuation();
+        }
+    }
+};
+
+template <typename T>
+class SharedState : public StateBase {
+   public:
+    static SharedState* create() {
+        void* mem = StateBlockCache::allocate(sizeof(SharedState),
+                                              alignof(SharedState));
+        return ::new (mem) SharedState();
+    }
+
+    void add_ref() noexcept { refs_.fetch_add(1, std::memory_order_relaxed); }
+
+    void release() noexcept {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            this->~SharedState();
+            StateBlockCache::deallocate(this, sizeof(SharedState),
+                                        alignof(SharedState));
+        }
+    }
+
+    template <typename... U>
+    void set_value(U&&... value) {
+        if constexpr (!std::is_void_v<T>) {
+            value_.emplace(std::forward<U>(value)...);
+        }
+        mark_ready();
+    }
+
+    void set_exception(std::exception_ptr error) noexcept {
+        error_ = std::move(error);
+        mark_ready();
+    }
+
+    // 等待完成并取出结果 (或重新抛出任务中的异常)
+    T take() {
+        wait();
+        if (error_) {
+            std::rethrow_exception(error_);
+        }
+        if constexpr (!std::is_void_v<T>) {
+            return std::move(*value_);
+        }
+    }
+
+   private:
+    SharedState() = default;
+    ~SharedState() = default;
+
+    using Stored = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+    std::optional<Stored> value_;
+};
+
+template <typename T, typename F>
+struct ThenResult;
+
+}    // namespace detail
+
+/**
+ * @brief 线程池返回的轻量 Future (替代 std::future)
+ *
+ * 与 `std::future` 的区别:
+ * 1.  共享状态来自线程局部的小块缓存，稳态下提交任务不触发 malloc。
+ * 2.  等待基于 futex (`std::atomic::wait`)，没有 mutex / condition_variable。
+ * 3.  只支持一次性 `get()`，与 `std::future` 语义一致。
+ * 4.  `then(fn)` 登记非阻塞的后续任务: 前一个任务完成时，回调被调度到产生这个
+ *     Future 的线程池上 (可以用 `via` 换一个执行器)，没有任何线程为此阻塞等待。
+ */
+template <typename T>
+class Future {
+    static_assert(!std::is_reference_v<T>, "Future 不支持引用类型的结果");
+
+   public:
+    Future() noexcept = default;
+
+    Future(Future&& other) noexcept
+        : state_(std::exchange(other.state_, nullptr)),
+          executor_(std::exchange(other.executor_, nullptr)) {}
+
+    Future& operator=(Future&& other) noexcept {
+        if (this != &other) {
+            reset();
+            state_ = std::exchange(other.state_, nullptr);
+            executor_ = std::exchange(other.executor_, nullptr);
+        }
+        return *this;
+    }
+
+    Future(const Future&) = delete;
+    Future& operator=(const Future&) = delete;
+
+    ~Future() { reset(); }
+
+    bool valid() const noexcept { return state_ != nullptr; }
+
+    bool is_ready() const noexcept {
+        return state_ != nullptr && state_->is_ready();
+    }
+
+    void wait() const {
+        check_state();
+        state_->wait();
+    }
+
+    // then() 回调将要使用的执行器 (nullptr 表示在完成的线程上直接执行)
+    Executor* executor() const noexcept { return executor_; }
+
+    // 换一个执行器运行之后的 then() 回调
+    Future via(Executor* executor) && {
+        executor_ = executor;
+        return std::move(*this);
+    }
+
+    /**
+     * @brief 登记后续任务，返回它的 Future。调用后当前 Future 失效。
+     *
+     * fn 的参数可以是:
+     * - `Future<T>`: 拿到已完成的 Future，自己处理结果或异常；
+     * - `T` (T 为 void 时无参数): 前一个任务抛出异常时不调用 fn，异常直接传给返回的 Future。
+     */
+    template <typename F>
+    auto then(F&& fn)
+        -> Future<typename detail::ThenResult<T, std::decay_t<F>>::type>;
+
+    // 阻塞直到任务完成，返回结果或重新抛出任务中的异常。调用后 Future 失效。
+    T get() {
+        check_state();
+        detail::SharedState<T>* state = std::exchange(state_, nullptr);
+        struct Release {
+            detail::SharedState<T>* state;
+
+            ~Release() { state->release(); }
+        } guard{state};
+        return state->take();
+    }
+
+   private:
+    template <typename U>
+    friend class Promise;
+    template <typename U>
+    friend class Future;
+
+    explicit Future(detail::SharedState<T>* state) noexcept : state_(state) {}
+
+    void check_state() const {
+        if (state_ == nullptr) {
+            throw std::future_error(std::future_errc::no_state);
+        }
+    }
+
+    void reset() noexcept {
+        if (state_ != nullptr) {
+            std::exchange(state_, nullptr)->release();
+        }
+    }
+
+    detail::SharedState<T>* state_ = nullptr;
+    Executor* executor_ = nullptr;
+};
+
+/**
+ * @brief Future 的写入端
+ *
+ * 析构时如果还没有写入结果，会写入 `broken_promise` 异常，
+ * 这样任务在队列中被丢弃时，等待方不会永远阻塞 (与 std::promise 一致)。
+ */
+template <typename T>
+class Promise {
+   public:
+    Promise() : state_(detail::SharedState<T>::create()) {}
+
+    Promise(Promise&& other) noexcept
+        : state_(std::exchange(other.state_, nullptr)) {}
+
+    Promise& operator=(Promise&& other) noexcept {
+        if (this != &other) {
+            abandon();
+            state_ = std::exchange(other.state_, nullptr);
+        }
+        return *this;
+    }
+
+    Promise(const Promise&) = delete;
+    Promise& operator=(const Promise&) = delete;
+
+    ~Promise() { abandon(); }
+
+    // 只能调用一次
+    Future<T> get_future() {
+        if (state_ == nullptr) {
+            throw std::future_error(std::future_errc::no_state);
+        }
+        state_->add_ref();
+        return Future<T>(state_);
+    }
+
+    template <typename... U>
+    void set_value(U&&... value) {
+        detail::SharedState<T>* state = take_state();
+        state->set_value(std::forward<U>(value)...);
+        state->release();
+    }
+
+    void set_exception(std::exception_ptr error) {
+        detail::SharedState<T>* state = take_state();
+        state->set_exception(std::move(error));
+        state->release();
+    }
+
+   private:
+    detail::SharedState<T>* take_state() {
+        if (state_ == nullptr) {
+            throw std::future_error(
+                std::future_errc::promise_already_satisfied);
+        }
+        return std::exchange(state_, nullptr);
+    }
+
+    void abandon() noexcept {
+        if (state_ != nullptr) {
+            detail::SharedState<T>* state = std::exchange(state_, nullptr);
+            state->set_exception(std::make_exception_ptr(
+                std::future_error(std::future_errc::broken_promise)));
+            state->release();
+        }
+    }
+
+    detail::SharedState<T>* state_ = nullptr;
+};
+
+// 一个已经完成的 Future<void> (例如提交了空批次)
+inline Future<void> make_ready_future() {
+    Promise<void> promise;
+    Future<void> future = promise.get_future();
+    promise.set_value();
+    return future;
+}
+
+// Promise/Future 只持有指针，可以按字节搬运
+template <typename T>
+struct is_trivially_relocatable<Promise<T>> : std::true_type {};
+
+template <typename T>
+struct is_trivially_relocatable<Future<T>> : std::true_type {};
+
+namespace detail {
+
+// then(fn) 的结果类型: fn 接受 Future<T> 时传入已完成的 Future，否则传入结果值
+template <typename T, typename F>
+struct ThenResult {
+    static auto deduce() {
+        if constexpr (std::is_invocable_v<F, Future<T>>) {
+            return std::type_identity<std::invoke_result_t<F, Future<T>>>{};
+        } else if constexpr (std::is_void_v<T>) {
+            return std::type_identity<std::invoke_result_t<F>>{};
+        } else {
+            return std::type_identity<std::invoke_result_t<F, T>>{};
+        }
+    }
+
+    using type = std::remove_cvref_t<typename decltype(deduce())::type>;
+};
+
+// then() 登记的回调: 在执行器上运行 fn，结果或异常写入下一个 Promise
+template <typename T, typename R, typename Fn>
+struct ThenCall {
+    Future<T> antecedent;
+    Promise<R> promise;
+    Fn fn;
+
+    void operator()() {
+        try {
+            if constexpr (std::is_void_v<R>) {
+                call();
+                promise.set_value();
+            } else {
+                promise.set_value(call());
+            }
+        } catch (...) {
+            promise.set_exception(std::current_exception());
+        }
+    }
+
+    decltype(auto) call() {
+        if constexpr (std::is_invocable_v<Fn, Future<T>>) {
+            return std::invoke(std::move(fn), std::move(antecedent));
+        } else if constexpr (std::is_void_v<T>) {
+            antecedent.get();    // 有异常时在这里重新抛出，fn 不会被调用
+            return std::invoke(std::move(fn));
+        } else {
+            return std::invoke(std::move(fn), antecedent.get());
+        }
+    }
+};
+
+}    // namespace detail
+
+template <typename T, typename R, typename Fn>
+struct is_trivially_relocatable<detail::ThenCall<T, R, Fn>>
+    : std::bool_constant<is_trivially_relocatable_v<Fn>> {};
+
+template <typename T>
+template <typename F>
+auto Future<T>::then(F&& fn)
+    -> Future<typename detail::ThenResult<T, std::decay_t<F>>::type> {
+    using Fn = std::decay_t<F>;
+    using R = typename detail::ThenResult<T, Fn>::type;
+
+    check_state();
+    Promise<R> promise;
+    Future<R> next = promise.get_future();
+    next.executor_ = executor_;
+
+    // 回调持有当前 Future (也就持有共享状态)，直到它被执行
+    detail::SharedState<T>* state = state_;
+    Executor* executor = executor_;
+    state->set_continuation(
+        executor, InlineTask(detail::ThenCall<T, R, Fn>{
+                      std::move(*this), std::move(promise),
+                      Fn(std::forward<F>(fn))}));
+    return next;
+}
+
+namespace detail {
+
+// 把参数绑定进可调用对象 (替代 std::bind)。没有参数时直接使用原对象，不多包一层。
+template <typename F, typename... Args>
+auto bind_call(F&& f, Args&&... args) {
+    if constexpr (sizeof...(Args) == 0) {
+        return std::decay_t<F>(std::forward<F>(f));
+    } else {
+        return [fn = std::forward<F>(f),
+                ... bound = std::forward<Args>(args)]() mutable -> decltype(auto) {
+            return std::invoke(std::move(fn), std::move(bound)...);
+        };
+    }
+}
+
+// 执行可调用对象，并把结果或异常写入 Promise (替代 std::packaged_task)
+template <typename R, typename Fn>
+struct PackagedCall {
+    Promise<R> promise;
+    Fn fn;
+
+    void operator()() {
+        try {
+            if constexpr (std::is_void_v<R>) {
+                std::invoke(fn);
+                promise.set_value();
+            } else {
+                promise.set_value(std::invoke(fn));
+            }
+        } catch (...) {
+            promise.set_exception(std::current_exception());
+        }
+    }
+};
+
+}    // namespace detail
+
+template <typename R, typename Fn>
+struct is_trivially_relocatable<detail::PackagedCall<R, Fn>>
+    : std::bool_constant<is_trivially_relocatable_v<Fn>> {};
+
+/**
+ * @brief 同 package_task，但在类型擦除之前用 wrap 给 PackagedCall 再包一层 (例如记录延迟)
+ *
+ * wrap(PackagedCall&&) 的返回值用来构造 InlineTask。
+ * 不要去包装已经擦除过的 InlineTask: 那样外层对象放不进内联缓冲区，每个任务都要堆分配。
+ */
+template <typename Wrap, typename F, typename... Args>
+    requires std::invocable<F, Args...>
+auto package_task_with(Wrap&& wrap, F&& f, Args&&... args)
+    -> std::pair<InlineTask, Future<std::invoke_result_t<F, Args...>>> {
+    using R = std::invoke_result_t<F, Args...>;
+    using Fn = decltype(detail::bind_call(std::forward<F>(f),
+                                          std::forward<Args>(args)...));
+
+    Promise<R> promise;
+    Future<R> future = promise.get_future();
+    InlineTask task(std::invoke(
+        std::forward<Wrap>(wrap),
+        detail::PackagedCall<R, Fn>{
+            std::move(promise), detail::bind_call(std::forward<F>(f),
+                                                  std::forward<Args>(args)...)}));
+    return {std::move(task), std::move(future)};
+}
+
+/**
+ * @brief 把可调用对象打包成 (任务, Future) 二元组，供各线程池的 submit 使用
+ *
+ * 小的、可平凡重定位的 lambda (按值/按引用捕获几个指针或整数) 会被整个放进
+ * InlineTask 的内联缓冲区；共享状态来自 StateBlockCache。稳态下零堆分配。
+ */
+template <typename F, typename... Args>
+    requires std::invocable<F, Args...>
+auto package_task(F&& f, Args&&... args)
+    -> std::pair<InlineTask, Future<std::invoke_result_t<F, Args...>>> {
+    return package_task_with(std::identity{}, std::forward<F>(f),
+                             std::forward<Args>(args)...);
+}
+
+}    // namespace parallel
@@ -0,0 +1,158 @@
+#include "task_graph.h"
+
+#include <stdexcept>
+
+namespace parallel {
+
+TaskGraph::~TaskGraph() {
+    while (running_.load(std::memory_order_acquire)) {
+        if (!pool_.try_run_one()) {
+            running_.wait(true, std::memory_order_acquire);
+        }
+    }
+}
+
+void TaskGraph::precede(NodeId before, NodeId after) {
+    check_idle();
+    if (before >= nodes_.size() || after >= nodes_.size()) {
+        throw std::out_of_range("TaskGraph::precede: no such node");
+    }
+    nodes_[before].successors.push_back(after);
+    ++nodes_[after].predecessors;
+    dirty_ = true;
+}
+
+Future<void> TaskGraph::run() {
+    if (running_.exchange(true, std::memory_order_acq_rel)) {
+        throw std::logic_error("TaskGraph::run: previous run not finished");
+    }
+    try {
+        prepare();
+    } catch (...) {
+        running_.store(false, std::memory_order_release);
+        throw;
+    }
+    if (nodes_.empty()) {
+        running_.store(false, std::memory_order_release);
+        return make_ready_future().via(&pool_);
+    }
+
+    // 重置计数器。入队时的同步保证 worker 能看到这些写入
+    for (size_t i = 0; i < nodes_.size(); ++i) {
+        pending_[i].store(nodes_[i].predecessors, std::memory_order_relaxed);
+    }
+    remaining_.store(nodes_.size(), std::memory_order_relaxed);
+    done_ = Promise<void>();
+    Future<void> result = done_.get_future().via(&pool_);
+
+    for (NodeId root : roots_) {
+        dispatch(root);
+    }
+    return result;
+}
+
+void TaskGraph::run_and_wait() {
+    Future<void> done = run();
+    pool_.help_until_ready(done);
+    done.get();
+}
+
+void TaskGraph::prepare() {
+    if (!dirty_) {
+        return;
+    }
+
+    // Kahn 拓扑排序: 能全部出队说明没有环
+    std::vector<uint32_t> indegree(nodes_.size());
+    std::vector<NodeId> order;
+    order.reserve(nodes_.size());
+    roots_.clear();
+    for (NodeId i = 0; i < nodes_.size(); ++i) {
+        indegree[i] = nodes_[i].predecessors;
+        if (indegree[i] == 0) {
+            roots_.push_back(i);
+            order.push_back(i);
+        }
+    }
+    for (size_t head = 0; head < order.size(); ++head) {
+        for (NodeId succ : nodes_[order[head]].successors) {
+            if (--indegree[succ] == 0) {
+                order.push_back(succ);
+            }
+        }
+    }
+    if (order.size() != nodes_.size()) {
+        throw std::invalid_argument("TaskGraph::run: graph contains a cycle");
+    }
+
+    pending_ = std::make_unique<std::atomic<uint32_t>[]>(nodes_.size());
+    dirty_ = false;
+}
+
+void TaskGraph::check_idle() const {
+    if (running_.load(std::memory_order_acquire)) {
+        throw std::logic_error("TaskGraph: cannot modify a running graph");
+    }
+}
+
+void TaskGraph::dispatch(NodeId id) {
+    pool_.post([this, id] { execute(id); });
+}
+
+void TaskGraph::execute(NodeId id) noexcept {
+    while (true) {
+        Node& node = nodes_[id];
+        // 已经有节点失败: 不再执行新的节点，但照常递减计数，让整次执行走完
+        if (!failed_.load(std::memory_order_relaxed)) {
+            try {
+                node.body();
+            } catch (...) {
+                if (!failed_.exchange(true, std::memory_order_acq_rel)) {
+                    error_ = std::current_exception();
+                }
+            }
+        }
+
+        // 第一个就绪的后继留给自己，其余的提交给线程池
+        NodeId next = kNone;
+        for (NodeId succ : node.successors) {
+            if (pending_[succ].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                if (next == kNone) {
+                    next = succ;
+                } else {
+                    dispatch(succ);
+                }
+            }
+        }
+
+        // 最后一个完成的节点之后不能再访问 this: 等待方可能已经销毁本对象
+        if (remaining_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            finish();
+            return;
+        }
+        if (next == kNone) {
+            return;
+        }
+        id = next;
+    }
+}
+
+void TaskGraph::finish() noexcept {
+    Promise<void> done = std::move(done_);
+    std::exception_ptr error;
+    if (failed_.load(std::memory_order_acquire)) {
+        error = std::exchange(error_, nullptr);
+        failed_.store(false, std::memory_order_relaxed);
+    }
+
+    // 先允许下一次 run() / 析构，再通知 Future。notify 只用到地址本身
+    running_.store(false, std::memory_order_release);
+    running_.notify_all();
+    if (error) {
+        done.set_exception(std::move(error));
+    } else {
+        done.set_value();
+    }
+}
+
+}    // namespace parallel
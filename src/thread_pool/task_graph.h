@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "inline_task.h"
+#include "task_future.h"
+#include "thread_pool_fast.h"
+
+namespace parallel {
+
+/**
+ * @brief 在 ThreadPoolFast 上执行的任务依赖图 (DAG)
+ *
+ * **问题**: 用 Future 手写依赖，就得在任务里 `get()` 上游的结果，worker 被阻塞，
+ * 依赖链一长，固定大小的线程池很容易全部卡在等待上。
+ *
+ * **做法**:
+ * 1.  **原子前驱计数**: 每个节点有一个计数器，初值为前驱个数。节点执行完后给每个后继减一，
+ *     减到 0 的后继就绪。没有任何线程等待上游。
+ * 2.  **内联续跑**: 就绪的后继中第一个直接在当前 worker 上接着执行 (数据还热在缓存里，也省一次入队)，
+ *     其余的才提交到线程池，由空闲 worker 窃取。
+ * 3.  **可重复执行**: 节点、边和计数器数组只在结构改变后的第一次 `run()` 时整理一次；
+ *     之后每次 `run()` 只是重置计数器并提交根节点，不分配内存。
+ *     适合每帧/每批都要跑一遍的固定流程。
+ *
+ * **用法**:
+ * ```
+ * TaskGraph graph(pool);
+ * auto load = graph.add([&] { ... });
+ * auto parse = graph.add([&] { ... });
+ * graph.precede(load, parse);     // load 完成后才执行 parse
+ * graph.run().get();              // 或 graph.run_and_wait()
+ * ```
+ *
+ * 节点抛出异常后，尚未开始的节点不再执行 (仍然会按依赖关系“走完”)，
+ * `run()` 返回的 Future 重新抛出第一个异常。
+ */
+class TaskGraph {
+   public:
+    using NodeId = size_t;
+
+    explicit TaskGraph(ThreadPoolFast& pool) : pool_(pool) {}
+
+    // 析构时等待正在进行的执行结束 (等待期间帮忙执行线程池中的任务)
+    ~TaskGraph();
+
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    /**
+     * @brief 添加一个节点，返回它的编号。fn 在每次 run() 时被调用一次
+     * @throws std::logic_error 图正在执行
+     */
+    template <typename F>
+        requires std::invocable<std::decay_t<F>&>
+    NodeId add(F&& fn);
+
+    /**
+     * @brief 添加一条边: before 完成之后才执行 after
+     * @throws std::out_of_range 节点编号不存在
+     * @throws std::logic_error 图正在执行
+     */
+    void precede(NodeId before, NodeId after);
+
+    size_t size() const { return nodes_.size(); }
+
+    /**
+     * @brief 执行一遍整个图，全部节点完成后 Future 就绪
+     *
+     * 上一次执行完成之前不能再次调用。
+     * @throws std::invalid_argument 图中有环
+     * @throws std::logic_error 上一次执行尚未完成
+     */
+    Future<void> run();
+
+    // 执行一遍并等待完成，等待期间帮忙执行线程池中的任务 (在 worker 内调用也不会死锁)
+    void run_and_wait();
+
+   private:
+    struct Node {
+        template <typename F>
+        explicit Node(F&& fn) : body(std::forward<F>(fn)) {}
+
+        InlineTask body;
+        std::vector<NodeId> successors;
+        uint32_t predecessors = 0;
+    };
+
+    // 结构改变后整理一次: 检查环、按节点数分配计数器
+    void prepare();
+
+    void check_idle() const;
+
+    // 提交一个就绪节点到线程池
+    void dispatch(NodeId id);
+
+    // 执行节点，并沿着“第一个就绪的后继”在当前线程继续执行
+    void execute(NodeId id) noexcept;
+
+    // 最后一个节点完成: 写入结果，允许下一次 run()
+    void finish() noexcept;
+
+    static constexpr NodeId kNone = static_cast<NodeId>(-1);
+
+    ThreadPoolFast& pool_;
+    std::vector<Node> nodes_;
+    std::vector<NodeId> roots_;
+    bool dirty_ = true;
+
+    // 每次 run() 重置，不重新分配
+    std::unique_ptr<std::atomic<uint32_t>[]> pending_;
+    std::atomic<size_t> remaining_{0};
+    std::atomic<bool> running_{false};
+    std::atomic<bool> failed_{false};
+    std::exception_ptr error_;
+    Promise<void> done_;
+};
+
+template <typename F>
+    requires std::invocable<std::decay_t<F>&>
+TaskGraph::NodeId TaskGraph::add(F&& fn) {
+    check_idle();
+    nodes_.emplace_back(std::forward<F>(fn));
+    dirty_ = true;
+    return nodes_.size() - 1;
+}
+
+}    // namespace parallel
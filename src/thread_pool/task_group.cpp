@@ -0,0 +1,38 @@
+#include "task_group.h"
+
+namespace parallel {
+
+TaskGroup::~TaskGroup() { join(); }
+
+void TaskGroup::wait() {
+    join();
+    if (failed_.load(std::memory_order_acquire)) {
+        failed_.store(false, std::memory_order_relaxed);
+        std::rethrow_exception(std::exchange(error_, nullptr));
+    }
+}
+
+void TaskGroup::finish_one(std::exception_ptr error) noexcept {
+    if (error && !failed_.exchange(true, std::memory_order_acq_rel)) {
+        error_ = std::move(error);
+    }
+    // 与 std::latch::count_down 相同: 先减计数再 notify。
+    // notify 只用到地址本身，等待方看到 0 之后立刻销毁本对象也没有问题。
+    if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        pending_.notify_all();
+    }
+}
+
+void TaskGroup::join() noexcept {
+    uint32_t pending = pending_.load(std::memory_order_acquire);
+    while (pending != 0) {
+        // 有任务就帮忙执行 (很可能正是本组的子任务)；
+        // 没有可执行的任务时，剩下的子任务都在别的线程上运行，可以放心休眠
+        if (!pool_.try_run_one()) {
+            pending_.wait(pending, std::memory_order_acquire);
+        }
+        pending = pending_.load(std::memory_order_acquire);
+    }
+}
+
+}    // namespace parallel
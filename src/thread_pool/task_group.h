@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+#include "thread_pool_fast.h"
+
+namespace parallel {
+
+/**
+ * @brief 一组子任务的“边等边干活”汇合点 (用于递归分治)
+ *
+ * **问题**: 任务在 worker 上提交子任务后调用 `future.get()`，这个 worker 就被阻塞。
+ * 递归分治 (快速排序、归并等) 的每一层都这样等，轻则核心闲置，重则所有 worker
+ * 都在等待排在自己队列里的子任务，整个线程池死锁。
+ *
+ * **做法**: `wait()` 不阻塞线程，而是不断地从本地队列弹出 / 从其他 worker 窃取任务来执行，
+ * 直到本组的子任务全部完成；只有确实无事可做时 (剩下的子任务都正在别的线程上运行) 才休眠。
+ * 因此固定大小的线程池 (哪怕只有 1 个线程) 也能安全地执行任意深度的递归。
+ *
+ * **用法**:
+ * ```
+ * TaskGroup group(pool);
+ * group.run([&] { sort(left); });
+ * sort(right);        // 当前线程处理另一半
+ * group.wait();       // 重新抛出子任务中的第一个异常
+ * ```
+ */
+class TaskGroup {
+   public:
+    explicit TaskGroup(ThreadPoolFast& pool) : pool_(pool) {}
+
+    // 析构时等待尚未完成的子任务 (未被 wait() 取走的异常会被丢弃)
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    /**
+     * @brief 把 f 作为本组的子任务提交到线程池
+     */
+    template <typename F>
+        requires std::invocable<std::decay_t<F>&>
+    void run(F&& f);
+
+    /**
+     * @brief 等待本组所有子任务完成，等待期间帮忙执行线程池中的任务
+     * @throws 子任务抛出的第一个异常
+     */
+    void wait();
+
+   private:
+    void finish_one(std::exception_ptr error) noexcept;
+
+    // 等待子任务归零，不处理异常
+    void join() noexcept;
+
+    ThreadPoolFast& pool_;
+    std::atomic<uint32_t> pending_{0};    // 尚未结束的子任务数量 (32 位，可直接 futex 等待)
+    std::atomic<bool> failed_{false};
+    std::exception_ptr error_;
+};
+
+template <typename F>
+    requires std::invocable<std::decay_t<F>&>
+void TaskGroup::run(F&& f) {
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    // 异常由 finish_one 收集，不需要 Future: 用 post 省掉每个子任务的共享状态
+    pool_.post([this, fn = std::decay_t<F>(std::forward<F>(f))]() mutable {
+        std::exception_ptr error;
+        try {
+            std::invoke(fn);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        finish_one(std::move(error));
+    });
+}
+
+}    // namespace parallel
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+#include "inline_task.h"
+
+namespace parallel {
+
+/**
+ * @brief post() 任务抛出的异常的去处 (每个线程池一个)
+ *
+ * post() 没有 Future 可以携带异常，只能交给线程池级别的处理函数。
+ * 没有设置处理函数时调用 std::terminate，与 std::thread 中未捕获的异常一致，
+ * 避免错误被悄悄吞掉。
+ *
+ * 只有抛异常时才会加锁读取处理函数，正常执行的任务不受影响。
+ */
+class ExceptionSink {
+   public:
+    using Handler = std::function<void(std::exception_ptr)>;
+
+    void set(Handler handler) {
+        std::lock_guard<std::mutex> lock(mtx_);
+        handler_ = std::move(handler);
+    }
+
+    // 在执行任务的线程上调用处理函数 (处理函数自身抛出的异常会导致 terminate)
+    void report(std::exception_ptr error) noexcept {
+        Handler handler;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            handler = handler_;
+        }
+        if (!handler) {
+            std::terminate();
+        }
+        handler(std::move(error));
+    }
+
+   private:
+    std::mutex mtx_;
+    Handler handler_;
+};
+
+namespace detail {
+
+// post() 的任务体: 直接调用，异常交给线程池的 ExceptionSink。没有共享状态
+template <typename Fn>
+struct PostedCall {
+    Fn fn;
+    ExceptionSink* errors;
+
+    void operator()() {
+        try {
+            std::invoke(fn);
+        } catch (...) {
+            errors->report(std::current_exception());
+        }
+    }
+};
+
+}    // namespace detail
+
+template <typename Fn>
+struct is_trivially_relocatable<detail::PostedCall<Fn>>
+    : std::bool_constant<is_trivially_relocatable_v<Fn>> {};
+
+}    // namespace parallel
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+namespace parallel {
+
+// 租户编号: 由 add_tenant 分配。0 是默认租户，不带租户的外部 submit / post 都算它的
+using TenantId = uint32_t;
+
+inline constexpr TenantId kDefaultTenant = 0;
+
+/**
+ * @brief 租户的调度参数
+ */
+struct TenantOptions {
+    // 权重: 多个租户同时积压时，各自分到的执行次数与权重成正比。0 按 1 处理
+    uint32_t weight = 1;
+
+    // 排队任务数上限，超出后 submit_as 失败、try_post_as 返回 false。
+    // 按提交时的队列长度检查，多个提交者并发时可能略微超出。0 按 1 处理
+    size_t max_queued = 1024;
+};
+
+/**
+ * @brief 租户的排队任务数已经达到上限: 任务没有入队，也不会执行
+ *
+ * submit_as 返回的 Future 收到这个异常。
+ */
+class TenantQueueFull : public std::runtime_error {
+   public:
+    TenantQueueFull() : std::runtime_error("tenant queue is full") {}
+};
+
+}    // namespace parallel
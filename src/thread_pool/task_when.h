@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <future>
+#include <limits>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "task_future.h"
+
+namespace parallel {
+
+/**
+ * @brief when_any 的结果: 最先完成的 Future 及其下标
+ *
+ * 其余任务照常执行，但结果被丢弃。输入为空时 index 为 npos，future 无效。
+ */
+template <typename T>
+struct WhenAnyResult {
+    static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+    size_t index = npos;
+    Future<T> future;
+};
+
+namespace detail {
+
+// 组合器的结果沿用第一个输入的执行器，后续的 then() 仍然回到原来的线程池
+template <typename T>
+Executor* first_executor(const std::vector<Future<T>>& futures) {
+    for (const auto& future : futures) {
+        if (future.executor() != nullptr) {
+            return future.executor();
+        }
+    }
+    return nullptr;
+}
+
+template <typename... Ts>
+Executor* first_executor(const Future<Ts>&... futures) {
+    Executor* executor = nullptr;
+    ((executor = executor != nullptr ? executor : futures.executor()), ...);
+    return executor;
+}
+
+template <typename... Ts>
+void check_futures(const Future<Ts>&... futures) {
+    if (!(futures.valid() && ...)) {
+        throw std::future_error(std::future_errc::no_state);
+    }
+}
+
+// when_all 的汇合点: 每个输入完成时把自己放回对应的槽位，最后一个完成的写入 Promise
+template <typename Results>
+struct WhenAllState {
+    Results results;
+    std::atomic<size_t> remaining;
+    Promise<Results> promise;
+
+    WhenAllState(Results r, size_t count)
+        : results(std::move(r)), remaining(count) {}
+
+    void arrive() {
+        if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            promise.set_value(std::move(results));
+        }
+    }
+};
+
+template <typename T>
+struct WhenAnyState {
+    std::atomic<bool> done{false};
+    Promise<WhenAnyResult<T>> promise;
+};
+
+}    // namespace detail
+
+/**
+ * @brief 所有输入完成后就绪，结果是已完成的 Future 列表 (顺序与输入一致)
+ *
+ * 输入的异常不会传播到结果上，而是留在各自的 Future 里，调用 get() 时再抛出。
+ * 汇合只是在各输入完成的线程上做一次原子减法，不占用任何等待线程。
+ */
+template <typename T>
+Future<std::vector<Future<T>>> when_all(std::vector<Future<T>> futures) {
+    using Results = std::vector<Future<T>>;
+
+    for (const auto& future : futures) {
+        detail::check_futures(future);
+    }
+    Executor* executor = detail::first_executor(futures);
+    size_t count = futures.size();
+
+    auto state = std::make_shared<detail::WhenAllState<Results>>(
+        Results(count), count + 1);
+    Future<Results> result =
+        state->promise.get_future().via(executor);
+
+    // 多出来的一个计数属于登记过程本身，防止还没登记完就提前完成
+    for (size_t i = 0; i < count; ++i) {
+        std::move(futures[i])
+            .via(nullptr)
+            .then([state, i](Future<T> done) {
+                state->results[i] = std::move(done);
+                state->arrive();
+            });
+    }
+    state->arrive();
+    return result;
+}
+
+template <typename... Ts>
+Future<std::tuple<Future<Ts>...>> when_all(Future<Ts>... futures) {
+    using Results = std::tuple<Future<Ts>...>;
+
+    detail::check_futures(futures...);
+    Executor* executor = detail::first_executor(futures...);
+
+    auto state = std::make_shared<detail::WhenAllState<Results>>(
+        Results{}, sizeof...(Ts) + 1);
+    Future<Results> result =
+        state->promise.get_future().via(executor);
+
+    [&]<size_t... I>(std::index_sequence<I...>) {
+        (std::move(futures)
+             .via(nullptr)
+             .then([state](Future<Ts> done) {
+                 std::get<I>(state->results) = std::move(done);
+                 state->arrive();
+             }),
+         ...);
+    }(std::index_sequence_for<Ts...>{});
+    state->arrive();
+    return result;
+}
+
+/**
+ * @brief 任意一个输入完成后就绪，结果是最先完成的 Future 及其下标
+ */
+template <typename T>
+Future<WhenAnyResult<T>> when_any(std::vector<Future<T>> futures) {
+    for (const auto& future : futures) {
+        detail::check_futures(future);
+    }
+    Executor* executor = detail::first_executor(futures);
+
+    auto state = std::make_shared<detail::WhenAnyState<T>>();
+    Future<WhenAnyResult<T>> result =
+        state->promise.get_future().via(executor);
+    if (futures.empty()) {
+        state->promise.set_value(WhenAnyResult<T>{});
+        return result;
+    }
+
+    for (size_t i = 0; i < futures.size(); ++i) {
+        std::move(futures[i])
+            .via(nullptr)
+            .then([state, i](Future<T> done) {
+                if (!state->done.exchange(true, std::memory_order_acq_rel)) {
+                    state->promise.set_value(
+                        WhenAnyResult<T>{i, std::move(done)});
+                }
+            });
+    }
+    return result;
+}
+
+}    // namespace parallel
@@ -3,13 +3,17 @@
 
 // 构造函数：初始化线程池
 // num_threads: 指定线程池中线程的数量
-ThreadPool::ThreadPool(size_t num_threads) : m_bStop(false) {
+ThreadPool::ThreadPool(size_t num_threads)
+    : m_bStop(false),
+      m_nLiveWorkers(num_threads),
+      m_vecCounters(num_threads),
+      m_vecLatency(num_threads) {
     // 循环创建指定数量的工作线程
     for (size_t i = 0; i < num_threads; ++i) {
         // emplace_back 直接在 vector 尾部构造线程对象，避免拷贝
         // 使用 lambda 表达式作为线程的执行函数
         // [this] 捕获当前对象的指针，以便在 lambda 中调用成员函数 WorkerThread
-        m_vecWorkers.emplace_back([this]() { this->WorkerThread(); });
+        m_vecWorkers.emplace_back([this, i]() { this->WorkerThread(i); });
     }
 }
 
@@ -39,11 +43,65 @@ ThreadPool::~ThreadPool() {
     }
 }
 
+void ThreadPool::PushTask(parallel::InlineTask task) {
+    {
+        // 加锁，保护任务队列
+        std::unique_lock lock(m_mutex);
+
+        // 如果线程池已经停止，则不允许提交新任务
+        if (m_bStop) {
+            throw std::runtime_error("AddTask is stop");
+        }
+
+        // 将任务移动到队列中
+        m_qTasks.push_back(std::move(task));
+    }
+    // 唤醒一个正在等待的工作线程来处理这个新任务
+    m_condition.notify_one();
+}
+
+void ThreadPool::schedule(parallel::InlineTask task) {
+    {
+        std::unique_lock lock(m_mutex);
+        // 回调不一定来自工作线程: 对已经就绪的 Future 调用 then() 时由调用者线程直接调度。
+        // 析构开始后工作线程仍会把队列取空再退出，这期间的回调照常入队执行；
+        // 最后一个工作线程退出之后就没有人来取了: 丢弃，
+        // task 在锁外析构，它持有的 Promise 会收到 broken_promise
+        if (m_bStop && m_nLiveWorkers == 0) {
+            return;
+        }
+        m_qTasks.push_back(std::move(task));
+    }
+    m_condition.notify_one();
+}
+
+parallel::PoolStats ThreadPool::GetStats() {
+    parallel::PoolStats stats;
+    for (const auto& counters : m_vecCounters) {
+        stats.workers.push_back(counters.snapshot());
+        stats.total += stats.workers.back();
+    }
+    std::unique_lock<std::mutex> lock(m_mutex);
+    stats.total.queue_depth = m_qTasks.size();
+    return stats;
+}
+
+parallel::PoolLatency ThreadPool::GetLatency() const {
+    parallel::PoolLatency latency;
+    for (const auto& recorder : m_vecLatency) {
+        latency.total.merge(recorder);
+    }
+    return latency;
+}
+
 // 工作线程函数：这是每个线程实际运行的代码
-void ThreadPool::WorkerThread() {
+void ThreadPool::WorkerThread(size_t index) {
+    parallel::WorkerCounters& counters = m_vecCounters[index];
+    parallel::detail::ScopedLatencySink latency_sink(&m_vecLatency[index]);
+
     // 线程会一直循环，直到被要求停止
     while (true) {
-        std::function<void()> task;
+        parallel::InlineTask task;
 
         {
             // 获取互斥锁，保护任务队列 m_qTasks
@@ -54,13 +112,19 @@ void ThreadPool::WorkerThread() {
             // 1. 收到停止信号 (m_bStop == true)
             // 2. 或者 任务队列不为空 (!m_qTasks.empty())
             // wait 会自动释放锁并阻塞线程，直到被 notify 唤醒且 lambda 返回 true
-            m_condition.wait(lock, [this] {
-                return this->m_bStop || !this->m_qTasks.empty();
-            });
+            // 只有真的需要等待时才计时，队列里有任务时不读时钟
+            if (!this->m_bStop && this->m_qTasks.empty()) {
+                auto wait_start = std::chrono::steady_clock::now();
+                m_condition.wait(lock, [this] {
+                    return this->m_bStop || !this->m_qTasks.empty();
+                });
+                counters.record_park(wait_start);
+            }
 
             // 如果收到了停止信号，并且任务队列已经空了
             // 说明所有任务都做完了，且不再接收新任务，线程可以结束了
             if (this->m_bStop && this->m_qTasks.empty()) {
+                --m_nLiveWorkers;
                 return;
             }
 
@@ -68,7 +132,7 @@ void ThreadPool::WorkerThread() {
             // std::move 将任务的所有权转移给局部变量 task
             task = std::move(this->m_qTasks.front());
             // 将任务从队列中移除
-            this->m_qTasks.pop();
+            this->m_qTasks.pop_front();
         }
         // 锁在这里（作用域结束）会自动释放
         // 这一点非常重要：执行任务的时候不需要持有锁！
@@ -76,5 +140,6 @@ void ThreadPool::WorkerThread() {
 
         // 执行任务
         task();
+        counters.executed.add();
     }
 }
@@ -1,34 +1,76 @@
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
-#include <functional>
-#include <future>
-#include <memory>
 #include <mutex>
-#include <queue>
 #include <stdexcept>
+#include <thread>
 #include <type_traits>
 #include <vector>
 
-class ThreadPool {
+#include "inline_task.h"
+#include "latency_histogram.h"
+#include "pool_stats.h"
+#include "ring_queue.h"
+#include "task_future.h"
+#include "task_post.h"
+#include "task_when.h"
+
+// 线程池本身是一个 Executor: AddTask 返回的 Future 调用 then() 时，回调回到本池执行
+class ThreadPool : public parallel::Executor {
    public:
     ThreadPool(size_t num_threads);
     ~ThreadPool();
 
     template <typename F, typename... Args>
     auto AddTask(F&& f, Args&&... args)
-        -> std::future<typename std::invoke_result<F, Args...>::type>;
+        -> parallel::Future<typename std::invoke_result<F, Args...>::type>;
+
+    // 提交一个不需要结果的任务: 不创建 Future，没有共享状态。
+    // 任务抛出的异常交给 SetExceptionHandler 设置的处理函数，没有设置时 std::terminate
+    template <typename F, typename... Args>
+    void Post(F&& f, Args&&... args);
+
+    void SetExceptionHandler(parallel::ExceptionSink::Handler handler) {
+        m_errors.set(std::move(handler));
+    }
+
+    // Executor 接口: then() 回调由完成任务的工作线程放回队列
+    void schedule(parallel::InlineTask task) override;
+
+    // 统计快照: 每个线程执行的任务数、在条件变量上等待的次数和时长。
+    // 只有一个共享队列，队列深度记在 total.queue_depth 上
+    parallel::PoolStats GetStats();
+
+    // 开启/关闭任务延迟统计 (默认关闭)，只影响之后提交的任务
+    void SetLatencyTracking(bool enabled) {
+        m_bLatencyTracking.store(enabled, std::memory_order_relaxed);
+    }
+
+    // 合并所有线程的排队时间/执行时间直方图
+    parallel::PoolLatency GetLatency() const;
 
    private:
-    // 工作线程需要运行的函数
-    void WorkerThread();
+    // 工作线程需要运行的函数，index 用于定位自己的统计计数
+    void WorkerThread(size_t index);
+
+    // 开启延迟统计时返回当前时刻，否则返回 0
+    uint64_t SubmitStamp() const {
+        return m_bLatencyTracking.load(std::memory_order_relaxed)
+                   ? parallel::latency_now()
+                   : 0;
+    }
+
+    // 任务入队并唤醒一个工作线程；线程池已停止时抛出 std::runtime_error
+    void PushTask(parallel::InlineTask task);
 
    private:
     // 线程池中的工作线程
     std::vector<std::thread> m_vecWorkers;
 
-    // 任务队列
-    std::queue<std::function<void()>> m_qTasks;
+    // 任务队列 (只可移动的 InlineTask，不再需要 shared_ptr 包一层)
+    // RingQueue 扩容后一直复用，稳态下入队出队都不分配内存
+    parallel::RingQueue<parallel::InlineTask> m_qTasks;
 
     // 同步原语
     std::mutex m_mutex;
@@ -36,6 +78,20 @@ class ThreadPool {
 
     // 停止标志
     bool m_bStop;
+
+    // 还没有退出的工作线程数 (受 m_mutex 保护)。停止之后只要还有工作线程在，
+    // 队列就会被取空，schedule 进来的回调照样执行
+    size_t m_nLiveWorkers;
+
+    // 每个工作线程私有的统计计数 (独占缓存行)
+    std::vector<parallel::WorkerCounters> m_vecCounters;
+
+    // 每个工作线程私有的延迟直方图
+    std::vector<parallel::LatencyRecorder> m_vecLatency;
+    std::atomic<bool> m_bLatencyTracking{false};
+
+    // Post 任务的异常处理
+    parallel::ExceptionSink m_errors;
 };
 
 // 模板函数 AddTask：向线程池提交一个新的任务
@@ -43,37 +99,32 @@ class ThreadPool {
 // Args: 任务函数参数的类型
 template <typename F, typename... Args>
 auto ThreadPool::AddTask(F&& f, Args&&... args)
-    -> std::future<typename std::invoke_result<F, Args...>::type> {
-    // 推导任务函数的返回值类型
-    using return_type = typename std::invoke_result<F, Args...>::type;
-
-    // 创建一个 packaged_task，它可以包装函数和参数，并允许我们获取返回值（通过 future）
-    // std::bind 将函数 f 和参数 args 绑定在一起，形成一个可调用的对象
+    -> parallel::Future<typename std::invoke_result<F, Args...>::type> {
+    // 把函数和参数打包成一个只可移动的任务，并取得与之关联的 Future
     // std::forward 完美转发，保持参数的左值/右值属性
-    // 使用 make_shared 是因为 std::function 要求对象是可复制的，
-    // 而 packaged_task 是不可复制的（只能移动），所以用 shared_ptr 包装一下
-    auto task = std::make_shared<std::packaged_task<return_type()>>(
-        std::bind(std::forward<F>(f), std::forward<Args>(args)...));
-
-    // 获取与 packaged_task 关联的 future，用于在将来获取任务执行的结果
-    std::future<return_type> res = task->get_future();
-    {
-        // 加锁，保护任务队列
-        std::unique_lock lock(m_mutex);
-
-        // 如果线程池已经停止，则不允许提交新任务
-        if (m_bStop) {
-            throw std::runtime_error("AddTask is stop");
-        }
-
-        // 将任务添加到队列中
-        // 这里 lambda 捕获了 task 智能指针（复制了一份指针），
-        // 当 lambda 被执行时，会调用 (*task)()，即执行 packaged_task
-        m_qTasks.emplace([task]() { (*task)(); });
-    }
-    // 唤醒一个正在等待的工作线程来处理这个新任务
-    m_condition.notify_one();
+    // InlineTask 本身只可移动，所以不再需要像 std::function 那样用 shared_ptr 包装
+    // 开启延迟统计时任务还会带上提交时刻
+    auto [task, res] = parallel::package_timed_task(
+        SubmitStamp(), std::forward<F>(f), std::forward<Args>(args)...);
+
+    // 加锁入队，如果线程池已经停止则抛出异常
+    PushTask(std::move(task));
+
+    // 返回 future 给调用者 (记住本池，then() 的回调会回到这里)
+    return std::move(res).via(this);
+}
+
+// 模板函数 Post：提交一个不需要结果的任务
+// 直接把可调用对象放进队列，不经过 Promise/Future
+template <typename F, typename... Args>
+void ThreadPool::Post(F&& f, Args&&... args) {
+    using Fn = decltype(parallel::detail::bind_call(
+        std::forward<F>(f), std::forward<Args>(args)...));
 
-    // 返回 future 给调用者
-    return res;
+    PushTask(parallel::detail::make_timed_task(
+        parallel::detail::PostedCall<Fn>{
+            parallel::detail::bind_call(std::forward<F>(f),
+                                        std::forward<Args>(args)...),
+            &m_errors},
+        SubmitStamp()));
 }
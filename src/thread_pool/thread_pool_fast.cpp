@@ -1,58 +1,621 @@
 #include "thread_pool_fast.h"
 
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+thread_local ThreadPoolFast::WorkerIdentity ThreadPoolFast::tls_worker_;
+thread_local parallel::ProducerCursorCache ThreadPoolFast::tls_cursors_;
+
 // 构造函数
-ThreadPoolFast::ThreadPoolFast(size_t num_threads) {
-    // 1. 初始化所有队列
-    // 为每个线程创建一个独立的 WorkQueue
-    for (size_t i = 0; i < num_threads; ++i) {
-        queues_.push_back(std::make_unique<WorkQueue>());
-    }
+ThreadPoolFast::ThreadPoolFast(size_t num_threads, bool pin_workers,
+                               size_t max_threads)
+    : queues_(std::max({num_threads,
+                        max_threads ? max_threads
+                                    : std::thread::hardware_concurrency(),
+                        size_t{1}})),
+      threads_(queues_.size()),
+      states_(queues_.size()),
+      worker_cpus_(queues_.size()),
+      counters_(queues_.size()),
+      latency_(queues_.size()),
+      timers_(1,
+              [this](uint32_t, std::vector<Job>& due) {
+                  enqueue_bulk(due.size(),
+                               [&](size_t i) -> Job&& {
+                                   return std::move(due[i]);
+                               });
+              }),
+      tenant_counters_(queues_.size()) {
+    // 默认租户: 队列就是注入队列，不设上限 (写满时 submit / post 退回到 inbox)
+    tenants_[parallel::kDefaultTenant] = std::make_unique<Tenant>(
+        kInjectionCapacity, std::numeric_limits<size_t>::max());
 
-    // 2. 启动工作线程
-    // 将线程索引 (index) 传递给线程，让它知道哪个队列属于自己
-    for (size_t i = 0; i < num_threads; ++i) {
-        threads_.emplace_back([this, i] { worker_thread(i); });
+    num_threads = std::clamp<size_t>(num_threads, 1, capacity());
+
+    // 1. 分配 CPU 并计算窃取顺序 (按容量计算，resize 之后不需要重算)
+    // 按紧凑顺序分配: 相邻编号的 worker 尽量是 SMT 兄弟 / 共享 L3
+    if (pin_workers) {
+        std::vector<parallel::CpuInfo> cpus =
+            parallel::CpuTopology::system().compact_order();
+        if (!cpus.empty()) {
+            for (size_t i = 0; i < capacity(); ++i) {
+                worker_cpus_[i] = cpus[i % cpus.size()];
+            }
+        }
     }
+    steal_order_ = parallel::build_steal_order(worker_cpus_);
+
+    // 2. 启动工作线程，等所有 worker 创建好自己的队列之后才允许提交任务
+    resize(num_threads);
 }
 
 // 析构函数
 ThreadPoolFast::~ThreadPoolFast() {
+    // 0. 先停掉监控线程和定时器线程，之后不会再有 resize，也不会再有到期的任务入队
+    scaler_.reset();
+    timers_.shutdown();
+
     // 1. 发送停止信号
     // memory_order_release 保证在此之前的所有内存写入对其他线程可见
     stop_.store(true, std::memory_order_release);
 
     // 2. 唤醒所有可能在休眠的线程，让它们检查 stop 标志并退出
-    global_cv_.notify_all();
+    parker_.notify_all();
 
-    // 3. 等待所有线程结束
+    // 3. 等待所有线程结束 (包括已退役、尚未回收的线程)
     for (auto& thread : threads_) {
         if (thread.joinable()) {
             thread.join();
         }
     }
+
+    // 4. 尚未执行的任务在这里析构，对应的 Future 会收到 broken_promise。
+    // 在其他成员还有效时清空: 被丢弃的 Promise 可能触发 then() 回调调用 schedule
+    for (size_t t = 0; t < tenant_count_.load(std::memory_order_acquire);
+         ++t) {
+        while (tenants_[t]->queue.try_pop()) {
+        }
+    }
+    queues_.clear();
+}
+
+void ThreadPoolFast::resize(size_t num_threads) {
+    std::lock_guard<std::mutex> lock(resize_mtx_);
+    num_threads = std::clamp<size_t>(num_threads, 1, capacity());
+    size_t active = active_.load(std::memory_order_relaxed);
+
+    if (num_threads > active) {
+        // 扩容: 还没来得及退出的 worker 直接撤销退役，其余槽位启动新线程
+        std::vector<size_t> slots;
+        for (size_t i = active; i < num_threads; ++i) {
+            WorkerState expected = WorkerState::Retiring;
+            if (!states_[i].compare_exchange_strong(expected,
+                                                    WorkerState::Running)) {
+                slots.push_back(i);
+            }
+        }
+        start_workers(slots);
+        active_.store(num_threads, std::memory_order_release);
+    } else if (num_threads < active) {
+        // 缩容: 先缩小可见范围，新提交不再进入这些队列；
+        // 再通知 worker 退役 (正在休眠的需要叫醒)。不等它们退出
+        active_.store(num_threads, std::memory_order_release);
+        for (size_t i = num_threads; i < active; ++i) {
+            states_[i].store(WorkerState::Retiring, std::memory_order_release);
+        }
+        parker_.notify_all();
+    }
+}
+
+void ThreadPoolFast::start_workers(const std::vector<size_t>& slots) {
+    if (slots.empty()) {
+        return;
+    }
+    std::latch ready(static_cast<std::ptrdiff_t>(slots.size()));
+    for (size_t i : slots) {
+        // 回收这个槽位上已经退出 (或马上退出) 的旧线程
+        if (threads_[i].joinable()) {
+            threads_[i].join();
+        }
+        states_[i].store(WorkerState::Running, std::memory_order_relaxed);
+        // 将线程索引 (index) 传递给线程，让它知道哪个队列属于自己
+        threads_[i] =
+            std::thread([this, i, &ready] { worker_thread(i, &ready); });
+    }
+    ready.wait();
+}
+
+void ThreadPoolFast::enable_auto_resize(parallel::ElasticPolicy policy) {
+    if (policy.max_threads == 0 || policy.max_threads > capacity()) {
+        policy.max_threads = capacity();
+    }
+    policy.min_threads = std::clamp<size_t>(policy.min_threads, 1,
+                                            policy.max_threads);
+
+    scaler_.reset();
+    scaler_ = std::make_unique<parallel::AutoScaler>(
+        policy, [this] { return sample_load(); },
+        [this](size_t n) { resize(n); });
+}
+
+void ThreadPoolFast::disable_auto_resize() {
+    scaler_.reset();
+}
+
+parallel::PoolStats ThreadPoolFast::stats() {
+    parallel::PoolStats stats;
+    stats.workers.resize(capacity());
+    size_t active = active_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < capacity(); ++i) {
+        parallel::WorkerStats& worker = stats.workers[i];
+        worker = counters_[i].snapshot();
+        if (i < active) {
+            WorkQueue& queue = *queues_[i];
+            worker.queue_depth = queue.tasks.size();
+            std::lock_guard<std::mutex> lock(queue.mtx);
+            worker.queue_depth += queue.inbox.size();
+        }
+        stats.total += worker;
+    }
+    size_t tenant_count = tenant_count_.load(std::memory_order_acquire);
+    for (size_t t = 0; t < tenant_count; ++t) {
+        stats.total.queue_depth += tenants_[t]->queue.size();
+    }
+    stats.total.executed +=
+        external_executed_.load(std::memory_order_relaxed);
+
+    // 注册过租户之后才统计按租户的使用量
+    if (tenant_count > 1) {
+        stats.tenants.resize(tenant_count);
+        for (size_t t = 0; t < tenant_count; ++t) {
+            const Tenant& tenant = *tenants_[t];
+            parallel::TenantStats& usage = stats.tenants[t];
+            usage.weight = tenant.weight.load(std::memory_order_relaxed);
+            usage.queued = tenant.queue.size();
+            usage.rejected = tenant.rejected.load(std::memory_order_relaxed);
+            usage.executed =
+                tenant.external_executed.load(std::memory_order_relaxed);
+            usage.busy_ns =
+                tenant.external_busy_ns.load(std::memory_order_relaxed);
+            for (const TenantSlots& slots : tenant_counters_) {
+                usage.executed += slots.tenants[t].executed.load();
+                usage.busy_ns += slots.tenants[t].busy_ns.load();
+            }
+        }
+    }
+    return stats;
+}
+
+parallel::PoolLatency ThreadPoolFast::latency() const {
+    parallel::PoolLatency latency;
+    for (const auto& recorder : latency_) {
+        latency.total.merge(recorder);
+    }
+    return latency;
+}
+
+parallel::LoadSample ThreadPoolFast::sample_load() {
+    parallel::LoadSample load;
+    load.workers = active_.load(std::memory_order_acquire);
+    load.idle = parker_.idle();
+    for (size_t t = 0; t < tenant_count_.load(std::memory_order_acquire);
+         ++t) {
+        load.backlog += tenants_[t]->queue.size();
+    }
+    for (size_t i = 0; i < load.workers; ++i) {
+        WorkQueue& queue = *queues_[i];
+        load.backlog += queue.tasks.size();
+        std::lock_guard<std::mutex> lock(queue.mtx);
+        load.backlog += queue.inbox.size();
+    }
+    return load;
+}
+
+parallel::TenantId ThreadPoolFast::add_tenant(
+    parallel::TenantOptions options) {
+    std::lock_guard<std::mutex> lock(tenant_mtx_);
+    size_t id = tenant_count_.load(std::memory_order_relaxed);
+    if (id == kMaxTenants) {
+        throw std::length_error("ThreadPoolFast: too many tenants");
+    }
+    size_t limit = std::max<size_t>(options.max_queued, 1);
+    tenants_[id] = std::make_unique<Tenant>(limit, limit);
+    // 新租户从当前的虚拟时间开始，与正在积压的租户公平竞争
+    tenants_[id]->pass.store(vtime_.load(std::memory_order_relaxed),
+                             std::memory_order_relaxed);
+    tenant_count_.store(id + 1, std::memory_order_release);
+    set_tenant_weight(static_cast<parallel::TenantId>(id), options.weight);
+    return static_cast<parallel::TenantId>(id);
+}
+
+void ThreadPoolFast::set_tenant_weight(parallel::TenantId tenant,
+                                       uint32_t weight) {
+    if (tenant >= tenant_count_.load(std::memory_order_acquire)) {
+        return;
+    }
+    weight = std::max<uint32_t>(weight, 1);
+    tenants_[tenant]->weight.store(weight, std::memory_order_relaxed);
+    tenants_[tenant]->stride.store(kStrideScale / weight,
+                                   std::memory_order_relaxed);
+}
+
+ThreadPoolFast::Job ThreadPoolFast::pop_injected(size_t& tenant) {
+    tenant = kUntracked;
+    size_t count = tenant_count_.load(std::memory_order_acquire);
+    if (count == 1) {
+        if (auto job = injection().try_pop()) {
+            return std::move(*job);
+        }
+        return Job();
+    }
+
+    // 步长调度: 选虚拟时间最小的非空租户。落后于全局虚拟时间的租户 (刚刚从空闲变为积压)
+    // 按全局虚拟时间计算，不能把空闲期间“省下”的份额一次性用掉
+    uint64_t floor = vtime_.load(std::memory_order_relaxed);
+    // 取不出任务的租户: 刚被别的 worker 取空，或者生产者占住槽位后还没写完。
+    // 它的 pass 不变，下一次还会被选中，所以本轮把它排除，在剩下的租户里重新选
+    uint64_t skipped = 0;
+    for (;;) {
+        size_t best = count;
+        uint64_t best_pass = 0;
+        for (size_t t = 0; t < count; ++t) {
+            Tenant& candidate = *tenants_[t];
+            if ((skipped >> t & 1) != 0 || candidate.queue.empty()) {
+                continue;
+            }
+            uint64_t pass = std::max(
+                candidate.pass.load(std::memory_order_relaxed), floor);
+            if (best == count || pass < best_pass) {
+                best = t;
+                best_pass = pass;
+            }
+        }
+        if (best == count) {
+            return Job();
+        }
+
+        Tenant& chosen = *tenants_[best];
+        auto job = chosen.queue.try_pop();
+        if (!job) {
+            skipped |= uint64_t{1} << best;
+            continue;
+        }
+
+        // 记账: 并发取同一个租户的 worker 各推进一次，用 CAS 保证一次也不丢
+        uint64_t stride = chosen.stride.load(std::memory_order_relaxed);
+        uint64_t pass = chosen.pass.load(std::memory_order_relaxed);
+        while (!chosen.pass.compare_exchange_weak(
+            pass, std::max(pass, floor) + stride, std::memory_order_relaxed)) {
+        }
+        // 全局虚拟时间只是近似值，并发时偶尔回退一点也没关系，不值得再加一个 CAS 循环
+        if (best_pass > floor) {
+            vtime_.store(best_pass, std::memory_order_relaxed);
+        }
+        tenant = best;
+        return std::move(*job);
+    }
+}
+
+void ThreadPoolFast::record_tenant(size_t tenant, uint64_t busy_ns) {
+    if (tls_worker_.pool == this) {
+        TenantCounters& slot =
+            tenant_counters_[tls_worker_.index].tenants[tenant];
+        slot.executed.add();
+        slot.busy_ns.add(busy_ns);
+    } else {
+        tenants_[tenant]->external_executed.fetch_add(
+            1, std::memory_order_relaxed);
+        tenants_[tenant]->external_busy_ns.fetch_add(
+            busy_ns, std::memory_order_relaxed);
+    }
+}
+
+void ThreadPoolFast::set_idle_policy(parallel::IdlePolicy policy) {
+    idle_strategy_.store(policy.strategy, std::memory_order_relaxed);
+    spin_rounds_.store(policy.spin_rounds, std::memory_order_relaxed);
+    // 已经休眠的 worker 醒来重新扫描一遍，再按新策略等待
+    parker_.notify_all();
+}
+
+void ThreadPoolFast::schedule(parallel::InlineTask task) {
+    // 析构过程中完成 (或被丢弃) 的任务不再调度回调，回调持有的 Promise 会收到 broken_promise
+    if (stop_.load(std::memory_order_acquire)) {
+        return;
+    }
+    enqueue(std::move(task));
+    parker_.notify();
+}
+
+void ThreadPoolFast::enqueue(Job job) {
+    // 情况 1: 在本池的 worker 线程里提交 (例如递归 fork-join 产生的子任务)
+    // 直接压入自己的 deque: 无锁，而且子任务大概率就在这个核心上执行，
+    // 父任务刚刚写过的数据还热在缓存里。其他 worker 空闲时会来窃取。
+    if (tls_worker_.pool == this) {
+        queues_[tls_worker_.index]->tasks.push(std::move(job));
+        return;
+    }
+
+    // 情况 2: 外部线程提交
+    // 进入全局注入队列: 提交者之间只争抢一次 CAS，不碰 worker 的 inbox 锁。
+    // 注入队列写满时 (背压) 退回到 inbox，submit / post 不会因此失败
+    push_injected(std::move(job));
+}
+
+void ThreadPoolFast::push_external(Job job) {
+    size_t num_queues = active_.load(std::memory_order_acquire);
+    for (size_t index = next_external_queue();;
+         index = (index + 1) % num_queues) {
+        // **细粒度锁**: 只锁定目标队列的 inbox，而不是全局锁
+        // 这样其他线程可以并发地向其他队列提交任务。
+        // 提交者不是该 deque 的 owner，不能直接 push，只能放进 inbox。
+        std::lock_guard<std::mutex> lock(queues_[index]->mtx);
+        // 刚刚退役的队列不再接收任务，换下一个 (0 号 worker 永不退役)
+        if (!queues_[index]->retired) {
+            queues_[index]->inbox.push_back(std::move(job));
+            return;
+        }
+    }
+}
+
+size_t ThreadPoolFast::next_external_queue() {
+    // **负载均衡策略**: 每个提交者私有的轮询 (Round-Robin) 游标。
+    // 游标是 thread_local 的，提交时没有任何共享写入；
+    // 只有某个线程第一次向本池提交 (或者本池的游标被挤出缓存) 时，
+    // 才从 producer_seed_ 领取一个起点。
+    size_t& next = tls_cursors_.get(this, producer_seed_);
+    return next++ % active_.load(std::memory_order_acquire);
+}
+
+bool ThreadPoolFast::try_run_one() {
+    Job job;
+    size_t tenant = kUntracked;
+    if (tls_worker_.pool == this) {
+        thread_local std::vector<Job> batch;
+        job = pop_local(tls_worker_.index, batch);
+        if (!job) {
+            job = pop_injected(tenant);
+        }
+        if (!job) {
+            job = steal(tls_worker_.index);
+        }
+    } else {
+        // 外部线程没有自己的队列: 先取注入队列，再窃取
+        job = pop_injected(tenant);
+        if (!job) {
+            job = steal(capacity());
+        }
+    }
+
+    if (!job) {
+        return false;
+    }
+    uint64_t started = tenant != kUntracked ? parallel::latency_now() : 0;
+    {
+        // 外部线程 (或其他线程池的 worker) 帮忙执行的任务不计入本池的延迟
+        parallel::detail::ScopedLatencySink sink(
+            tls_worker_.pool == this ? &latency_[tls_worker_.index] : nullptr);
+        // 嵌套执行: 只回收这个任务自己分配的部分，外层任务的数据不受影响
+        parallel::ArenaScope arena_scope;
+        job();
+    }
+    if (tenant != kUntracked) {
+        record_tenant(tenant, parallel::latency_now() - started);
+    }
+    if (tls_worker_.pool == this) {
+        counters_[tls_worker_.index].executed.add();
+    } else {
+        external_executed_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+bool ThreadPoolFast::has_idle_workers() const {
+    if (tls_worker_.pool == this) {
+        return queues_[tls_worker_.index]->tasks.empty();
+    }
+    return parker_.idle() > 0;
+}
+
+bool ThreadPoolFast::has_pending_work() {
+    // 提交者在入队之后才检查休眠者，与 prepare_park 之间的 seq_cst 栅栏保证这里能看到
+    // 已经推进的 enqueue_pos_ (数据可能还在写入途中，返回 true 后重新扫描即可)
+    for (size_t t = 0; t < tenant_count_.load(std::memory_order_acquire);
+         ++t) {
+        if (!tenants_[t]->queue.empty()) {
+            return true;
+        }
+    }
+    size_t active = active_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < active; ++i) {
+        WorkQueue* queue = queues_[i].get();
+        if (!queue->tasks.empty()) {
+            return true;
+        }
+        // 这里必须用 lock() 而不是 try_lock(): try_lock 失败说明有提交者正在写 inbox，
+        // 如果把它当成“没有任务”而去休眠，就可能错过这个提交者的唤醒判断。
+        std::lock_guard<std::mutex> lock(queue->mtx);
+        if (!queue->inbox.empty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+ThreadPoolFast::Job ThreadPoolFast::pop_local(size_t index,
+                                              std::vector<Job>& batch) {
+    WorkQueue& queue = *queues_[index];
+
+    // 快路径: 无锁地从本地 deque 底部弹出
+    if (auto job = queue.tasks.pop()) {
+        return std::move(*job);
+    }
+
+    // 慢路径: 本地 deque 空了，把 inbox 整批“转运”过来。
+    // swap 之后 inbox 拿到的是 batch 的旧缓冲区，两个 vector 来回复用，不会反复分配。
+    {
+        std::lock_guard<std::mutex> lock(queue.mtx);
+        if (queue.inbox.empty()) {
+            return Job();
+        }
+        batch.swap(queue.inbox);
+    }
+
+    // inbox 是按提交顺序 (FIFO) 排列的: 最旧的任务直接返回执行，
+    // 其余逆序压入 deque，这样 owner 的 LIFO pop 依然按提交顺序执行，
+    // 而 thief 从顶部偷到的是最新提交的任务。
+    Job first = std::move(batch.front());
+    for (size_t i = batch.size(); i-- > 1;) {
+        queue.tasks.push(std::move(batch[i]));
+    }
+    batch.clear();
+    return first;
+}
+
+ThreadPoolFast::Job ThreadPoolFast::steal(size_t index) {
+    // 外部线程没有自己的 deque 可以存放多偷的任务，只偷一个
+    bool is_worker = index < capacity();
+    size_t limit = is_worker ? steal_batch() : 1;
+
+    // 分层顺序: SMT 兄弟 → 同一 L3 → 同一 NUMA 节点 → 远端 (列表中不含自己)
+    // 顺序按容量计算，跳过当前未启用的槽位
+    size_t active = active_.load(std::memory_order_acquire);
+    for (size_t i : steal_order_[index]) {
+        if (i >= active)
+            continue;
+        WorkQueue& victim = *queues_[i];
+
+        // 1. 无锁窃取: CAS 推进受害者 deque 的 top
+        if (auto job = victim.tasks.steal()) {
+            // Steal-Half: 受害者还积压着任务时，继续偷到一半 (每次都是独立的 CAS)，
+            // 放进自己的 deque。之后的任务从本地取，其他 thief 也可以再从我们这里偷。
+            // Chase-Lev 不能用一次 CAS 推进多个位置 (会与 owner 的无 CAS pop 冲突)，
+            // 所以这里是多次单个窃取，但只在确认有大量积压时才做。
+            size_t extra = std::min(limit, victim.tasks.size() / 2 + 1) - 1;
+            size_t moved = 0;
+            for (; moved < extra; ++moved) {
+                auto more = victim.tasks.steal();
+                if (!more)
+                    break;
+                queues_[index]->tasks.push(std::move(*more));
+            }
+            if (moved > 0) {
+                parker_.notify();    // 我们这里也有富余了，叫醒一个休眠者来偷
+            }
+            if (is_worker) {
+                counters_[index].steals.add();
+                counters_[index].stolen.add(1 + moved);
+            }
+            return std::move(*job);
+        }
+
+        // 2. 受害者还没来得及转运的 inbox 也可以偷
+        // **关键点**: 使用 try_lock() 而不是 lock()
+        // 如果目标 inbox 正在被使用（忙），我们不想在这里死等，不如去试下一个。
+        if (victim.mtx.try_lock()) {
+            // 成功获取锁，使用 adopt_lock 告诉 lock_guard 锁已经被锁住了
+            std::lock_guard<std::mutex> lock(victim.mtx, std::adopt_lock);
+            if (!victim.inbox.empty()) {
+                // 一次加锁搬走 inbox 尾部的一半 (最新提交的任务)，从尾部取是 O(1)
+                size_t take = std::min(limit, (victim.inbox.size() + 1) / 2);
+                for (size_t k = 1; k < take; ++k) {
+                    queues_[index]->tasks.push(std::move(victim.inbox.back()));
+                    victim.inbox.pop_back();
+                }
+                Job job = std::move(victim.inbox.back());
+                victim.inbox.pop_back();
+                if (take > 1) {
+                    parker_.notify();
+                }
+                if (is_worker) {
+                    counters_[index].steals.add();
+                    counters_[index].stolen.add(take);
+                }
+                return job;
+            }
+        } else if (is_worker) {
+            counters_[index].lock_misses.add();
+        }
+    }
+    if (is_worker) {
+        counters_[index].steal_failures.add();
+    }
+    return Job();
 }
 
 // 工作线程函数：这是每个线程实际运行的代码
-void ThreadPoolFast::worker_thread(size_t index) {
+void ThreadPoolFast::worker_thread(size_t index, std::latch* ready) {
+    // 记录线程身份，之后本线程内的 submit 会直接进入自己的 deque
+    tls_worker_ = {this, index};
+
+    // 先绑核，再分配自己的队列: Linux 的 first-touch 策略会把队列内存
+    // (deque 的环形缓冲区等) 放在当前 CPU 所在的 NUMA 节点上
+    if (worker_cpus_[index].cpu >= 0) {
+        parallel::pin_current_thread(worker_cpus_[index].cpu);
+    }
+    // 槽位之前用过时复用原来的队列 (它已经是空的)，重新开始接收任务
+    if (!queues_[index]) {
+        queues_[index] = std::make_unique<WorkQueue>();
+    } else {
+        std::lock_guard<std::mutex> lock(queues_[index]->mtx);
+        queues_[index]->retired = false;
+    }
+    ready->count_down();
+
+    // 本线程执行的任务都记入自己的延迟直方图
+    parallel::detail::ScopedLatencySink latency_sink(&latency_[index]);
+
+    // 任务的临时内存: 线程私有，每个任务结束后退回原位
+    parallel::WorkerArena arena;
+    parallel::detail::ScopedWorkerArena arena_sink(&arena);
+
+    // inbox 转运用的缓冲区，在整个线程生命周期内复用
+    std::vector<Job> batch;
+
+    // 空闲时的自旋/让出/休眠退避
+    parallel::IdleBackoff backoff(parker_);
+
+    // 距离上次强制检查注入队列执行过的任务数
+    uint32_t since_injection_poll = 0;
+
     // 只要没有收到停止信号，就一直循环
     // memory_order_acquire 保证能读取到最新的 stop_ 值
     while (!stop_.load(std::memory_order_acquire)) {
-        std::function<void()> task;
-        bool found_task = false;
+        // 被 resize 退役: 如果在这之前又被扩容撤销了，就继续工作
+        if (states_[index].load(std::memory_order_acquire) !=
+            WorkerState::Running) {
+            WorkerState expected = WorkerState::Retiring;
+            if (states_[index].compare_exchange_strong(expected,
+                                                       WorkerState::Draining)) {
+                drain_worker(index);
+                states_[index].store(WorkerState::Stopped,
+                                     std::memory_order_release);
+                return;
+            }
+            continue;
+        }
 
         // =================================================================
         // 阶段 1: 尝试从自己的本地队列获取任务
         // =================================================================
         // 优势:
         // 1. 数据局部性最好 (L1 Cache 命中率高)。
-        // 2. 锁竞争最小 (通常只有自己访问，除非被窃取)。
-        {
-            std::lock_guard<std::mutex> lock(queues_[index]->mtx);
-            if (!queues_[index]->tasks.empty()) {
-                task = std::move(queues_[index]->tasks.front());
-                queues_[index]->tasks.pop_front();
-                found_task = true;
-            }
+        // 2. 无锁: 只有 inbox 为空需要转运时才加一次锁。
+        // 公平性: 每执行 kInjectionPollInterval 个任务先看一眼注入队列，
+        // 否则一个不断派生本地子任务的 worker 会让外部提交的任务一直排队
+        Job job;
+        size_t tenant = kUntracked;    // 任务来自哪个租户的队列 (用于按租户统计)
+        if (++since_injection_poll >= kInjectionPollInterval) {
+            since_injection_poll = 0;
+            job = pop_injected(tenant);
+        }
+        if (!job) {
+            job = pop_local(index, batch);
+        }
+
+        // 本地没有任务: 取外部线程提交到注入队列 (和各租户队列) 的任务
+        if (!job) {
+            job = pop_injected(tenant);
         }
 
         // =================================================================
@@ -60,59 +623,78 @@ void ThreadPoolFast::worker_thread(size_t index) {
         // =================================================================
         // 如果本地队列为空，说明当前线程空闲。
         // 为了负载均衡，尝试从其他忙碌线程的队列中“偷”一个任务来做。
-        if (!found_task) {
-            for (size_t i = 0; i < queues_.size(); ++i) {
-                if (i == index)
-                    continue;    // 跳过自己
-
-                // 尝试锁定目标队列
-                // **关键点**: 使用 try_lock() 而不是 lock()
-                // 为什么要这样做?
-                // 1. 避免阻塞: 如果目标队列正在被使用（忙），我们不想在这里死等，不如去试下一个。
-                // 2. 防止死锁: 简单的遍历加锁容易导致死锁，try_lock 是安全的。
-                if (queues_[i]->mtx.try_lock()) {
-                    // 成功获取锁，使用 adopt_lock 告诉 lock_guard 锁已经被锁住了
-                    std::lock_guard<std::mutex> lock(queues_[i]->mtx,
-                                                     std::adopt_lock);
-
-                    if (!queues_[i]->tasks.empty()) {
-                        // 偷取任务！
-                        // 通常 Work Stealing 会从队列尾部 (back)
-                        // 偷，以减少与 owner (从 front 取) 的冲突。
-                        // 这里为了简化代码使用了 deque 的 front，但原理一致。
-                        task = std::move(queues_[i]->tasks.front());
-                        queues_[i]->tasks.pop_front();
-                        found_task = true;
-                        // std::cout << "Thread " << index << " stole task from "
-                        // << i << "\n";
-                    }
-                }
-
-                // 如果偷到了，就停止遍历，赶紧去干活
-                if (found_task)
-                    break;
-            }
+        if (!job) {
+            job = steal(index);
         }
 
         // =================================================================
         // 阶段 3: 执行任务 或 休眠等待
         // =================================================================
-        if (found_task) {
+        if (job) {
             // 执行任务
             // 注意: 执行任务时不需要持有任何锁，允许其他线程并发操作队列
-            task();
+            backoff.reset();
+            uint64_t started =
+                tenant != kUntracked ? parallel::latency_now() : 0;
+            {
+                parallel::ArenaScope arena_scope(&arena);
+                job();
+            }
+            counters_[index].executed.add();
+            if (tenant != kUntracked) {
+                record_tenant(tenant, parallel::latency_now() - started);
+            }
         } else {
+            // 按空闲策略先自旋 / 让出一会儿，回到循环开头重新扫描
+            if (backoff.next(idle_policy()) ==
+                parallel::IdleBackoff::Action::Retry) {
+                continue;
+            }
+
             // 确实没有任务可做，进入休眠以节省 CPU 资源
-            std::unique_lock<std::mutex> lock(global_mtx_);
+            // 第一阶段: 登记为休眠者。从这一刻起，新的提交一定会尝试唤醒我们
+            uint32_t key = parker_.prepare_park();
 
-            // 再次检查停止标志，防止在休眠前刚好收到停止信号
-            if (stop_.load(std::memory_order_acquire))
+            // 再检查停止标志和所有队列，防止在登记之前刚好有任务或停止信号到达
+            if (stop_.load(std::memory_order_acquire)) {
+                parker_.cancel_park();
                 break;
+            }
+            if (states_[index].load(std::memory_order_acquire) !=
+                    WorkerState::Running ||
+                has_pending_work()) {
+                parker_.cancel_park();
+                continue;
+            }
 
-            // 等待唤醒或超时
-            // 设置超时 (如 10ms) 是为了防止某些极端情况下的信号丢失，
-            // 或者定期醒来检查是否有新的窃取机会（虽然主要靠 notify）。
-            global_cv_.wait_for(lock, std::chrono::milliseconds(10));
+            // 第二阶段: futex 休眠。协议保证不会丢失唤醒，所以不需要超时
+            auto park_start = std::chrono::steady_clock::now();
+            parker_.park(key);
+            counters_[index].record_park(park_start);
         }
     }
 }
+
+void ThreadPoolFast::drain_worker(size_t index) {
+    WorkQueue& queue = *queues_[index];
+
+    // 1. 关闭 inbox: 之后的外部提交者会换一个队列
+    std::vector<Job> leftover;
+    {
+        std::lock_guard<std::mutex> lock(queue.mtx);
+        queue.retired = true;
+        leftover.swap(queue.inbox);
+    }
+
+    // 2. 取出 deque 里剩下的任务 (thief 可能同时在偷，deque 保证不会重复)
+    while (auto job = queue.tasks.pop()) {
+        leftover.push_back(std::move(*job));
+    }
+
+    // 3. 不再是 worker: 以外部提交者的身份转交给活跃的 worker，并唤醒它们
+    tls_worker_ = {};
+    if (!leftover.empty()) {
+        enqueue_bulk(leftover.size(),
+                     [&](size_t i) -> Job&& { return std::move(leftover[i]); });
+    }
+}
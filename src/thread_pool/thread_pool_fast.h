@@ -1,17 +1,36 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <concepts>
-#include <condition_variable>
-#include <deque>
-#include <functional>
-#include <future>
+#include <latch>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <ranges>
 #include <thread>
 #include <type_traits>
 #include <vector>
 
+#include "chase_lev_deque.h"
+#include "cpu_topology.h"
+#include "elastic_scaler.h"
+#include "idle_policy.h"
+#include "inline_task.h"
+#include "latency_histogram.h"
+#include "mpmc_queue.h"
+#include "pool_stats.h"
+#include "producer_cursor.h"
+#include "task_batch.h"
+#include "task_future.h"
+#include "task_post.h"
+#include "task_tenant.h"
+#include "task_when.h"
+#include "timer_wheel.h"
+#include "worker_arena.h"
+#include "worker_parker.h"
+
 /**
  * @brief 高性能线程池 (Work Stealing 实现)
  * 
@@ -27,12 +46,121 @@
  * 3.  **Fine-Grained Locking (细粒度锁)**:
  *     - **机制**: 每个队列一把锁，而不是整个池一把锁。
  *     - **优势**: 允许高并发操作，不同线程操作不同队列时完全无锁冲突。
+ *
+ * 4.  **Lock-Free Local Deque (无锁本地队列)**:
+ *     - **机制**: 每个 worker 的本地队列是 Chase-Lev 双端队列。owner 在底部无锁 push/pop，
+ *       thief 在顶部 CAS 窃取；外部提交的任务先进入带锁的 `inbox`，
+ *       owner 每次把整批 inbox 搬进本地 deque，一把锁摊销到一整批任务上。
+ *     - **优势**: owner 的常见路径 (pop 本地任务) 和窃取路径都不再加锁。
+ *
+ * 5.  **Worker-Local Submission (本地提交)**:
+ *     - **机制**: worker 线程内部提交的子任务直接压入自己的 deque (无锁)；
+ *       外部线程则使用“每个实例、每个提交者”私有的轮询游标选择队列。
+ *     - **优势**: 递归 fork-join 的子任务留在父任务所在核心的缓存里；
+ *       提交者之间也不再争抢同一个全局计数器。
+ *
+ * 6.  **Allocation-Free Tasks (零分配任务)**:
+ *     - **机制**: 任务类型是 64 字节的 `parallel::InlineTask` (内联缓冲区)，
+ *       结果通过 `parallel::Future` 返回，共享状态来自线程局部的小块缓存。
+ *     - **优势**: 小 lambda 的提交稳态下不触发任何堆分配
+ *       (旧实现: shared_ptr<packaged_task> + bind + std::function 至少三次)。
+ *
+ * 7.  **Bulk Submission (批量提交)**:
+ *     - **机制**: `submit_n` / `submit_bulk` 把一批任务切成若干块，每个队列只加一次锁，
+ *       最后按休眠线程数做一次唤醒；整批只返回一个 Future<void>。
+ *     - **优势**: 大批量入队时，锁和 notify 的开销从“每个任务一次”降为“每批一次”。
+ *
+ * 8.  **Futex Parking (精确休眠)**:
+ *     - **机制**: 空闲 worker 通过 `parallel::WorkerParker` 两阶段休眠 (登记 → 再检查 → futex 等待)，
+ *       提交者只有在确实有人休眠时才发起唤醒。
+ *     - **优势**: 空闲时不再每 10ms 醒来轮询；没有休眠者时 submit 不进入内核。
+ *
+ * 9.  **Topology Awareness (拓扑感知)**:
+ *     - **机制**: 可选地把 worker 按“紧凑”顺序绑定到 CPU (拓扑读自 `/sys/devices/system/cpu`)，
+ *       窃取顺序分层: SMT 兄弟 → 同一 L3 → 同一 NUMA 节点 → 远端；
+ *       每个 worker 在绑核之后自己分配队列 (first touch)，队列内存落在自己的节点上。
+ *     - **优势**: thief 优先从共享缓存的邻居那里偷任务，减少跨 L3 / 跨插槽的缓存行迁移。
+ *
+ * 10. **Steal-Half (批量窃取)**:
+ *     - **机制**: 一次窃取最多搬走受害者一半的任务 (上限可配置)，放进 thief 自己的 deque。
+ *     - **优势**: 一个队列积压大量小任务时，任务按对数轮次扩散到所有 worker，
+ *       而不是每个 thief 一次偷一个、反复回到同一个受害者。
+ *
+ * 11. **Elastic Workers (弹性线程数)**:
+ *     - **机制**: 队列槽位按容量 (max_threads) 一次性分配、地址永不移动，前 `size()` 个槽位是活跃的。
+ *       `resize(n)` 在运行时启动/退役 worker；退役的 worker 先把自己的 inbox 标记为已退役
+ *       (之后提交者会换一个队列)，再把剩余任务转交给活跃的 worker，然后退出。
+ *       `enable_auto_resize` 启动监控线程，按排队/空闲情况自动伸缩。
+ *     - **优势**: 负载低谷时少占线程和唤醒，高峰时自动补充算力，任务在伸缩过程中不会丢失。
+ *
+ * 12. **Statistics (运行统计)**:
+ *     - **机制**: 每个 worker 在独占缓存行的计数器里记录执行数、窃取成功/失败、try_lock 失败、
+ *       休眠次数与时长；`stats()` 按需汇总，并顺带采样每个队列的深度。
+ *     - **优势**: 热路径上只有对自己缓存行的普通写入，可以在生产环境常开。
+ *
+ * 13. **Latency Histograms (延迟分布)**:
+ *     - **机制**: `set_latency_tracking(true)` 之后，提交的任务带上提交时刻；worker 执行时
+ *       把排队时间和执行时间记入自己的对数-线性直方图，`latency()` 合并出 p50/p99/p999。
+ *     - **优势**: 吞吐量看不出尾延迟。记录过程没有锁、没有共享写入；关闭时只多一次 relaxed 读。
+ *
+ * 14. **Fire-and-Forget (post)**:
+ *     - **机制**: `post(fn)` 直接把可调用对象放进队列，没有 Promise/Future 和共享状态；
+ *       任务抛出的异常交给 `set_exception_handler` 设置的处理函数。
+ *     - **优势**: 只有副作用的任务不再为用不到的 Future 付出引用计数和同步的开销。
+ *
+ * 15. **Continuations (then / when_all / when_any)**:
+ *     - **机制**: 线程池本身是一个 `parallel::Executor`，返回的 Future 记住它。
+ *       `future.then(fn)` 把回调登记在共享状态里，前一个任务完成时由完成的 worker 把回调放回本池；
+ *       `when_all` / `when_any` 在各输入完成时原子计数汇合。
+ *     - **优势**: 多阶段流水线全程异步，没有 worker 阻塞在 `get()` 上，也不需要调用方轮询。
+ *
+ * 16. **Idle Policy (空闲策略)**:
+ *     - **机制**: `set_idle_policy` 选择空闲 worker 的等待方式: 立即休眠、自旋后休眠、自旋后 yield、一直自旋，
+ *       自旋预算 (轮数) 可调。自旋中的 worker 计入空闲数，但提交者不需要唤醒它。
+ *     - **优势**: 低延迟通道用自旋省掉内核唤醒的几到几十微秒；后台通道立即休眠，不占 CPU。
+ *
+ * 17. **Injection Queue (全局注入队列)**:
+ *     - **机制**: 外部线程的单个提交 (submit / post / then 回调) 进入一个有界无锁的 MPMC 环形队列
+ *       (`parallel::MpmcQueue`)，而不是各 worker 带锁的 inbox。worker 在本地 deque 和 inbox 都为空时
+ *       取它，并且每执行 `kInjectionPollInterval` 个任务强制看一眼，防止本地任务源源不断时外部任务饿死。
+ *       注入队列写满时，`submit` / `post` 退回到 inbox 路径 (不会失败)，`try_post` 则返回 false。
+ *     - **优势**: 外部提交者之间只争抢一个 CAS，不再与 owner 转运 inbox 抢同一把锁；
+ *       `try_post` 给生产者一个天然的背压信号。批量提交 (submit_n / submit_bulk) 仍走 inbox，
+ *       它们本来就是每个队列一次加锁。
+ *
+ * 18. **Worker Arenas (任务临时内存)**:
+ *     - **机制**: 每个 worker 拥有一个 `parallel::WorkerArena` (单调分配的 pmr 内存资源)，
+ *       任务通过 `parallel::current_worker_arena()` 取得；每个任务结束后 arena 自动退回到任务开始时的位置。
+ *     - **优势**: 任务里的临时容器不再访问全局堆，worker 之间没有分配器争用；内存块跨任务复用。
+ *
+ * 19. **Tenant Fair Sharing (多租户加权公平)**:
+ *     - **机制**: `add_tenant` 注册租户 (权重 + 排队上限)，`submit_as` / `try_post_as` 把任务放进该租户自己的
+ *       有界无锁队列；默认租户 (0 号) 的队列就是注入队列。worker 在取注入队列的位置按步长调度
+ *       (Stride Scheduling，加权公平队列的一种) 选租户: 每个租户有一个虚拟时间 `pass`，
+ *       每执行一个任务推进 1 / weight，总是选 `pass` 最小的非空租户。空闲后重新积压的租户从全局虚拟时间开始，
+ *       不能靠空闲攒下的额度插队。
+ *     - **优势**: 一个租户狂刷 submit 只会塞满它自己的队列 (超过上限被拒绝)，其他租户照常按权重分到 worker；
+ *       选择过程只读几个原子变量，没有额外的锁。`stats().tenants` 给出每个租户的执行数、执行时长和排队/拒绝数。
+ *
+ * 20. **Timers (延迟与周期任务)**:
+ *     - **机制**: `submit_after` / `submit_at` / `post_after` / `submit_every` 把任务挂进分层时间轮
+ *       (`parallel::TimerWheel`，插入和取消都是 O(1))，由一个定时器线程在到期时刻醒来，
+ *       把同一时刻到期的任务用 `enqueue_bulk` 整批放进各 worker 的 inbox。定时器线程在第一次使用时才启动。
+ *     - **优势**: 等待期间不占用 worker (不再需要在任务里 sleep)；大量定时器只占时间轮节点，
+ *       没有定时器时定时器线程一直休眠。`post_after` / `submit_every` 返回的编号可以用 `cancel_timer` 取消。
  */
-class ThreadPoolFast {
+class ThreadPoolFast : public parallel::Executor {
    public:
-    // 构造函数：默认使用硬件支持的并发线程数
+    /**
+     * @brief 构造函数：默认使用硬件支持的并发线程数
+     * @param pin_workers 是否把 worker 绑定到 CPU (按拓扑紧凑排列)。
+     *        不支持绑核的平台上忽略，窃取顺序退化为环形顺序。
+     * @param max_threads `resize` 能达到的最大线程数，0 表示
+     *        max(num_threads, hardware_concurrency)
+     */
     explicit ThreadPoolFast(
-        size_t num_threads = std::thread::hardware_concurrency());
+        size_t num_threads = std::thread::hardware_concurrency(),
+        bool pin_workers = false, size_t max_threads = 0);
     ~ThreadPoolFast();
 
     // 禁用拷贝和移动，确保线程池实例的唯一性和安全性
@@ -46,7 +174,7 @@ class ThreadPoolFast {
      * @tparam Args 参数类型
      * @param f 函数对象
      * @param args 函数参数
-     * @return std::future<返回值类型> 用于获取异步结果
+     * @return parallel::Future<返回值类型> 用于获取异步结果
      * 
      * **C++20 特性**: 使用 `requires std::invocable` 概念 (Concept) 进行编译期约束，
      * 确保传入的函数和参数是可以被调用的，提供更友好的编译错误信息。
@@ -54,62 +182,678 @@ class ThreadPoolFast {
     template <typename F, typename... Args>
         requires std::invocable<F, Args...>
     auto submit(F&& f, Args&&... args)
-        -> std::future<typename std::invoke_result_t<F, Args...>>;
+        -> parallel::Future<std::invoke_result_t<F, Args...>>;
+
+    /**
+     * @brief 提交一个不需要结果的任务 (fire-and-forget)
+     *
+     * 不分配共享状态，也不返回 Future。任务抛出的异常交给 `set_exception_handler`
+     * 设置的处理函数 (在执行任务的线程上调用)；没有设置时 std::terminate。
+     */
+    template <typename F, typename... Args>
+        requires std::invocable<F, Args...>
+    void post(F&& f, Args&&... args);
+
+    /**
+     * @brief 尝试提交一个不需要结果的任务，外部线程在注入队列已满时立即返回 false
+     *
+     * 用于生产者的背压: 返回 false 时任务被丢弃 (不会执行)，传入的左值可调用对象不受影响。
+     * 在本池的 worker 线程中调用总是成功 (任务进入自己的 deque)。
+     */
+    template <typename F, typename... Args>
+        requires std::invocable<F, Args...>
+    bool try_post(F&& f, Args&&... args);
+
+    // 外部提交的注入队列容量 (超出后 submit / post 退回到 inbox，try_post 返回 false)
+    size_t injection_capacity() const { return injection().capacity(); }
+
+    // 最多能注册的租户数 (包括默认租户)
+    static constexpr size_t kMaxTenants = 64;
+
+    /**
+     * @brief 注册一个租户
+     * @return 新租户的编号，用于 submit_as / try_post_as / set_tenant_weight
+     * @throws std::length_error 租户数已经达到 kMaxTenants
+     */
+    parallel::TenantId add_tenant(parallel::TenantOptions options = {});
+
+    // 修改租户的权重 (包括默认租户)，可以随时调用；未注册的编号被忽略
+    void set_tenant_weight(parallel::TenantId tenant, uint32_t weight);
+
+    /**
+     * @brief 以某个租户的身份提交任务，按租户间的加权公平调度
+     *
+     * 租户排队数已达上限 (或者队列本身已写满) 时任务不会入队，
+     * 返回的 Future 收到 `parallel::TenantQueueFull`，同时计入该租户的 rejected。
+     * 未注册的编号按默认租户处理。
+     */
+    template <typename F, typename... Args>
+        requires std::invocable<F, Args...>
+    auto submit_as(parallel::TenantId tenant, F&& f, Args&&... args)
+        -> parallel::Future<std::invoke_result_t<F, Args...>>;
+
+    // 以某个租户的身份提交一个不需要结果的任务；租户排队数已达上限时返回 false (任务被丢弃)
+    template <typename F, typename... Args>
+        requires std::invocable<F, Args...>
+    bool try_post_as(parallel::TenantId tenant, F&& f, Args&&... args);
+
+    /**
+     * @brief 在 delay 之后提交任务 (等待期间不占用 worker)
+     *
+     * 到期时刻按定时器的 tick (1ms) 向上取整，不会提前执行。等待的时间不计入延迟统计。
+     */
+    template <typename F, typename... Args>
+        requires std::invocable<F, Args...>
+    auto submit_after(parallel::TimerClock::duration delay, F&& f,
+                      Args&&... args)
+        -> parallel::Future<std::invoke_result_t<F, Args...>> {
+        return submit_at(parallel::TimerClock::now() + delay,
+                         std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    // 在 when 时刻提交任务，已经过去的时刻在下一个 tick 提交
+    template <typename F, typename... Args>
+        requires std::invocable<F, Args...>
+    auto submit_at(parallel::TimerClock::time_point when, F&& f,
+                   Args&&... args)
+        -> parallel::Future<std::invoke_result_t<F, Args...>>;
+
+    // 延迟提交一个不需要结果的任务，返回的编号可以用 cancel_timer 取消
+    template <typename F, typename... Args>
+        requires std::invocable<F, Args...>
+    parallel::TimerId post_after(parallel::TimerClock::duration delay, F&& f,
+                                 Args&&... args);
+
+    /**
+     * @brief 每隔 period 执行一次 f (第一次在 period 之后)，直到 cancel_timer
+     *
+     * 上一次还没执行完时跳过这个周期: 同一个周期任务不会并发执行，落后时也不补发。
+     * 异常交给 `set_exception_handler` 设置的处理函数。
+     */
+    template <typename F>
+        requires std::invocable<std::decay_t<F>&>
+    parallel::TimerId submit_every(parallel::TimerClock::duration period,
+                                   F&& f);
+
+    /**
+     * @brief 取消 post_after / submit_every 的定时器
+     * @return 取消前还没到期 (周期任务: 还没被取消) 时返回 true
+     */
+    bool cancel_timer(parallel::TimerId id) { return timers_.cancel(id); }
+
+    // 还没到期的定时器数 (周期任务算一个)
+    size_t pending_timers() const { return timers_.pending(); }
+
+    // Executor 接口: then() 回调完成时由此回到本池 (与 post 相同的入队路径，不计延迟)
+    void schedule(parallel::InlineTask task) override;
+
+    // 设置 post() 任务的异常处理函数，可以随时替换
+    void set_exception_handler(parallel::ExceptionSink::Handler handler) {
+        errors_.set(std::move(handler));
+    }
+
+    /**
+     * @brief 批量提交: 执行 fn(0), fn(1), ..., fn(count - 1)
+     *
+     * @param count 任务个数
+     * @param fn 以下标 (size_t) 为参数的函数对象，所有任务共享同一份
+     * @return Future<void> 整批完成时就绪；任意任务抛异常时 get() 重新抛出第一个异常
+     */
+    template <typename F>
+        requires std::invocable<F&, size_t>
+    parallel::Future<void> submit_n(size_t count, F&& fn);
+
+    /**
+     * @brief 批量提交一组无参可调用对象 (例如 std::vector<lambda>)
+     *
+     * 右值范围中的元素会被移动，左值范围中的元素会被拷贝。
+     * @return Future<void> 整批完成时就绪
+     */
+    template <std::ranges::sized_range R>
+        requires std::invocable<std::ranges::range_value_t<R>&>
+    parallel::Future<void> submit_bulk(R&& range);
+
+    /**
+     * @brief 在当前线程上执行一个排队中的任务 (先取本地队列，再窃取)
+     *
+     * 供等待方“边等边干活”使用 (例如 parallel_for 的汇合点)，
+     * 避免 worker 线程阻塞等待自己队列里的子任务而造成死锁。
+     * @return 执行了一个任务返回 true，没有可执行的任务返回 false
+     */
+    bool try_run_one();
+
+    /**
+     * @brief 等待 Future 就绪，等待期间在当前线程上执行排队中的任务
+     *
+     * 在 worker 线程里直接 `future.get()` 会占住这个 worker: 如果被等待的子任务
+     * 恰好排在自己的队列里，就会死锁。用这个函数代替裸 `wait()` 即可安全地等待子任务。
+     */
+    template <typename T>
+    void help_until_ready(const parallel::Future<T>& future);
+
+    /**
+     * @brief 现在拆分出新任务，是否可能被其他线程拿走
+     *
+     * worker 线程: 自己的 deque 为空 (窃取者拿不到任何东西) 时返回 true；
+     * 外部线程: 有 worker 在休眠时返回 true。
+     * 懒惰二分 (Lazy Binary Splitting) 据此决定是否拆分剩余区间。
+     */
+    bool has_idle_workers() const;
+
+    /**
+     * @brief 当前线程在本线程池中的 worker 编号
+     * @return 不是本池的 worker 线程时返回 std::nullopt
+     */
+    std::optional<size_t> current_worker_index() const {
+        if (tls_worker_.pool == this)
+            return tls_worker_.index;
+        return std::nullopt;
+    }
+
+    // 当前活跃的 worker 数
+    size_t size() const { return active_.load(std::memory_order_relaxed); }
+
+    // resize 能达到的最大 worker 数
+    size_t capacity() const { return queues_.size(); }
+
+    /**
+     * @brief 运行时调整 worker 数量 (限制在 [1, capacity()] 内)
+     *
+     * 扩容时等新 worker 就绪后才返回；缩容时被退役的 worker 执行完手头的任务后，
+     * 把队列中剩余的任务转交给活跃的 worker 再退出 (不等待它们退出)。
+     * 可以从任何线程调用，包括本池的 worker。
+     */
+    void resize(size_t num_threads);
+
+    /**
+     * @brief 开启自动伸缩: 任务持续排队时增加 worker，worker 持续空闲时退役
+     *
+     * 再次调用会以新策略替换旧策略。不要与 disable_auto_resize 并发调用。
+     */
+    void enable_auto_resize(parallel::ElasticPolicy policy = {});
+
+    void disable_auto_resize();
+
+    /**
+     * @brief 汇总所有 worker 的统计计数 (每个槽位一项，包括已退役的 worker)
+     *
+     * 计数是累计值；队列深度是调用时的采样值。与 worker 并发执行，结果只是近似的快照。
+     */
+    parallel::PoolStats stats();
+
+    /**
+     * @brief 开启/关闭任务延迟统计 (默认关闭)
+     *
+     * 开启后每个任务多两次读时钟；只影响之后提交的任务。
+     */
+    void set_latency_tracking(bool enabled) {
+        latency_tracking_.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool latency_tracking() const {
+        return latency_tracking_.load(std::memory_order_relaxed);
+    }
+
+    // 合并所有 worker 的排队时间/执行时间直方图
+    parallel::PoolLatency latency() const;
+
+    /**
+     * @brief 设置空闲 worker 的等待方式，可以随时切换 (已休眠的 worker 会被唤醒，按新策略重新等待)
+     */
+    void set_idle_policy(parallel::IdlePolicy policy);
+
+    parallel::IdlePolicy idle_policy() const {
+        return {idle_strategy_.load(std::memory_order_relaxed),
+                spin_rounds_.load(std::memory_order_relaxed)};
+    }
+
+    /**
+     * @brief 设置一次窃取最多搬走的任务数 (实际数量不超过受害者队列的一半)
+     * @param max_tasks 1 表示每次只偷一个任务 (不做批量窃取)；0 按 1 处理
+     */
+    void set_steal_batch(size_t max_tasks) {
+        steal_batch_.store(max_tasks == 0 ? 1 : max_tasks,
+                           std::memory_order_relaxed);
+    }
+
+    size_t steal_batch() const {
+        return steal_batch_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief worker 绑定的逻辑 CPU
+     * @return 未绑核时返回 std::nullopt
+     */
+    std::optional<int> worker_cpu(size_t index) const {
+        if (worker_cpus_[index].cpu < 0)
+            return std::nullopt;
+        return worker_cpus_[index].cpu;
+    }
 
    private:
-    // 工作线程的主循环函数
-    void worker_thread(size_t index);
+    // 队列中存放的任务: 64 字节、可平凡重定位，Chase-Lev deque 可以按值存放
+    using Job = parallel::InlineTask;
+
+    // worker 的生命周期状态 (每个槽位一个)
+    enum class WorkerState : int {
+        Stopped,     // 没有线程，或线程已经退出
+        Running,     // 正常工作
+        Retiring,    // resize 要求退役，worker 执行完当前任务后开始转交
+        Draining,    // 正在把剩余任务转交给活跃的 worker，马上退出
+    };
+
+    // 工作线程的主循环函数。ready 在自己的队列就绪后 count_down
+    void worker_thread(size_t index, std::latch* ready);
+
+    // 在指定槽位上启动 worker，并等待它们的队列就绪
+    void start_workers(const std::vector<size_t>& slots);
+
+    // 退役: 把 inbox 标记为已退役，剩余任务转交给活跃的 worker
+    void drain_worker(size_t index);
+
+    // 放入某个外部 inbox (跳过已退役的队列)
+    void push_external(Job job);
+
+    // 给自动伸缩用的负载采样
+    parallel::LoadSample sample_load();
+
+    // 开启延迟统计时返回提交时刻，否则返回 0 (任务不包装)
+    uint64_t submit_stamp() const {
+        return latency_tracking() ? parallel::latency_now() : 0;
+    }
+
+    // 从本地 deque 取任务；本地为空时把 inbox 整批搬进 deque。没有任务时返回空 Job
+    Job pop_local(size_t index, std::vector<Job>& batch);
+
+    // 每个租户一个有界无锁队列，外加加权公平调度的状态。0 号 (默认租户) 的队列就是注入队列
+    struct alignas(64) Tenant {
+        Tenant(size_t capacity, size_t limit)
+            : queue(capacity), max_queued(limit) {}
+
+        // 按提交时的长度检查上限 (软限制)
+        bool full() const { return queue.size() >= max_queued; }
+
+        parallel::MpmcQueue<Job> queue;
+        const size_t max_queued;
+        std::atomic<uint32_t> weight{1};
+        std::atomic<uint64_t> stride{kStrideScale};    // 每执行一个任务 pass 推进的量
+        std::atomic<uint64_t> pass{0};                 // 虚拟时间
+        std::atomic<uint64_t> rejected{0};
+        // 外部线程 (try_run_one) 帮忙执行的部分，不在热路径上
+        std::atomic<uint64_t> external_executed{0};
+        std::atomic<uint64_t> external_busy_ns{0};
+    };
+
+    // 每个 worker 按租户的使用量计数，只由该 worker 写入
+    struct TenantCounters {
+        parallel::StatCounter executed;
+        parallel::StatCounter busy_ns;
+    };
+    struct alignas(64) TenantSlots {
+        std::array<TenantCounters, kMaxTenants> tenants;
+    };
+
+    // 权重为 1 的租户每个任务推进的虚拟时间
+    static constexpr uint64_t kStrideScale = uint64_t{1} << 20;
+
+    // pop_injected 取到的任务不属于需要统计的租户 (没有注册过租户时)
+    static constexpr size_t kUntracked = kMaxTenants;
+
+    // 默认租户的队列 (外部线程单个提交的注入队列)
+    parallel::MpmcQueue<Job>& injection() const { return tenants_[0]->queue; }
+
+    // 编号对应的租户，未注册的编号按默认租户处理
+    Tenant& tenant_slot(parallel::TenantId tenant) const {
+        if (tenant < tenant_count_.load(std::memory_order_acquire)) {
+            return *tenants_[tenant];
+        }
+        return *tenants_[parallel::kDefaultTenant];
+    }
+
+    /**
+     * @brief 从租户队列 (含注入队列) 取一个任务，为空时返回空 Job
+     *
+     * 只有默认租户时直接取注入队列；否则按加权公平选出虚拟时间最小的非空租户。
+     * tenant 返回任务所属的租户，没有注册过租户时为 kUntracked (不统计)。
+     */
+    Job pop_injected(size_t& tenant);
+
+    // 记录租户任务的执行时长: worker 写自己的计数槽，外部线程写租户的共享计数
+    void record_tenant(size_t tenant, uint64_t busy_ns);
+
+    // 外部线程的单个任务先进注入队列，写满时退回到 inbox
+    void push_injected(Job job) {
+        if (!injection().try_push(std::move(job))) {
+            push_external(std::move(job));
+        }
+    }
+
+    // 包装 post() / try_post() 的任务体
+    template <typename F, typename... Args>
+    Job make_posted(F&& f, Args&&... args);
+
+    // 按 steal_order_[index] 的分层顺序从其他 worker 处窃取，失败时返回空 Job。
+    // worker 一次最多搬走受害者一半的任务: 返回其中一个，其余放进自己的 deque。
+    // index == size() 表示外部线程，只偷一个
+    Job steal(size_t index);
+
+    // 把任务放入合适的队列: worker 线程放自己的 deque，外部线程放注入队列 (满了放 inbox)
+    void enqueue(Job job);
+
+    // 批量入队: 依次调用 make_task(0..count-1) 生成任务，每个队列只加一次锁
+    template <typename MakeTask>
+    void enqueue_bulk(size_t count, MakeTask&& make_task);
+
+    // 外部提交者的下一个目标队列 (thread_local 轮询游标)
+    size_t next_external_queue();
+
+    // 休眠前的再检查: 租户队列 (含注入队列) 或任意 worker 队列 (deque / inbox) 中是否还有任务
+    bool has_pending_work();
+
+    // 线程身份: 标记当前线程是哪个池的第几号 worker
+    struct WorkerIdentity {
+        const ThreadPoolFast* pool = nullptr;
+        size_t index = 0;
+    };
+
+    static thread_local WorkerIdentity tls_worker_;
+    // 外部提交者的轮询游标: 每个提交线程私有，按池分别记录
+    static thread_local parallel::ProducerCursorCache tls_cursors_;
 
     // **关键数据结构**: 任务队列
     // alignas(64) 是为了适配常见的 L1 Cache Line 大小 (64字节)
     // 强制每个 WorkQueue 对象的起始地址是 64 的倍数，避免 False Sharing。
     struct alignas(64) WorkQueue {
-        std::deque<std::function<void()>> tasks;    // 双端队列，支持从尾部窃取
-        std::mutex mtx;                             // 专属于该队列的互斥锁
+        parallel::ChaseLevDeque<Job> tasks;    // 仅 owner push/pop，其他线程 steal
+        std::vector<Job> inbox;                // 外部线程提交的任务 (受 mtx 保护)
+        bool retired = false;    // owner 已退役，不再接收新任务 (受 mtx 保护)
+        std::mutex mtx;          // 保护 inbox 和 retired
     };
 
-    // 使用 unique_ptr 管理队列，确保队列对象的地址固定，不会因为 vector 扩容而移动
+    // 使用 unique_ptr 管理队列，确保队列对象的地址固定。
+    // 槽位数等于容量，构造后不再改变；并发的提交者/窃取者只访问 [0, active_) 内的槽位。
+    // 每个队列由它的第一个 worker 在绑核之后自己分配 (first touch)，之后一直复用。
     std::vector<std::unique_ptr<WorkQueue>> queues_;
     std::vector<std::thread> threads_;
+    std::vector<std::atomic<WorkerState>> states_;
+    std::atomic<size_t> active_{0};
+    std::mutex resize_mtx_;    // 串行化 resize
+    std::unique_ptr<parallel::AutoScaler> scaler_;
+
+    // 每个 worker 所在的 CPU (未绑核时 cpu == -1) 与分层窃取顺序
+    std::vector<parallel::CpuInfo> worker_cpus_;
+    std::vector<std::vector<size_t>> steal_order_;
+
+    // 每个槽位的统计计数，只由该槽位的 worker 写入
+    std::vector<parallel::WorkerCounters> counters_;
+    // 外部线程 (try_run_one / help_until_ready) 执行的任务数，不在热路径上
+    std::atomic<uint64_t> external_executed_{0};
+
+    // 每个槽位的延迟直方图，只由该槽位的 worker 写入
+    std::vector<parallel::LatencyRecorder> latency_;
+    std::atomic<bool> latency_tracking_{false};
+
+    // post() 任务的异常处理
+    parallel::ExceptionSink errors_;
+
+    // 延迟/周期任务: 到期时整批交给 enqueue_bulk
+    parallel::TimerService timers_;
 
     // 原子停止标志，使用 memory_order 控制可见性
     std::atomic<bool> stop_{false};
 
-    // 全局同步原语，仅用于处理线程休眠和唤醒（当所有队列都为空时）
-    std::mutex global_mtx_;
-    std::condition_variable global_cv_;
+    // 新提交者的起始队列种子: 只在某个线程第一次向本池提交时递增一次，
+    // 让不同提交者从不同队列开始轮询
+    std::atomic<size_t> producer_seed_{0};
+
+    std::atomic<size_t> steal_batch_{32};    // 一次窃取最多搬走的任务数
+
+    // 外部线程单个提交的全局注入队列 (有界、无锁)，即默认租户的队列
+    static constexpr size_t kInjectionCapacity = 1024;
+    // worker 每执行这么多个任务就先看一眼注入队列 (与 Go / Tokio 调度器的取值相同)
+    static constexpr uint32_t kInjectionPollInterval = 61;
+
+    // 租户: 槽位按 kMaxTenants 固定，注册时填入，之后一直保留到析构。
+    // worker 和提交者只访问 [0, tenant_count_) 内的槽位
+    std::array<std::unique_ptr<Tenant>, kMaxTenants> tenants_;
+    std::atomic<size_t> tenant_count_{1};
+    std::mutex tenant_mtx_;    // 串行化 add_tenant
+    // 全局虚拟时间: 最近被选中的租户的 pass，重新积压的租户从这里开始
+    std::atomic<uint64_t> vtime_{0};
+    std::vector<TenantSlots> tenant_counters_;
+
+    // 空闲策略 (worker 每次空闲时读取)
+    std::atomic<parallel::IdleStrategy> idle_strategy_{
+        parallel::IdleStrategy::Park};
+    std::atomic<uint32_t> spin_rounds_{128};
+
+    // 空闲 worker 的休眠/唤醒 (当所有队列都为空时)
+    parallel::WorkerParker parker_;
 };
 
 // 模板函数实现
 template <typename F, typename... Args>
     requires std::invocable<F, Args...>
 auto ThreadPoolFast::submit(F&& f, Args&&... args)
-    -> std::future<typename std::invoke_result_t<F, Args...>> {
-    using return_type = typename std::invoke_result_t<F, Args...>;
-
+    -> parallel::Future<std::invoke_result_t<F, Args...>> {
     // 包装任务，以便获取返回值
-    auto task = std::make_shared<std::packaged_task<return_type()>>(
-        std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    auto [task, res] = parallel::package_timed_task(
+        submit_stamp(), std::forward<F>(f), std::forward<Args>(args)...);
+
+    enqueue(std::move(task));
+
+    // 唤醒一个正在休眠的工作线程 (没有人休眠时不做系统调用)
+    parker_.notify();
 
-    std::future<return_type> res = task->get_future();
+    return std::move(res).via(this);
+}
+
+template <typename F, typename... Args>
+    requires std::invocable<F, Args...>
+void ThreadPoolFast::post(F&& f, Args&&... args) {
+    enqueue(make_posted(std::forward<F>(f), std::forward<Args>(args)...));
+    parker_.notify();
+}
+
+template <typename F, typename... Args>
+    requires std::invocable<F, Args...>
+bool ThreadPoolFast::try_post(F&& f, Args&&... args) {
+    Job job = make_posted(std::forward<F>(f), std::forward<Args>(args)...);
+    if (tls_worker_.pool == this) {
+        queues_[tls_worker_.index]->tasks.push(std::move(job));
+    } else if (!injection().try_push(std::move(job))) {
+        return false;
+    }
+    parker_.notify();
+    return true;
+}
+
+template <typename F, typename... Args>
+    requires std::invocable<F, Args...>
+auto ThreadPoolFast::submit_as(parallel::TenantId tenant, F&& f,
+                               Args&&... args)
+    -> parallel::Future<std::invoke_result_t<F, Args...>> {
+    using R = std::invoke_result_t<F, Args...>;
 
-    // **负载均衡策略**: 简单的轮询 (Round-Robin) 分发
-    // 作用: 将新任务均匀地分配给各个线程的队列，避免热点。
-    // 为什么用 atomic: 保证多线程同时提交任务时，index 计算是安全的。
-    // memory_order_relaxed: 这里不需要严格的同步顺序，只要计数增加即可。
-    static std::atomic<size_t> current_queue_index{0};
-    size_t index = current_queue_index.fetch_add(1, std::memory_order_relaxed) %
-                   queues_.size();
+    Tenant& target = tenant_slot(tenant);
+    if (!target.full()) {
+        auto [task, res] = parallel::package_timed_task(
+            submit_stamp(), std::forward<F>(f), std::forward<Args>(args)...);
+        // 并发提交者恰好同时挤满队列时 try_push 会失败: 与 try_post_as 一样按拒绝处理。
+        // 不能退回到 inbox，那样任务绕开了步长调度和排队上限，也不计入租户统计
+        if (target.queue.try_push(std::move(task))) {
+            parker_.notify();
+            return std::move(res).via(this);
+        }
+    }
+
+    target.rejected.fetch_add(1, std::memory_order_relaxed);
+    parallel::Promise<R> promise;
+    parallel::Future<R> res = promise.get_future();
+    promise.set_exception(std::make_exception_ptr(parallel::TenantQueueFull()));
+    return std::move(res).via(this);
+}
 
-    {
-        // **细粒度锁**: 只锁定目标队列的锁，而不是全局锁
-        // 这样其他线程可以并发地向其他队列提交任务。
-        std::lock_guard<std::mutex> lock(queues_[index]->mtx);
-        queues_[index]->tasks.emplace_back([task]() { (*task)(); });
+template <typename F, typename... Args>
+    requires std::invocable<F, Args...>
+bool ThreadPoolFast::try_post_as(parallel::TenantId tenant, F&& f,
+                                 Args&&... args) {
+    Tenant& target = tenant_slot(tenant);
+    if (target.full()) {
+        target.rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    Job job = make_posted(std::forward<F>(f), std::forward<Args>(args)...);
+    if (!target.queue.try_push(std::move(job))) {
+        target.rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
     }
+    parker_.notify();
+    return true;
+}
 
-    // 唤醒一个可能正在休眠的工作线程
-    global_cv_.notify_one();
+template <typename F, typename... Args>
+    requires std::invocable<F, Args...>
+auto ThreadPoolFast::submit_at(parallel::TimerClock::time_point when, F&& f,
+                               Args&&... args)
+    -> parallel::Future<std::invoke_result_t<F, Args...>> {
+    auto [task, res] =
+        parallel::package_task(std::forward<F>(f), std::forward<Args>(args)...);
+    timers_.add(when, 0, std::move(task));
+    return std::move(res).via(this);
+}
+
+template <typename F, typename... Args>
+    requires std::invocable<F, Args...>
+parallel::TimerId ThreadPoolFast::post_after(
+    parallel::TimerClock::duration delay, F&& f, Args&&... args) {
+    using Fn = decltype(parallel::detail::bind_call(
+        std::forward<F>(f), std::forward<Args>(args)...));
+
+    return timers_.add(
+        parallel::TimerClock::now() + delay, 0,
+        parallel::detail::PostedCall<Fn>{
+            parallel::detail::bind_call(std::forward<F>(f),
+                                        std::forward<Args>(args)...),
+            &errors_});
+}
+
+template <typename F>
+    requires std::invocable<std::decay_t<F>&>
+parallel::TimerId ThreadPoolFast::submit_every(
+    parallel::TimerClock::duration period, F&& f) {
+    return timers_.add_periodic(
+        period, 0,
+        parallel::detail::PostedCall<std::decay_t<F>>{std::forward<F>(f),
+                                                      &errors_});
+}
+
+template <typename F, typename... Args>
+ThreadPoolFast::Job ThreadPoolFast::make_posted(F&& f, Args&&... args) {
+    using Fn = decltype(parallel::detail::bind_call(
+        std::forward<F>(f), std::forward<Args>(args)...));
+
+    return parallel::detail::make_timed_task(
+        parallel::detail::PostedCall<Fn>{
+            parallel::detail::bind_call(std::forward<F>(f),
+                                        std::forward<Args>(args)...),
+            &errors_},
+        submit_stamp());
+}
+
+template <typename F>
+    requires std::invocable<F&, size_t>
+parallel::Future<void> ThreadPoolFast::submit_n(size_t count, F&& fn) {
+    using Fn = std::decay_t<F>;
+    using Call = parallel::detail::IndexedCall<Fn>;
+
+    if (count == 0) {
+        return parallel::make_ready_future().via(this);
+    }
+
+    // 整批只分配一次: fn 和完成计数器放在同一个对象里，每个任务只携带 (批次指针, 下标)
+    auto* batch =
+        new parallel::detail::IndexedBatch<Fn>(count, std::forward<F>(fn));
+    parallel::Future<void> res = batch->get_future();
+
+    uint64_t submitted = submit_stamp();
+    enqueue_bulk(count, [batch, submitted](size_t i) {
+        return parallel::detail::make_timed_task(
+            parallel::detail::BatchItem<Call>(batch, Call{batch, i}),
+            submitted);
+    });
+    return std::move(res).via(this);
+}
+
+template <std::ranges::sized_range R>
+    requires std::invocable<std::ranges::range_value_t<R>&>
+parallel::Future<void> ThreadPoolFast::submit_bulk(R&& range) {
+    using Body = std::ranges::range_value_t<R>;
+
+    size_t count = static_cast<size_t>(std::ranges::size(range));
+    if (count == 0) {
+        return parallel::make_ready_future().via(this);
+    }
+
+    auto* batch = new parallel::detail::BatchCompletion(count);
+    parallel::Future<void> res = batch->get_future();
+
+    auto it = std::ranges::begin(range);
+    uint64_t submitted = submit_stamp();
+    enqueue_bulk(count, [&](size_t) {
+        if constexpr (std::is_lvalue_reference_v<R>) {
+            return parallel::detail::make_timed_task(
+                parallel::detail::BatchItem<Body>(batch, Body(*it++)),
+                submitted);
+        } else {
+            return parallel::detail::make_timed_task(
+                parallel::detail::BatchItem<Body>(batch,
+                                                  Body(std::move(*it++))),
+                submitted);
+        }
+    });
+    return std::move(res).via(this);
+}
+
+template <typename T>
+void ThreadPoolFast::help_until_ready(const parallel::Future<T>& future) {
+    // 只要还有可执行的任务就帮忙执行；实在没有时，
+    // 被等待的任务一定正在别的线程上运行，可以放心阻塞。
+    while (!future.is_ready()) {
+        if (!try_run_one()) {
+            future.wait();
+        }
+    }
+}
+
+template <typename MakeTask>
+void ThreadPoolFast::enqueue_bulk(size_t count, MakeTask&& make_task) {
+    if (tls_worker_.pool == this) {
+        // worker 内部的批量提交: 全部压入自己的 deque (无锁)，由空闲线程来窃取
+        WorkQueue& queue = *queues_[tls_worker_.index];
+        for (size_t i = 0; i < count; ++i) {
+            queue.tasks.push(Job(make_task(i)));
+        }
+    } else {
+        // 外部批量提交: 切成 chunks 块，分给连续的若干个队列，每个队列只加一次锁
+        size_t num_queues = active_.load(std::memory_order_acquire);
+        size_t chunks = std::min(count, num_queues);
+        size_t start = next_external_queue();
+        size_t begin = 0;
+        for (size_t c = 0, skip = 0; c < chunks;) {
+            WorkQueue& queue = *queues_[(start + c + skip) % num_queues];
+            std::lock_guard<std::mutex> lock(queue.mtx);
+            if (queue.retired) {
+                ++skip;    // 正在退役，换下一个 (0 号 worker 永不退役)
+                continue;
+            }
+            size_t end = count * (c + 1) / chunks;
+            for (; begin < end; ++begin) {
+                queue.inbox.push_back(Job(make_task(begin)));
+            }
+            ++c;
+        }
+    }
 
-    return res;
+    parker_.notify(count);
 }
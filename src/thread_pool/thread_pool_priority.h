@@ -1,122 +1,1614 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <atomic>
+#include <bit>
 #include <concepts>
-#include <condition_variable>
-#include <deque>
-#include <functional>
-#include <future>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <random>
+#include <ranges>
 #include <thread>
 #include <type_traits>
 #include <vector>
 
+#include "idle_policy.h"
+#include "inline_task.h"
+#include "latency_histogram.h"
+#include "mpmc_queue.h"
+#include "pool_stats.h"
+#include "producer_cursor.h"
+#include "elastic_scaler.h"
+#include "ring_queue.h"
+#include "task_batch.h"
+#include "task_deadline.h"
+#include "task_future.h"
+#include "task_post.h"
+#include "task_when.h"
+#include "thread_sched.h"
+#include "timer_wheel.h"
+#include "worker_arena.h"
+#include "worker_parker.h"
+
 namespace parallel {
 
 /**
  * @brief 任务优先级定义
+ *
+ * 级别数不是 3 的线程池 (BasicThreadPoolPriority<Levels>) 用 `static_cast<Priority>(k)`
+ * 表示第 k 级 (0 最高)。
  */
 enum class Priority {
     High = 0,
     Normal = 1,
     Low = 2,
-    Count = 3    // 辅助计数
+    Count = 3    // 默认线程池 (ThreadPoolPriority) 的级别数
+};
+
+/**
+ * @brief 防饥饿策略: 有任务在等的低优先级级别最多被越过多少次
+ *
+ * worker 每次从高级别取任务时，给每个有任务在等的更低级别记一次“越过”；
+ * 某个级别被同一个 worker 连续越过 `max_bypass` 次后，下一次就先执行它。
+ * 于是持续有 High 任务时，Low 至少能分到 1 / (max_bypass + 1) 的执行机会。
+ * 计数是每个 worker 私有的，不需要任何共享状态。
+ */
+struct AgingPolicy {
+    uint32_t max_bypass = 0;    // 0 表示关闭 (严格按优先级)
 };
 
+/**
+ * @brief worker 的调度类别: 专用于 High 的 worker 数，以及两类 worker 的操作系统调度参数
+ *
+ * 专用 worker 只执行第 0 级 (High) 的任务，从不执行其他级别；它们不参与 resize，
+ * 线程池析构时才退出。普通 worker 照常执行所有级别 (也包括 High)。
+ */
+struct WorkerClasses {
+    size_t reserved = 0;                 // 专用 worker 数
+    ThreadSchedParams reserved_sched;    // 专用 worker 的调度参数 (如 SCHED_FIFO、独占的 CPU)
+    ThreadSchedParams shared_sched;      // 普通 worker 的调度参数 (如调高 nice，把 CPU 让给专用 worker)
+};
+
+namespace detail {
+
+// BasicThreadPoolPriority 的线程局部状态，所有级别数共用，靠 pool 指针区分。
+// 放在命名空间里而不是类模板的静态成员: 后者配合 extern template 时
+// GCC 生成的 TLS 初始化函数引用可能为空
+struct PriorityWorkerIdentity {
+    const void* pool = nullptr;
+    size_t index = 0;
+};
+
+inline thread_local PriorityWorkerIdentity tls_priority_worker;
+inline thread_local ProducerCursorCache tls_priority_cursors;
+
+}    // namespace detail
+
 /**
  * @brief 支持优先级的任务调度器 (Based on ThreadPoolFast)
  * 
  * **Day 2 特性**:
  * 1.  **Priority Scheduling (优先级调度)**:
- *     - 支持 High, Normal, Low 三种优先级。
+ *     - 级别数是模板参数 `Levels` (0 最高)；`ThreadPoolPriority` 是 High, Normal, Low 三级的版本。
  *     - 内部使用多级队列 (Multi-Level Queues) 管理任务。
  *     - 工作线程总是优先处理高优先级任务。
  * 
  * 2.  **Optimized Work Stealing (优化的窃取策略)**:
  *     - **优先级窃取**: 窃取时也优先窃取受害者的高优先级任务。
  *     - **随机窃取 (Random Stealing)**: 随机选择受害者，减少多线程同时尝试窃取同一目标的锁竞争。
+ *
+ * 3.  **Worker-Local Submission (本地提交)**:
+ *     - worker 线程内提交的任务进入自己的队列；外部线程使用每个提交者私有的轮询游标。
+ *
+ * 4.  **Allocation-Free Tasks (零分配任务)**:
+ *     - 队列元素是 `InlineTask`，结果通过轻量的 `parallel::Future` 返回。
+ *
+ * 5.  **Bulk Submission (批量提交)**:
+ *     - `submit_n` / `submit_bulk` 整批入队，每个队列只加一次锁，整批只返回一个 Future<void>。
+ *
+ * 6.  **Futex Parking (精确休眠)**:
+ *     - 空闲 worker 通过 `WorkerParker` 休眠，没有超时轮询；没有休眠者时提交不进入内核。
+ *
+ * 7.  **Steal-Half (批量窃取)**:
+ *     - 一次加锁最多搬走受害者最高优先级队列的一半 (上限可配置)，放进自己同一优先级的队列。
+ *
+ * 8.  **Elastic Workers (弹性线程数)**:
+ *     - 与 ThreadPoolFast 相同: `resize` 运行时增减 worker，退役的 worker 把剩余任务按原优先级转交；
+ *       `enable_auto_resize` 根据排队/空闲情况自动伸缩。
+ *
+ * 9.  **Statistics (运行统计)**:
+ *     - 每个 worker 独占缓存行的计数器 (含按优先级的执行数)，`stats()` 按需汇总。
+ *
+ * 10. **Latency Histograms (延迟分布)**:
+ *     - 开启 `set_latency_tracking` 后，按 worker × 优先级记录排队时间与执行时间，
+ *       `latency()` 合并出整体与各优先级的分位数。
+ *
+ * 11. **Fire-and-Forget (post)**:
+ *     - `post(prio, fn)` 不创建 Future，异常交给 `set_exception_handler` 设置的处理函数。
+ *
+ * 12. **Continuations (then / when_all / when_any)**:
+ *     - 每个优先级一个 `Executor`，submit 返回的 Future 记住它:
+ *       `then` 的回调以前一个任务的优先级回到本池，`via(pool.executor(prio))` 可以换优先级。
+ *
+ * 13. **Idle Policy (空闲策略)**:
+ *     - 与 ThreadPoolFast 相同: `set_idle_policy` 选择立即休眠、自旋后休眠、自旋后 yield 或一直自旋。
+ *
+ * 14. **Worker Arenas (任务临时内存)**:
+ *     - 与 ThreadPoolFast 相同: 任务通过 `current_worker_arena()` 从 worker 私有的 arena 分配临时内存，
+ *       每个任务结束后自动回收。
+ *
+ * 15. **Anti-Starvation (防饥饿)**:
+ *     - `set_aging_policy` 限制低优先级连续被越过的次数 (本地取任务和窃取都适用)，
+ *       保证持续的 High 负载下 Low 仍有最低份额。默认关闭，行为与严格优先级相同。
+ *     - `stats()` 的 `bypassed_by_priority` / `promoted_by_priority` 反映各级别被越过和被提前执行的次数。
+ *
+ * 16. **Deadline Scheduling (EDF)**:
+ *     - `submit_by(deadline, fn)` / `post_by` 把任务放进每个 worker 的最早截止时间优先 (EDF) 小顶堆。
+ *       截止时间任务排在所有优先级之前；窃取时也先偷受害者最紧迫的任务。
+ *     - 开始执行时已经过期的任务不再执行: Future 收到 `DeadlineExceeded`，post_by 的任务交给异常处理函数。
+ *       `stats()` 的 `deadline_expired` / `deadline_late` 统计过期丢弃和超时完成的任务数。
+ *
+ * 17. **Non-Empty Bitmask (非空位图)**:
+ *     - 每个队列发布一个原子位图: 第 0 位是 EDF 堆，第 k + 1 位是第 k 级。位图在持有队列锁时更新，
+ *       读取不加锁。
+ *     - worker 用 `std::countr_zero` 直接找到最高的非空级别；自己的位图为 0 时不碰自己的锁。
+ *     - 窃取者先不加锁地扫一遍所有位图，只锁全局最紧迫的那个受害者；全部为空时一把锁也不拿。
+ *       休眠前的再检查同样只读位图。
+ *
+ * 18. **Shared Lanes (共享紧急通道)**:
+ *     - 最高的 `shared_levels()` 个级别 (默认只有 High) 的单个提交 (submit / post / then 回调) 不再轮询分给
+ *       某一个 worker，而是进入该级别所有 worker 共享的无锁 MPMC 通道；worker 取本地队列之前先看通道。
+ *       于是紧急任务的排队时间取决于最先空出来的 worker，而不是轮询碰巧选中的那个 (它可能正卡在一个很长的 Low 任务里)。
+ *     - 通道有界 (`kSharedLaneCapacity`)，写满时退回到本地队列。批量提交 (submit_n / submit_bulk) 仍然分给各 worker。
+ *
+ * 19. **Worker Classes (专用 worker 与操作系统调度)**:
+ *     - 构造时传入 `WorkerClasses`: `reserved` 个专用 worker 只从 High 的共享通道和各 worker 队列的 High 级别取任务，
+ *       从不执行 Normal / Low，于是普通 worker 全部被长任务占满时 High 仍然马上有人执行。
+ *     - 两类 worker 启动时各自应用 `ThreadSchedParams`: SCHED_FIFO (没有权限时退回 nice)、nice、CPU 亲和性
+ *       (只在 cgroup cpuset 允许的 CPU 内收窄)。专用 worker 有自己的休眠者登记，只被 High 任务唤醒。
+ *     - 专用 worker 不参与 resize；`stats().reserved_workers` 是它们的计数，执行数同时计入 High。
+ *
+ * 20. **Timers (延迟与周期任务)**:
+ *     - 与 ThreadPoolFast 相同: `submit_after` / `submit_at` / `post_after` / `submit_every` 挂进分层时间轮，
+ *       定时器线程到期时把同一优先级的任务整批放进各 worker 队列 (每级一个 tag)，`cancel_timer` O(1) 取消。
  */
-class ThreadPoolPriority {
+template <size_t Levels>
+class BasicThreadPoolPriority {
+    // 位图的第 0 位留给 EDF 堆，其余每级一位
+    static_assert(Levels >= 1 && Levels <= 63,
+                  "BasicThreadPoolPriority supports 1 to 63 levels");
+
    public:
-    explicit ThreadPoolPriority(
-        size_t num_threads = std::thread::hardware_concurrency());
-    ~ThreadPoolPriority();
+    // 优先级级别数
+    static constexpr size_t kLevels = Levels;
 
-    ThreadPoolPriority(const ThreadPoolPriority&) = delete;
-    ThreadPoolPriority& operator=(const ThreadPoolPriority&) = delete;
+    /**
+     * @param max_threads `resize` 能达到的最大线程数，0 表示
+     *        max(num_threads, hardware_concurrency)
+     */
+    explicit BasicThreadPoolPriority(
+        size_t num_threads = std::thread::hardware_concurrency(),
+        size_t max_threads = 0)
+        : BasicThreadPoolPriority(num_threads, max_threads, WorkerClasses{}) {}
+
+    /**
+     * @param classes 专用 worker 数 (不计入 num_threads / max_threads) 和两类 worker 的调度参数
+     */
+    BasicThreadPoolPriority(size_t num_threads, size_t max_threads,
+                            WorkerClasses classes);
+    ~BasicThreadPoolPriority();
+
+    BasicThreadPoolPriority(const BasicThreadPoolPriority&) = delete;
+    BasicThreadPoolPriority& operator=(const BasicThreadPoolPriority&) = delete;
 
     /**
      * @brief 提交带优先级的任务
-     * 
+     *
      * @param prio 任务优先级
      * @param f 函数对象
      * @param args 函数参数
-     * @return std::future<返回值类型>
+     * @return Future<返回值类型>
      */
     template <typename F, typename... Args>
         requires std::invocable<F, Args...>
     auto submit(Priority prio, F&& f, Args&&... args)
-        -> std::future<typename std::invoke_result_t<F, Args...>>;
+        -> Future<std::invoke_result_t<F, Args...>>;
 
     // 为了兼容性，提供默认优先级的重载（默认 Normal）
     template <typename F, typename... Args>
         requires std::invocable<F, Args...>
     auto submit(F&& f, Args&&... args)
-        -> std::future<typename std::invoke_result_t<F, Args...>> {
+        -> Future<std::invoke_result_t<F, Args...>> {
         return submit(Priority::Normal, std::forward<F>(f),
                       std::forward<Args>(args)...);
     }
 
+    /**
+     * @brief 以指定优先级提交一个不需要结果的任务 (fire-and-forget)
+     *
+     * 不分配共享状态，也不返回 Future。任务抛出的异常交给 `set_exception_handler`
+     * 设置的处理函数；没有设置时 std::terminate。
+     */
+    template <typename F, typename... Args>
+        requires std::invocable<F, Args...>
+    void post(Priority prio, F&& f, Args&&... args);
+
+    template <typename F, typename... Args>
+        requires std::invocable<F, Args...>
+    void post(F&& f, Args&&... args) {
+        post(Priority::Normal, std::forward<F>(f), std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief 提交带截止时间的任务: 按截止时间最早优先 (EDF) 调度，排在所有优先级之前
+     *
+     * 开始执行时已经过了 deadline 的任务不会执行，Future 收到 `DeadlineExceeded`。
+     * 返回的 Future 的 then() 回调以 High 优先级回到本池。
+     */
+    template <typename F, typename... Args>
+        requires std::invocable<F, Args...>
+    auto submit_by(Deadline deadline, F&& f, Args&&... args)
+        -> Future<std::invoke_result_t<F, Args...>>;
+
+    // 带截止时间的 fire-and-forget: 过期时 `DeadlineExceeded` 交给 set_exception_handler 的处理函数
+    template <typename F, typename... Args>
+        requires std::invocable<F, Args...>
+    void post_by(Deadline deadline, F&& f, Args&&... args);
+
+    /**
+     * @brief 在 delay 之后以指定优先级提交任务 (等待期间不占用 worker)
+     *
+     * 到期时刻按定时器的 tick (1ms) 向上取整，不会提前执行。等待的时间不计入延迟统计。
+     */
+    template <typename F, typename... Args>
+        requires std::invocable<F, Args...>
+    auto submit_after(Priority prio, TimerClock::duration delay, F&& f,
+                      Args&&... args)
+        -> Future<std::invoke_result_t<F, Args...>> {
+        return submit_at(prio, TimerClock::now() + delay, std::forward<F>(f),
+                         std::forward<Args>(args)...);
+    }
+
+    // 在 when 时刻以指定优先级提交任务，已经过去的时刻在下一个 tick 提交
+    template <typename F, typename... Args>
+        requires std::invocable<F, Args...>
+    auto submit_at(Priority prio, TimerClock::time_point when, F&& f,
+                   Args&&... args) -> Future<std::invoke_result_t<F, Args...>>;
+
+    // 延迟提交一个不需要结果的任务，返回的编号可以用 cancel_timer 取消
+    template <typename F, typename... Args>
+        requires std::invocable<F, Args...>
+    TimerId post_after(Priority prio, TimerClock::duration delay, F&& f,
+                       Args&&... args);
+
+    /**
+     * @brief 每隔 period 以指定优先级执行一次 f (第一次在 period 之后)，直到 cancel_timer
+     *
+     * 上一次还没执行完时跳过这个周期。异常交给 `set_exception_handler` 设置的处理函数。
+     */
+    template <typename F>
+        requires std::invocable<std::decay_t<F>&>
+    TimerId submit_every(Priority prio, TimerClock::duration period, F&& f);
+
+    // 取消 post_after / submit_every 的定时器，取消前还没到期时返回 true
+    bool cancel_timer(TimerId id) { return timers_.cancel(id); }
+
+    // 还没到期的定时器数 (周期任务算一个)
+    size_t pending_timers() const { return timers_.pending(); }
+
+    // 某个优先级的执行器: then() 回调经由它以该优先级回到本池
+    Executor* executor(Priority prio = Priority::Normal) {
+        return &executors_[priority_index(prio)];
+    }
+
+    // 设置 post() 任务的异常处理函数，可以随时替换
+    void set_exception_handler(ExceptionSink::Handler handler) {
+        errors_.set(std::move(handler));
+    }
+
+    /**
+     * @brief 以指定优先级批量提交: 执行 fn(0), fn(1), ..., fn(count - 1)
+     * @return Future<void> 整批完成时就绪；任意任务抛异常时 get() 重新抛出第一个异常
+     */
+    template <typename F>
+        requires std::invocable<F&, size_t>
+    Future<void> submit_n(Priority prio, size_t count, F&& fn);
+
+    template <typename F>
+        requires std::invocable<F&, size_t>
+    Future<void> submit_n(size_t count, F&& fn) {
+        return submit_n(Priority::Normal, count, std::forward<F>(fn));
+    }
+
+    /**
+     * @brief 以指定优先级批量提交一组无参可调用对象
+     *
+     * 右值范围中的元素会被移动，左值范围中的元素会被拷贝。
+     */
+    template <std::ranges::sized_range R>
+        requires std::invocable<std::ranges::range_value_t<R>&>
+    Future<void> submit_bulk(Priority prio, R&& range);
+
+    template <std::ranges::sized_range R>
+        requires std::invocable<std::ranges::range_value_t<R>&>
+    Future<void> submit_bulk(R&& range) {
+        return submit_bulk(Priority::Normal, std::forward<R>(range));
+    }
+
+    /**
+     * @brief 当前线程在本线程池中的 worker 编号
+     * @return 不是本池的 worker 线程时返回 std::nullopt
+     */
+    std::optional<size_t> current_worker_index() const {
+        if (detail::tls_priority_worker.pool == this)
+            return detail::tls_priority_worker.index;
+        return std::nullopt;
+    }
+
+    // 当前活跃的 worker 数
+    size_t size() const { return active_.load(std::memory_order_relaxed); }
+
+    // resize 能达到的最大 worker 数
+    size_t capacity() const { return queues_.size(); }
+
+    // 只执行 High 的专用 worker 数 (构造后不变)
+    size_t reserved_workers() const { return classes_.reserved; }
+
+    /**
+     * @brief 运行时调整 worker 数量 (限制在 [1, capacity()] 内)
+     *
+     * 缩容时被退役的 worker 执行完手头的任务后，把剩余任务按原优先级转交给活跃的 worker。
+     */
+    void resize(size_t num_threads);
+
+    // 开启自动伸缩，策略见 ElasticPolicy。再次调用会替换旧策略
+    void enable_auto_resize(ElasticPolicy policy = {});
+
+    void disable_auto_resize();
+
+    /**
+     * @brief 汇总所有 worker 的统计计数，按优先级的向量有 Levels 项 (下标 0 最高)
+     *
+     * 计数是累计值；队列深度是调用时的采样值。
+     */
+    PoolStats stats();
+
+    // 开启/关闭任务延迟统计 (默认关闭)，只影响之后提交的任务
+    void set_latency_tracking(bool enabled) {
+        latency_tracking_.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool latency_tracking() const {
+        return latency_tracking_.load(std::memory_order_relaxed);
+    }
+
+    // 合并所有 worker 的直方图，`by_priority` 有 Levels 项 (下标 0 最高)
+    PoolLatency latency() const;
+
+    /**
+     * @brief 设置空闲 worker 的等待方式，可以随时切换 (已休眠的 worker 会被唤醒，按新策略重新等待)
+     */
+    void set_idle_policy(IdlePolicy policy);
+
+    IdlePolicy idle_policy() const {
+        return {idle_strategy_.load(std::memory_order_relaxed),
+                spin_rounds_.load(std::memory_order_relaxed)};
+    }
+
+    /**
+     * @brief 设置一次窃取最多搬走的任务数 (实际数量不超过受害者队列的一半)
+     * @param max_tasks 1 表示每次只偷一个任务；0 按 1 处理
+     */
+    void set_steal_batch(size_t max_tasks) {
+        steal_batch_.store(max_tasks == 0 ? 1 : max_tasks,
+                           std::memory_order_relaxed);
+    }
+
+    size_t steal_batch() const {
+        return steal_batch_.load(std::memory_order_relaxed);
+    }
+
+    // 设置防饥饿策略，可以随时切换 (worker 每次取任务时读取)
+    void set_aging_policy(AgingPolicy policy) {
+        aging_max_bypass_.store(policy.max_bypass, std::memory_order_relaxed);
+    }
+
+    AgingPolicy aging_policy() const {
+        return {aging_max_bypass_.load(std::memory_order_relaxed)};
+    }
+
+    // 每个共享通道的容量
+    static constexpr size_t kSharedLaneCapacity = 256;
+
+    /**
+     * @brief 设置走共享通道的级别数: 第 0 .. levels-1 级的单个提交进入共享通道
+     * @param levels 0 表示关闭 (所有任务都轮询分给 worker)，超过 Levels 按 Levels 处理。默认 1 (只有 High)
+     */
+    void set_shared_levels(size_t levels);
+
+    size_t shared_levels() const {
+        return shared_levels_.load(std::memory_order_relaxed);
+    }
+
    private:
+    // worker 的生命周期状态，含义与 ThreadPoolFast 相同
+    enum class WorkerState : int { Stopped, Running, Retiring, Draining };
+
     void worker_thread(size_t index);
 
+    // 退役: 关闭自己的队列，剩余任务按原优先级转交给活跃的 worker
+    void drain_worker(size_t index);
+
+    // 专用 worker 的主循环: 只执行第 0 级的任务
+    void reserved_worker_thread(size_t index);
+
+    // 给自动伸缩用的负载采样
+    LoadSample sample_load();
+
+    // 开启延迟统计时返回提交时刻，否则返回 0 (任务不包装)
+    uint64_t submit_stamp() const {
+        return latency_tracking() ? latency_now() : 0;
+    }
+
+    // 选择提交目标队列: worker 线程选自己，外部线程按私有游标轮询
+    size_t pick_queue();
+
+    // 外部提交者的下一个目标队列 (thread_local 轮询游标)
+    size_t next_external_queue();
+
+    // 批量入队: 依次调用 make_task(0..count-1) 生成任务，每个队列只加一次锁
+    template <typename MakeTask>
+    void enqueue_bulk(Priority prio, size_t count, MakeTask&& make_task);
+
+    // 单个任务入队 (跳过已退役的队列) 并唤醒一个休眠者
+    void push_task(Priority prio, InlineTask task);
+
+    // 带截止时间的任务放进目标队列的 EDF 堆，并唤醒一个休眠者
+    void push_deadline_task(uint64_t deadline, InlineTask task);
+
+    // 绑定了优先级的执行器 (then() 回调入队用)
+    class LevelExecutor final : public Executor {
+       public:
+        void schedule(InlineTask task) override;
+
+        BasicThreadPoolPriority* pool = nullptr;
+        Priority prio = Priority::Normal;
+    };
+
+    // 休眠前的再检查: 任意队列或共享通道中是否还有任务
+    bool has_pending_work();
+
+    // 专用 worker 休眠前的再检查: 只看第 0 级 (共享通道和各队列的位图)
+    bool has_urgent_work();
+
+    // 唤醒一个休眠的 worker；第 0 级的任务同时唤醒一个专用 worker
+    void notify_level(int p, size_t count = 1) {
+        parker_.notify(count);
+        if (p == 0 && classes_.reserved > 0) {
+            reserved_parker_.notify(count);
+        }
+    }
+
+    // 不加锁地看一眼共享通道: 第 p 位表示第 p 级的通道非空
+    uint64_t pending_lanes() const;
+
+    // 越界的优先级按 Normal 处理 (只有一级时按唯一的那一级)
+    static int priority_index(Priority prio) {
+        constexpr int kFallback =
+            std::min(static_cast<int>(Priority::Normal),
+                     static_cast<int>(Levels) - 1);
+        int p_idx = static_cast<int>(prio);
+        if (p_idx < 0 || p_idx >= static_cast<int>(Levels)) {
+            p_idx = kFallback;
+        }
+        return p_idx;
+    }
+
+    // EDF 堆的元素
+    struct DeadlineEntry {
+        uint64_t deadline;
+        uint64_t seq;
+        InlineTask task;
+
+        // std::push_heap 默认是大顶堆: “更大”表示截止时间更晚
+        bool operator<(const DeadlineEntry& other) const {
+            return deadline != other.deadline ? deadline > other.deadline
+                                              : seq > other.seq;
+        }
+    };
+
+    // 非空位图: 第 0 位是 EDF 堆，第 p + 1 位是第 p 级。
+    // countr_zero 越小越紧迫，所以可以直接比较两个队列谁的任务更急
+    static constexpr uint64_t kDeadlineBit = 1;
+
+    static constexpr uint64_t level_bit(int p) { return uint64_t{2} << p; }
+
     // 对齐到 Cache Line (64 bytes) 避免 False Sharing
     struct alignas(64) WorkQueue {
-        // 多级队列：idx 0=High, 1=Normal, 2=Low
-        // 使用定长数组管理不同优先级的 deque
-        std::deque<std::function<void()>>
-            queues[static_cast<int>(Priority::Count)];
+        // 非空位图: 只在持有 mtx 时修改，窃取者和休眠前的再检查不加锁读取
+        std::atomic<uint64_t> nonempty{0};
+
+        // 多级队列：idx 0 最高 (默认三级时 0=High, 1=Normal, 2=Low)
+        // 使用定长数组管理不同优先级的环形队列 (两端都可弹出)
+        RingQueue<InlineTask> queues[Levels];
+
+        // 截止时间任务的小顶堆 (堆顶是最早的截止时间)，排在所有优先级之前
+        std::vector<DeadlineEntry> deadlines;
+        uint64_t next_seq = 0;    // 截止时间相同时按提交顺序
+
+        bool retired = false;    // owner 已退役，不再接收新任务
+        std::mutex mtx;          // 保护该线程的所有优级队列、EDF 堆、retired 和 nonempty 的写入
+    };
+
+    // 设置/清除 queue 位图中的 bit (调用者持有 queue.mtx，读-改-写不需要原子指令)
+    static void publish(WorkQueue& queue, uint64_t bit, bool has_tasks) {
+        uint64_t mask = queue.nonempty.load(std::memory_order_relaxed);
+        queue.nonempty.store(has_tasks ? mask | bit : mask & ~bit,
+                             std::memory_order_relaxed);
+    }
 
-        std::mutex mtx;    // 保护该线程的所有优级队列
+    // 把 entry 放进 queue 的 EDF 堆 (调用者持有 queue.mtx)
+    static void push_deadline(WorkQueue& queue, DeadlineEntry entry);
+
+    // 取出 queue 中截止时间最早的任务 (调用者持有 queue.mtx，堆非空)
+    static DeadlineEntry pop_deadline(WorkQueue& queue);
+
+    // 槽位数等于容量，构造后不再改变；并发的提交者/窃取者只访问 [0, active_) 内的槽位
+    // 每个 worker 的统计计数 (按优先级的执行数紧跟在通用计数之后，同一个 worker 写)
+    struct WorkerStatsSlot {
+        WorkerCounters common;
+        StatCounter executed[Levels];
+        StatCounter bypassed[Levels];
+        StatCounter promoted[Levels];
+        StatCounter deadline_executed;
     };
 
+    // 每个级别被当前 worker 连续越过的次数 (worker 线程的局部变量)
+    using LevelBypass = std::array<uint32_t, Levels>;
+
+    // 从非空级别的位图 levels (第 p 位是第 p 级) 中选择要取的级别，levels 为 0 时返回 -1。
+    // 关闭防饥饿时就是最低的位。只做选择，不修改计数
+    int pick_level(uint64_t levels, const LevelBypass& bypass) const;
+
+    // 真正取到第 p 级的任务之后再记账: 被提前的级别清零，被越过的级别各加一
+    void charge_level(uint64_t levels, int p, LevelBypass& bypass,
+                      WorkerStatsSlot& counters);
+
+    // 取第 p 级的任务: 先看共享通道，再看 queue 的本地队列 (调用者持有 queue.mtx，或者 queue 为 nullptr)
+    bool pop_level(WorkQueue* queue, int p, InlineTask& task);
+
+    // 按 pick_level 的顺序取 levels 中的任务。某一级取不到 (通道的快照已经过时) 时
+    // 把它从位图中去掉再选一次，全部落空才返回 false
+    bool take_level(WorkQueue* queue, uint64_t levels, LevelBypass& bypass,
+                    WorkerStatsSlot& counters, InlineTask& task, int& level);
+
+    // 专用 worker 取一个第 0 级的任务: 先看共享通道，再从 start 开始取各队列中最早的 High 任务
+    bool take_urgent(size_t start, InlineTask& task, WorkerStatsSlot& counters);
+
     std::vector<std::unique_ptr<WorkQueue>> queues_;
     std::vector<std::thread> threads_;
+    std::vector<std::atomic<WorkerState>> states_;
+    std::vector<WorkerStatsSlot> counters_;
+
+    // 每个 worker、每个优先级一组延迟直方图，只由该 worker 写入
+    using LevelRecorders = std::array<LatencyRecorder, Levels>;
+    std::vector<LevelRecorders> latency_;
+    std::atomic<bool> latency_tracking_{false};
+
+    ExceptionSink errors_;    // post() 任务的异常处理
+    TimerService timers_;     // 延迟/周期任务，tag 是优先级
+    detail::DeadlineCounters deadline_counters_;    // 错过截止时间的统计
+
+    std::array<LevelExecutor, Levels> executors_;
+    std::atomic<size_t> active_{0};
+    std::mutex resize_mtx_;    // 串行化 resize
+    std::unique_ptr<AutoScaler> scaler_;
     std::atomic<bool> stop_{false};
-    std::mutex global_mtx_;
-    std::condition_variable global_cv_;
+    std::atomic<size_t> producer_seed_{0};    // 新提交者的起始队列种子
+    std::atomic<size_t> steal_batch_{32};     // 一次窃取最多搬走的任务数
+    std::atomic<IdleStrategy> idle_strategy_{IdleStrategy::Park};
+    std::atomic<uint32_t> spin_rounds_{128};    // 空闲策略的自旋预算
+    std::atomic<uint32_t> aging_max_bypass_{0};    // 防饥饿策略，0 为关闭
+
+    // 每级一个共享通道，由 set_shared_levels 按需创建，之后一直保留到析构
+    using SharedLane = MpmcQueue<InlineTask>;
+    std::array<std::unique_ptr<SharedLane>, Levels> lanes_;
+    std::atomic<size_t> shared_levels_{0};    // 新提交进入通道的级别数
+    std::atomic<size_t> lane_count_{0};       // 已创建的通道数 (只增不减，worker 扫描到这里)
+    WorkerParker parker_;    // 空闲 worker 的休眠/唤醒
+
+    // 专用 worker: 构造时启动，析构时退出，各自的计数和 High 的延迟直方图
+    const WorkerClasses classes_;
+    std::vector<WorkerStatsSlot> reserved_counters_;
+    std::vector<LatencyRecorder> reserved_latency_;
+    std::vector<std::thread> reserved_threads_;
+    WorkerParker reserved_parker_;    // 专用 worker 单独休眠，只被第 0 级的任务唤醒
 };
 
+// High / Normal / Low 三级的线程池
+using ThreadPoolPriority =
+    BasicThreadPoolPriority<static_cast<size_t>(Priority::Count)>;
+
+// 三级版本在 thread_pool_priority.cpp 中显式实例化
+extern template class BasicThreadPoolPriority<
+    static_cast<size_t>(Priority::Count)>;
+
 // 模板实现
+template <size_t Levels>
+BasicThreadPoolPriority<Levels>::BasicThreadPoolPriority(size_t num_threads,
+                                                         size_t max_threads,
+                                                         WorkerClasses classes)
+    : threads_(std::max({num_threads,
+                         max_threads ? max_threads
+                                     : std::thread::hardware_concurrency(),
+                         size_t{1}})),
+      states_(threads_.size()),
+      counters_(threads_.size()),
+      latency_(threads_.size()),
+      timers_(static_cast<uint32_t>(Levels),
+              [this](uint32_t p, std::vector<InlineTask>& due) {
+                  enqueue_bulk(static_cast<Priority>(p), due.size(),
+                               [&](size_t i) -> InlineTask&& {
+                                   return std::move(due[i]);
+                               });
+              }),
+      classes_(std::move(classes)),
+      reserved_counters_(classes_.reserved),
+      reserved_latency_(classes_.reserved) {
+    // 队列按容量一次性分配，地址固定，resize 时复用
+    for (size_t i = 0; i < threads_.size(); ++i) {
+        queues_.push_back(std::make_unique<WorkQueue>());
+    }
+    for (size_t i = 0; i < executors_.size(); ++i) {
+        executors_[i].pool = this;
+        executors_[i].prio = static_cast<Priority>(i);
+    }
+    set_shared_levels(1);
+    resize(num_threads);
+    for (size_t r = 0; r < classes_.reserved; ++r) {
+        reserved_threads_.emplace_back(
+            [this, r] { reserved_worker_thread(r); });
+    }
+}
+
+template <size_t Levels>
+BasicThreadPoolPriority<Levels>::~BasicThreadPoolPriority() {
+    scaler_.reset();
+    timers_.shutdown();
+    stop_.store(true, std::memory_order_release);
+    parker_.notify_all();
+    reserved_parker_.notify_all();
+    for (auto& thread : threads_) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    for (auto& thread : reserved_threads_) {
+        thread.join();
+    }
+    // 尚未执行的任务在其他成员还有效时析构 (被丢弃的 Promise 可能触发 then() 回调)
+    for (size_t p = 0; p < lane_count_.load(std::memory_order_acquire); ++p) {
+        while (lanes_[p]->try_pop()) {
+        }
+    }
+    queues_.clear();
+}
+
+template <size_t Levels>
 template <typename F, typename... Args>
     requires std::invocable<F, Args...>
-auto ThreadPoolPriority::submit(Priority prio, F&& f, Args&&... args)
-    -> std::future<typename std::invoke_result_t<F, Args...>> {
-    using return_type = typename std::invoke_result_t<F, Args...>;
+auto BasicThreadPoolPriority<Levels>::submit(Priority prio, F&& f,
+                                             Args&&... args)
+    -> Future<std::invoke_result_t<F, Args...>> {
+    auto [task, res] = package_timed_task(submit_stamp(), std::forward<F>(f),
+                                          std::forward<Args>(args)...);
 
-    auto task = std::make_shared<std::packaged_task<return_type()>>(
-        std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+    push_task(prio, std::move(task));
+    return std::move(res).via(executor(prio));
+}
 
-    std::future<return_type> res = task->get_future();
+template <size_t Levels>
+template <typename F, typename... Args>
+    requires std::invocable<F, Args...>
+void BasicThreadPoolPriority<Levels>::post(Priority prio, F&& f,
+                                           Args&&... args) {
+    using Fn = decltype(detail::bind_call(std::forward<F>(f),
+                                          std::forward<Args>(args)...));
 
-    // 简单的 Round-Robin 分发策略，也可以优化为“分发到当前负载最小”或“当前线程”
-    static std::atomic<size_t> current_queue_index{0};
-    size_t index = current_queue_index.fetch_add(1, std::memory_order_relaxed) %
-                   queues_.size();
+    push_task(prio, detail::make_timed_task(
+                        detail::PostedCall<Fn>{
+                            detail::bind_call(std::forward<F>(f),
+                                              std::forward<Args>(args)...),
+                            &errors_},
+                        submit_stamp()));
+}
 
-    {
+template <size_t Levels>
+template <typename F, typename... Args>
+    requires std::invocable<F, Args...>
+auto BasicThreadPoolPriority<Levels>::submit_by(Deadline deadline, F&& f,
+                                                Args&&... args)
+    -> Future<std::invoke_result_t<F, Args...>> {
+    using Fn = decltype(detail::bind_call(std::forward<F>(f),
+                                          std::forward<Args>(args)...));
+
+    uint64_t due = detail::deadline_ns(deadline);
+    auto [task, res] = package_task(detail::DeadlineCall<Fn>{
+        detail::bind_call(std::forward<F>(f), std::forward<Args>(args)...),
+        due, &deadline_counters_});
+
+    push_deadline_task(due, std::move(task));
+    return std::move(res).via(executor(Priority::High));
+}
+
+template <size_t Levels>
+template <typename F, typename... Args>
+    requires std::invocable<F, Args...>
+void BasicThreadPoolPriority<Levels>::post_by(Deadline deadline, F&& f,
+                                              Args&&... args) {
+    using Fn = decltype(detail::bind_call(std::forward<F>(f),
+                                          std::forward<Args>(args)...));
+    using Call = detail::DeadlineCall<Fn>;
+
+    uint64_t due = detail::deadline_ns(deadline);
+    push_deadline_task(
+        due, InlineTask(detail::PostedCall<Call>{
+                 Call{detail::bind_call(std::forward<F>(f),
+                                        std::forward<Args>(args)...),
+                      due, &deadline_counters_},
+                 &errors_}));
+}
+
+template <size_t Levels>
+template <typename F, typename... Args>
+    requires std::invocable<F, Args...>
+auto BasicThreadPoolPriority<Levels>::submit_at(Priority prio,
+                                                TimerClock::time_point when,
+                                                F&& f, Args&&... args)
+    -> Future<std::invoke_result_t<F, Args...>> {
+    auto [task, res] =
+        package_task(std::forward<F>(f), std::forward<Args>(args)...);
+    timers_.add(when, static_cast<uint32_t>(priority_index(prio)),
+                std::move(task));
+    return std::move(res).via(executor(prio));
+}
+
+template <size_t Levels>
+template <typename F, typename... Args>
+    requires std::invocable<F, Args...>
+TimerId BasicThreadPoolPriority<Levels>::post_after(
+    Priority prio, TimerClock::duration delay, F&& f, Args&&... args) {
+    using Fn = decltype(detail::bind_call(std::forward<F>(f),
+                                          std::forward<Args>(args)...));
+
+    return timers_.add(
+        TimerClock::now() + delay, static_cast<uint32_t>(priority_index(prio)),
+        detail::PostedCall<Fn>{detail::bind_call(std::forward<F>(f),
+                                                 std::forward<Args>(args)...),
+                               &errors_});
+}
+
+template <size_t Levels>
+template <typename F>
+    requires std::invocable<std::decay_t<F>&>
+TimerId BasicThreadPoolPriority<Levels>::submit_every(
+    Priority prio, TimerClock::duration period, F&& f) {
+    return timers_.add_periodic(
+        period, static_cast<uint32_t>(priority_index(prio)),
+        detail::PostedCall<std::decay_t<F>>{std::forward<F>(f), &errors_});
+}
+
+template <size_t Levels>
+template <typename F>
+    requires std::invocable<F&, size_t>
+Future<void> BasicThreadPoolPriority<Levels>::submit_n(Priority prio,
+                                                       size_t count, F&& fn) {
+    using Fn = std::decay_t<F>;
+    using Call = detail::IndexedCall<Fn>;
+
+    if (count == 0) {
+        return make_ready_future().via(executor(prio));
+    }
+
+    auto* batch = new detail::IndexedBatch<Fn>(count, std::forward<F>(fn));
+    Future<void> res = batch->get_future();
+
+    uint64_t submitted = submit_stamp();
+    enqueue_bulk(prio, count, [batch, submitted](size_t i) {
+        return detail::make_timed_task(
+            detail::BatchItem<Call>(batch, Call{batch, i}), submitted);
+    });
+    return std::move(res).via(executor(prio));
+}
+
+template <size_t Levels>
+template <std::ranges::sized_range R>
+    requires std::invocable<std::ranges::range_value_t<R>&>
+Future<void> BasicThreadPoolPriority<Levels>::submit_bulk(Priority prio,
+                                                          R&& range) {
+    using Body = std::ranges::range_value_t<R>;
+
+    size_t count = static_cast<size_t>(std::ranges::size(range));
+    if (count == 0) {
+        return make_ready_future().via(executor(prio));
+    }
+
+    auto* batch = new detail::BatchCompletion(count);
+    Future<void> res = batch->get_future();
+
+    auto it = std::ranges::begin(range);
+    uint64_t submitted = submit_stamp();
+    enqueue_bulk(prio, count, [&](size_t) {
+        if constexpr (std::is_lvalue_reference_v<R>) {
+            return detail::make_timed_task(
+                detail::BatchItem<Body>(batch, Body(*it++)), submitted);
+        } else {
+            return detail::make_timed_task(
+                detail::BatchItem<Body>(batch, Body(std::move(*it++))),
+                submitted);
+        }
+    });
+    return std::move(res).via(executor(prio));
+}
+
+template <size_t Levels>
+template <typename MakeTask>
+void BasicThreadPoolPriority<Levels>::enqueue_bulk(Priority prio, size_t count,
+                                                   MakeTask&& make_task) {
+    int p_idx = priority_index(prio);
+
+    if (detail::tls_priority_worker.pool == this) {
+        // worker 内部的批量提交: 一次加锁全部放进自己的队列，空闲线程会来窃取
+        WorkQueue& queue = *queues_[detail::tls_priority_worker.index];
+        std::lock_guard<std::mutex> lock(queue.mtx);
+        for (size_t i = 0; i < count; ++i) {
+            queue.queues[p_idx].push_back(InlineTask(make_task(i)));
+        }
+        publish(queue, level_bit(p_idx), true);
+    } else {
+        // 外部批量提交: 切成 chunks 块，分给连续的若干个队列，每个队列只加一次锁
+        size_t num_queues = active_.load(std::memory_order_acquire);
+        size_t chunks = std::min(count, num_queues);
+        size_t start = next_external_queue();
+        size_t begin = 0;
+        for (size_t c = 0, skip = 0; c < chunks;) {
+            WorkQueue& queue = *queues_[(start + c + skip) % num_queues];
+            std::lock_guard<std::mutex> lock(queue.mtx);
+            if (queue.retired) {
+                ++skip;    // 正在退役，换下一个
+                continue;
+            }
+            size_t end = count * (c + 1) / chunks;
+            for (; begin < end; ++begin) {
+                queue.queues[p_idx].push_back(InlineTask(make_task(begin)));
+            }
+            publish(queue, level_bit(p_idx), true);
+            ++c;
+        }
+    }
+
+    notify_level(p_idx, count);
+}
+
+template <size_t Levels>
+void BasicThreadPoolPriority<Levels>::resize(size_t num_threads) {
+    std::lock_guard<std::mutex> lock(resize_mtx_);
+    num_threads = std::clamp<size_t>(num_threads, 1, capacity());
+    size_t active = active_.load(std::memory_order_relaxed);
+
+    if (num_threads > active) {
+        // 扩容: 还没来得及退出的 worker 直接撤销退役，其余槽位启动新线程。
+        // 队列早已分配好，可以先公开新的活跃范围: 提交到还没启动的 worker 的任务
+        // 会在它启动后被执行 (或者被别的 worker 偷走)
+        std::vector<size_t> slots;
+        for (size_t i = active; i < num_threads; ++i) {
+            WorkerState expected = WorkerState::Retiring;
+            if (states_[i].compare_exchange_strong(expected,
+                                                   WorkerState::Running)) {
+                continue;
+            }
+            if (threads_[i].joinable()) {
+                threads_[i].join();
+            }
+            {
+                std::lock_guard<std::mutex> queue_lock(queues_[i]->mtx);
+                queues_[i]->retired = false;
+            }
+            states_[i].store(WorkerState::Running, std::memory_order_relaxed);
+            slots.push_back(i);
+        }
+        active_.store(num_threads, std::memory_order_release);
+        for (size_t i : slots) {
+            threads_[i] = std::thread([this, i] { worker_thread(i); });
+        }
+    } else if (num_threads < active) {
+        // 缩容: 先缩小可见范围，再通知 worker 退役 (正在休眠的需要叫醒)
+        active_.store(num_threads, std::memory_order_release);
+        for (size_t i = num_threads; i < active; ++i) {
+            states_[i].store(WorkerState::Retiring, std::memory_order_release);
+        }
+        parker_.notify_all();
+    }
+}
+
+template <size_t Levels>
+void BasicThreadPoolPriority<Levels>::enable_auto_resize(ElasticPolicy policy) {
+    if (policy.max_threads == 0 || policy.max_threads > capacity()) {
+        policy.max_threads = capacity();
+    }
+    policy.min_threads = std::clamp<size_t>(policy.min_threads, 1,
+                                            policy.max_threads);
+
+    scaler_.reset();
+    scaler_ = std::make_unique<AutoScaler>(
+        policy, [this] { return sample_load(); },
+        [this](size_t n) { resize(n); });
+}
+
+template <size_t Levels>
+void BasicThreadPoolPriority<Levels>::disable_auto_resize() {
+    scaler_.reset();
+}
+
+template <size_t Levels>
+PoolStats BasicThreadPoolPriority<Levels>::stats() {
+    PoolStats stats;
+    stats.workers.resize(capacity());
+    stats.executed_by_priority.resize(Levels);
+    stats.bypassed_by_priority.resize(Levels);
+    stats.promoted_by_priority.resize(Levels);
+    for (size_t i = 0; i < capacity(); ++i) {
+        WorkerStats& worker = stats.workers[i];
+        worker = counters_[i].common.snapshot();
+        for (size_t p = 0; p < Levels; ++p) {
+            stats.executed_by_priority[p] += counters_[i].executed[p].load();
+            stats.bypassed_by_priority[p] += counters_[i].bypassed[p].load();
+            stats.promoted_by_priority[p] += counters_[i].promoted[p].load();
+        }
+        stats.deadline_executed += counters_[i].deadline_executed.load();
+        {
+            std::lock_guard<std::mutex> lock(queues_[i]->mtx);
+            for (auto& level : queues_[i]->queues) {
+                worker.queue_depth += level.size();
+            }
+            worker.queue_depth += queues_[i]->deadlines.size();
+        }
+        stats.total += worker;
+    }
+    for (size_t p = 0; p < lane_count_.load(std::memory_order_acquire); ++p) {
+        stats.total.queue_depth += lanes_[p]->size();
+    }
+    stats.reserved_workers.resize(reserved_counters_.size());
+    for (size_t r = 0; r < reserved_counters_.size(); ++r) {
+        stats.reserved_workers[r] = reserved_counters_[r].common.snapshot();
+        stats.executed_by_priority[0] +=
+            reserved_counters_[r].executed[0].load();
+        stats.total += stats.reserved_workers[r];
+    }
+    stats.deadline_expired =
+        deadline_counters_.expired.load(std::memory_order_relaxed);
+    stats.deadline_late =
+        deadline_counters_.late.load(std::memory_order_relaxed);
+    return stats;
+}
+
+template <size_t Levels>
+PoolLatency BasicThreadPoolPriority<Levels>::latency() const {
+    PoolLatency latency;
+    latency.by_priority.resize(Levels);
+    for (const auto& levels : latency_) {
+        for (size_t p = 0; p < Levels; ++p) {
+            latency.by_priority[p].merge(levels[p]);
+        }
+    }
+    for (const auto& recorder : reserved_latency_) {
+        latency.by_priority[0].merge(recorder);
+    }
+    for (const auto& level : latency.by_priority) {
+        latency.total.merge(level);
+    }
+    return latency;
+}
+
+template <size_t Levels>
+LoadSample BasicThreadPoolPriority<Levels>::sample_load() {
+    LoadSample load;
+    load.workers = active_.load(std::memory_order_acquire);
+    load.idle = parker_.idle();
+    for (size_t i = 0; i < load.workers; ++i) {
+        WorkQueue& queue = *queues_[i];
+        // 空队列不加锁
+        if (queue.nonempty.load(std::memory_order_relaxed) == 0) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(queue.mtx);
+        for (auto& level : queue.queues) {
+            load.backlog += level.size();
+        }
+        load.backlog += queue.deadlines.size();
+    }
+    for (size_t p = 0; p < lane_count_.load(std::memory_order_acquire); ++p) {
+        load.backlog += lanes_[p]->size();
+    }
+    return load;
+}
+
+template <size_t Levels>
+size_t BasicThreadPoolPriority<Levels>::pick_queue() {
+    // worker 内部提交: 放回自己的队列，保持数据局部性
+    if (detail::tls_priority_worker.pool == this) {
+        return detail::tls_priority_worker.index;
+    }
+    return next_external_queue();
+}
+
+template <size_t Levels>
+size_t BasicThreadPoolPriority<Levels>::next_external_queue() {
+    // 外部提交: thread_local 游标轮询，提交路径上没有共享写入
+    size_t& next = detail::tls_priority_cursors.get(this, producer_seed_);
+    return next++ % active_.load(std::memory_order_acquire);
+}
+
+template <size_t Levels>
+void BasicThreadPoolPriority<Levels>::push_task(Priority prio,
+                                                InlineTask task) {
+    int p_idx = priority_index(prio);
+    // 紧急级别进入共享通道，任何一个空出来的 worker 都能马上取走；写满时照常放进本地队列
+    if (static_cast<size_t>(p_idx) <
+            shared_levels_.load(std::memory_order_acquire) &&
+        lanes_[p_idx]->try_push(std::move(task))) {
+        notify_level(p_idx);
+        return;
+    }
+    for (size_t index = pick_queue();; index = next_external_queue()) {
+        WorkQueue& queue = *queues_[index];
+        std::lock_guard<std::mutex> lock(queue.mtx);
+        // 刚刚退役的队列不再接收任务，换下一个 (0 号 worker 永不退役)
+        if (!queue.retired) {
+            // 根据优先级放入对应的队列
+            queue.queues[p_idx].push_back(std::move(task));
+            publish(queue, level_bit(p_idx), true);
+            break;
+        }
+    }
+    notify_level(p_idx);
+}
+
+template <size_t Levels>
+void BasicThreadPoolPriority<Levels>::push_deadline_task(uint64_t deadline,
+                                                         InlineTask task) {
+    for (size_t index = pick_queue();; index = next_external_queue()) {
         std::lock_guard<std::mutex> lock(queues_[index]->mtx);
-        // 根据优先级放入对应的队列
-        int p_idx = static_cast<int>(prio);
-        if (p_idx < 0 || p_idx >= static_cast<int>(Priority::Count)) {
-            p_idx = static_cast<int>(Priority::Normal);
+        if (!queues_[index]->retired) {
+            push_deadline(*queues_[index], {deadline, 0, std::move(task)});
+            break;
         }
-        queues_[index]->queues[p_idx].emplace_back([task]() { (*task)(); });
     }
+    parker_.notify();
+}
+
+template <size_t Levels>
+void BasicThreadPoolPriority<Levels>::push_deadline(WorkQueue& queue,
+                                                    DeadlineEntry entry) {
+    entry.seq = queue.next_seq++;
+    queue.deadlines.push_back(std::move(entry));
+    std::push_heap(queue.deadlines.begin(), queue.deadlines.end());
+    publish(queue, kDeadlineBit, true);
+}
+
+template <size_t Levels>
+auto BasicThreadPoolPriority<Levels>::pop_deadline(WorkQueue& queue)
+    -> DeadlineEntry {
+    std::pop_heap(queue.deadlines.begin(), queue.deadlines.end());
+    DeadlineEntry entry = std::move(queue.deadlines.back());
+    queue.deadlines.pop_back();
+    publish(queue, kDeadlineBit, !queue.deadlines.empty());
+    return entry;
+}
 
-    global_cv_.notify_one();
-    return res;
+template <size_t Levels>
+void BasicThreadPoolPriority<Levels>::set_shared_levels(size_t levels) {
+    std::lock_guard<std::mutex> lock(resize_mtx_);
+    levels = std::min(levels, Levels);
+    // 先创建通道再公开: 提交者和 worker 用 acquire 读到计数之后才会访问对应的通道
+    size_t count = lane_count_.load(std::memory_order_relaxed);
+    for (; count < levels; ++count) {
+        lanes_[count] = std::make_unique<SharedLane>(kSharedLaneCapacity);
+    }
+    lane_count_.store(count, std::memory_order_release);
+    // 缩小之后，已经在通道里的任务仍会被取走 (worker 扫描全部已创建的通道)
+    shared_levels_.store(levels, std::memory_order_release);
+}
+
+template <size_t Levels>
+uint64_t BasicThreadPoolPriority<Levels>::pending_lanes() const {
+    uint64_t mask = 0;
+    size_t count = lane_count_.load(std::memory_order_acquire);
+    for (size_t p = 0; p < count; ++p) {
+        if (!lanes_[p]->empty()) {
+            mask |= uint64_t{1} << p;
+        }
+    }
+    return mask;
+}
+
+template <size_t Levels>
+bool BasicThreadPoolPriority<Levels>::pop_level(WorkQueue* queue, int p,
+                                                InlineTask& task) {
+    // 通道的 empty() 只是快照: 数据可能还在写入途中，或者刚被别的 worker 取走
+    if (static_cast<size_t>(p) < lane_count_.load(std::memory_order_acquire)) {
+        if (auto shared = lanes_[p]->try_pop()) {
+            task = std::move(*shared);
+            return true;
+        }
+    }
+    if (queue == nullptr || queue->queues[p].empty()) {
+        return false;
+    }
+    task = std::move(queue->queues[p].front());
+    queue->queues[p].pop_front();
+    publish(*queue, level_bit(p), !queue->queues[p].empty());
+    return true;
+}
+
+template <size_t Levels>
+void BasicThreadPoolPriority<Levels>::set_idle_policy(IdlePolicy policy) {
+    idle_strategy_.store(policy.strategy, std::memory_order_relaxed);
+    spin_rounds_.store(policy.spin_rounds, std::memory_order_relaxed);
+    // 已经休眠的 worker 醒来重新扫描一遍，再按新策略等待
+    parker_.notify_all();
+}
+
+template <size_t Levels>
+void BasicThreadPoolPriority<Levels>::LevelExecutor::schedule(
+    InlineTask task) {
+    // 析构过程中不再调度回调，回调持有的 Promise 会收到 broken_promise
+    if (pool->stop_.load(std::memory_order_acquire)) {
+        return;
+    }
+    pool->push_task(prio, std::move(task));
+}
+
+template <size_t Levels>
+bool BasicThreadPoolPriority<Levels>::has_pending_work() {
+    // 只读位图，不加锁: 提交者在入队 (持有队列锁时更新位图) 之后、读休眠者数量之前有一个
+    // seq_cst 屏障，worker 在登记休眠者之后也有一个。两者之一先发生，所以要么这里看到非空位，
+    // 要么提交者看到我们已经登记并唤醒我们。之后被别人清掉的位说明那个任务已经有人取走了
+    // 共享通道同理: 入队的 CAS 发生在提交者的屏障之前
+    size_t active = active_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < active; ++i) {
+        if (queues_[i]->nonempty.load(std::memory_order_relaxed) != 0) {
+            return true;
+        }
+    }
+    return pending_lanes() != 0;
+}
+
+template <size_t Levels>
+bool BasicThreadPoolPriority<Levels>::has_urgent_work() {
+    // 与 has_pending_work 相同的协议，配对的是 reserved_parker_
+    if (lane_count_.load(std::memory_order_acquire) > 0 &&
+        !lanes_[0]->empty()) {
+        return true;
+    }
+    size_t active = active_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < active; ++i) {
+        if (queues_[i]->nonempty.load(std::memory_order_relaxed) &
+            level_bit(0)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <size_t Levels>
+bool BasicThreadPoolPriority<Levels>::take_urgent(size_t start,
+                                                  InlineTask& task,
+                                                  WorkerStatsSlot& counters) {
+    if (lane_count_.load(std::memory_order_acquire) > 0) {
+        if (auto shared = lanes_[0]->try_pop()) {
+            task = std::move(*shared);
+            return true;
+        }
+    }
+
+    // 共享通道写满或关闭时，High 任务留在各 worker 的本地队列里。
+    // 专用 worker 没有自己的队列，每次只取一个，取最早提交的那个 (队头)
+    size_t num_queues = active_.load(std::memory_order_acquire);
+    for (size_t i = 0; i < num_queues; ++i) {
+        WorkQueue& victim = *queues_[(start + i) % num_queues];
+        if (!(victim.nonempty.load(std::memory_order_relaxed) &
+              level_bit(0))) {
+            continue;
+        }
+        if (!victim.mtx.try_lock()) {
+            counters.common.lock_misses.add();
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(victim.mtx, std::adopt_lock);
+        auto& level = victim.queues[0];
+        if (level.empty()) {
+            continue;
+        }
+        task = std::move(level.front());
+        level.pop_front();
+        publish(victim, level_bit(0), !level.empty());
+        counters.common.steals.add();
+        counters.common.stolen.add();
+        return true;
+    }
+    return false;
+}
+
+template <size_t Levels>
+int BasicThreadPoolPriority<Levels>::pick_level(
+    uint64_t levels, const LevelBypass& bypass) const {
+    if (levels == 0) {
+        return -1;
+    }
+    int first = std::countr_zero(levels);
+
+    // 被越过次数达到上限的低级别先执行 (从最低的级别往上找，最久没轮到的优先)
+    uint32_t max_bypass = aging_max_bypass_.load(std::memory_order_relaxed);
+    if (max_bypass > 0) {
+        for (uint64_t rest = levels & (levels - 1); rest != 0;) {
+            int p = static_cast<int>(std::bit_width(rest)) - 1;
+            if (bypass[p] >= max_bypass) {
+                return p;
+            }
+            rest &= ~(uint64_t{1} << p);
+        }
+    }
+
+    // 严格优先级: 取最高的非空级别
+    return first;
+}
+
+template <size_t Levels>
+void BasicThreadPoolPriority<Levels>::charge_level(uint64_t levels, int p,
+                                                   LevelBypass& bypass,
+                                                   WorkerStatsSlot& counters) {
+    bypass[p] = 0;
+    if (p != std::countr_zero(levels)) {
+        counters.promoted[p].add();
+        return;
+    }
+    // 其余有任务在等的级别各记一次“越过”
+    for (uint64_t rest = levels & (levels - 1); rest != 0; rest &= rest - 1) {
+        int q = std::countr_zero(rest);
+        ++bypass[q];
+        counters.bypassed[q].add();
+    }
+}
+
+template <size_t Levels>
+bool BasicThreadPoolPriority<Levels>::take_level(WorkQueue* queue,
+                                                 uint64_t levels,
+                                                 LevelBypass& bypass,
+                                                 WorkerStatsSlot& counters,
+                                                 InlineTask& task,
+                                                 int& level) {
+    for (int p = pick_level(levels, bypass); p >= 0;
+         p = pick_level(levels, bypass)) {
+        if (pop_level(queue, p, task)) {
+            charge_level(levels, p, bypass, counters);
+            level = p;
+            return true;
+        }
+        levels &= ~(uint64_t{1} << p);
+    }
+    return false;
+}
+
+template <size_t Levels>
+void BasicThreadPoolPriority<Levels>::worker_thread(size_t index) {
+    detail::tls_priority_worker = {this, index};
+    apply_thread_sched(classes_.shared_sched);
+
+    // 线程局部随机数生成器，避免锁竞争
+    std::random_device rd;
+    std::mt19937 rng(rd());
+    // 随机起始点，按当前活跃的 worker 数取模
+    std::uniform_int_distribution<size_t> dist(0, capacity() - 1);
+
+    // 批量窃取的中转缓冲区，在整个线程生命周期内复用
+    std::vector<InlineTask> stolen;
+    std::vector<DeadlineEntry> stolen_deadlines;
+
+    // 执行每个任务前指向该任务优先级的直方图，线程退出时恢复
+    detail::ScopedLatencySink latency_sink(nullptr);
+
+    // 任务的临时内存: 线程私有，每个任务结束后退回原位
+    WorkerArena arena;
+    detail::ScopedWorkerArena arena_sink(&arena);
+
+    // 空闲时的自旋/让出/休眠退避
+    IdleBackoff backoff(parker_);
+
+    // 防饥饿: 各级别被本 worker 连续越过的次数
+    LevelBypass bypass{};
+
+    while (!stop_.load(std::memory_order_acquire)) {
+        // 被 resize 退役: 如果在这之前又被扩容撤销了，就继续工作
+        if (states_[index].load(std::memory_order_acquire) !=
+            WorkerState::Running) {
+            WorkerState expected = WorkerState::Retiring;
+            if (states_[index].compare_exchange_strong(expected,
+                                                       WorkerState::Draining)) {
+                drain_worker(index);
+                states_[index].store(WorkerState::Stopped,
+                                     std::memory_order_release);
+                return;
+            }
+            continue;
+        }
+
+        InlineTask task;
+        bool found_task = false;
+        int task_level = 0;    // 任务所在的优先级，用于统计
+        bool has_deadline = false;    // 任务来自 EDF 堆
+        WorkerStatsSlot& counters = counters_[index];
+
+        // 1. Check Local Queue (EDF -> 最高的非空级别，开启防饥饿时低级别可能被提前)
+        //    共享通道和本地队列一起参与级别选择，同一级别先取共享通道；
+        //    通道被别人抢先取空时换下一个级别，自己还有任务就不去偷。
+        //    位图为 0 时不加锁: 漏掉的并发提交会在休眠前的再检查中被发现
+        uint64_t lanes = pending_lanes();
+        WorkQueue& own = *queues_[index];
+        if (own.nonempty.load(std::memory_order_relaxed) != 0) {
+            std::lock_guard<std::mutex> lock(own.mtx);
+            uint64_t mask = own.nonempty.load(std::memory_order_relaxed);
+            if (mask & kDeadlineBit) {
+                task = std::move(pop_deadline(own).task);
+                has_deadline = true;
+                found_task = true;
+            } else {
+                found_task = take_level(&own, (mask >> 1) | lanes, bypass,
+                                        counters, task, task_level);
+            }
+        } else {
+            found_task =
+                take_level(nullptr, lanes, bypass, counters, task, task_level);
+        }
+
+        // 2. Work Stealing (Most Urgent Victim + Priority + Steal-Half)
+        if (!found_task) {
+            int stolen_level = 0;
+            size_t num_queues = active_.load(std::memory_order_acquire);
+            size_t start_index = dist(rng) % num_queues;    // 随机起始点
+
+            // 不加锁地扫一遍位图，选出最紧迫的受害者 (countr_zero 最小)；
+            // 同样紧迫的多个受害者中取随机起始点之后的第一个，分散窃取者
+            size_t victim_idx = num_queues;
+            int urgency = 64;
+            for (size_t i = 0; i < num_queues && urgency > 0; ++i) {
+                size_t target_idx = (start_index + i) % num_queues;
+                if (target_idx == index)
+                    continue;
+
+                uint64_t mask = queues_[target_idx]->nonempty.load(
+                    std::memory_order_relaxed);
+                if (mask != 0 && std::countr_zero(mask) < urgency) {
+                    urgency = std::countr_zero(mask);
+                    victim_idx = target_idx;
+                }
+            }
+
+            // 只锁选中的受害者 (所有队列都空时一把锁也不拿)；
+            // 位图是快照，加锁后还要按实际内容再选一次
+            if (victim_idx == num_queues) {
+                // 没有可偷的任务
+            } else if (queues_[victim_idx]->mtx.try_lock()) {
+                WorkQueue& victim = *queues_[victim_idx];
+                std::lock_guard<std::mutex> lock(victim.mtx, std::adopt_lock);
+                uint64_t victim_levels =
+                    victim.nonempty.load(std::memory_order_relaxed) >> 1;
+
+                // 最紧迫的先偷: EDF 堆顶的一半 (按截止时间从早到晚)
+                if (!victim.deadlines.empty()) {
+                    size_t take = std::min(steal_batch(),
+                                           (victim.deadlines.size() + 1) / 2);
+                    for (size_t k = 0; k < take; ++k) {
+                        stolen_deadlines.push_back(pop_deadline(victim));
+                    }
+                    has_deadline = true;
+                    found_task = true;
+                    counters.common.steals.add();
+                    counters.common.stolen.add(take);
+                } else if (int p = pick_level(victim_levels, bypass); p >= 0) {
+                    // 窃取优先级：偷最高的非空级别 (同样受防饥饿策略约束)
+                    auto& level = victim.queues[p];
+                    // 优化：从尾部窃取 (Steal from back) 以减少与 Owner (pop_front) 的竞争
+                    // 实现了 deque 的两端访问：Owner 取头，Thief 取尾。
+                    // Steal-Half: 一次加锁搬走尾部的一半，stolen 中是从新到旧的顺序
+                    size_t take =
+                        std::min(steal_batch(), (level.size() + 1) / 2);
+                    for (size_t k = 0; k < take; ++k) {
+                        stolen.push_back(std::move(level.back()));
+                        level.pop_back();
+                    }
+                    publish(victim, level_bit(p), !level.empty());
+                    charge_level(victim_levels, p, bypass, counters);
+                    stolen_level = p;
+                    found_task = true;
+                    counters.common.steals.add();
+                    counters.common.stolen.add(take);
+                }
+            } else {
+                counters.common.lock_misses.add();
+            }
+
+            if (found_task && has_deadline) {
+                // 截止时间最早的马上执行，其余放进自己的 EDF 堆 (保留原来的截止时间)
+                task = std::move(stolen_deadlines.front().task);
+                if (stolen_deadlines.size() > 1) {
+                    {
+                        std::lock_guard<std::mutex> lock(own.mtx);
+                        for (size_t k = 1; k < stolen_deadlines.size(); ++k) {
+                            push_deadline(own, std::move(stolen_deadlines[k]));
+                        }
+                    }
+                    parker_.notify();
+                }
+                stolen_deadlines.clear();
+            } else if (found_task) {
+                // 最旧的一个马上执行，其余按原顺序放进自己同一优先级的队列。
+                // 先释放受害者的锁再锁自己的队列，两把锁从不同时持有，不会死锁。
+                task = std::move(stolen.back());
+                stolen.pop_back();
+                task_level = stolen_level;
+                if (!stolen.empty()) {
+                    {
+                        std::lock_guard<std::mutex> lock(own.mtx);
+                        for (size_t k = stolen.size(); k-- > 0;) {
+                            own.queues[stolen_level].push_back(
+                                std::move(stolen[k]));
+                        }
+                        publish(own, level_bit(stolen_level), true);
+                    }
+                    stolen.clear();
+                    parker_.notify();    // 我们这里也有富余了，叫醒一个休眠者来偷
+                }
+            } else {
+                counters.common.steal_failures.add();
+            }
+        }
+
+        // 3. Execute or Sleep
+        if (found_task) {
+            backoff.reset();
+            // 截止时间任务不带提交时刻，不记录延迟
+            detail::tls_latency_sink =
+                has_deadline ? nullptr : &latency_[index][task_level];
+            {
+                ArenaScope arena_scope(&arena);
+                task();
+            }
+            counters.common.executed.add();
+            if (has_deadline) {
+                counters.deadline_executed.add();
+            } else {
+                counters.executed[task_level].add();
+            }
+        } else {
+            // 按空闲策略先自旋 / 让出一会儿，回到循环开头重新扫描
+            if (backoff.next(idle_policy()) == IdleBackoff::Action::Retry) {
+                continue;
+            }
+
+            // -----------------------------------------------------------
+            // 阶段 3: 休眠等待 (Sleep)
+            // -----------------------------------------------------------
+            // 如果本地队列为空，且窃取也失败了，说明当前系统负载较轻。
+            // 为了避免忙等待 (Busy Waiting) 烧满 CPU，线程需要进入休眠状态。
+
+            // 1. 登记为休眠者 (两阶段休眠的第一阶段)
+            // 从这一刻起，任何新的 submit 都一定会看到我们并发起唤醒。
+            uint32_t key = parker_.prepare_park();
+
+            // 2. Double-Check
+            // 登记之后再检查一次 stop_ 和所有队列，防止"Lost Wakeup"问题：
+            // 任务或停止信号可能恰好在我们登记之前到达，那时提交者认为没人在睡，不会唤醒。
+            if (stop_.load(std::memory_order_acquire)) {
+                parker_.cancel_park();
+                break;
+            }
+            if (states_[index].load(std::memory_order_acquire) !=
+                    WorkerState::Running ||
+                has_pending_work()) {
+                parker_.cancel_park();
+                continue;
+            }
+
+            // 3. futex 休眠，直到被 notify
+            // 协议本身不会丢失唤醒，所以不再需要 10ms 超时作为“保底”，
+            // 空闲的线程池不会周期性地醒来空转。
+            auto park_start = std::chrono::steady_clock::now();
+            parker_.park(key);
+            counters.common.record_park(park_start);
+        }
+    }
+}
+
+template <size_t Levels>
+void BasicThreadPoolPriority<Levels>::reserved_worker_thread(size_t index) {
+    // 不登记为本池的 worker: 没有自己的队列，任务内部的提交走外部提交者的路径
+    apply_thread_sched(classes_.reserved_sched);
+
+    detail::ScopedLatencySink latency_sink(&reserved_latency_[index]);
+    WorkerArena arena;
+    detail::ScopedWorkerArena arena_sink(&arena);
+    IdleBackoff backoff(reserved_parker_);
+    WorkerStatsSlot& counters = reserved_counters_[index];
+
+    while (!stop_.load(std::memory_order_acquire)) {
+        InlineTask task;
+        if (take_urgent(index, task, counters)) {
+            backoff.reset();
+            {
+                ArenaScope arena_scope(&arena);
+                task();
+            }
+            counters.common.executed.add();
+            counters.executed[0].add();
+            continue;
+        }
+
+        if (backoff.next(idle_policy()) == IdleBackoff::Action::Retry) {
+            continue;
+        }
+
+        // 与普通 worker 相同的两阶段休眠，只是登记在 reserved_parker_ 上
+        uint32_t key = reserved_parker_.prepare_park();
+        if (stop_.load(std::memory_order_acquire)) {
+            reserved_parker_.cancel_park();
+            break;
+        }
+        if (has_urgent_work()) {
+            reserved_parker_.cancel_park();
+            continue;
+        }
+        auto park_start = std::chrono::steady_clock::now();
+        reserved_parker_.park(key);
+        counters.common.record_park(park_start);
+    }
+}
+
+template <size_t Levels>
+void BasicThreadPoolPriority<Levels>::drain_worker(size_t index) {
+    // 1. 关闭队列并取出所有剩余任务: 之后的外部提交者会换一个队列
+    std::vector<InlineTask> leftover[Levels];
+    std::vector<DeadlineEntry> leftover_deadlines;
+    {
+        WorkQueue& queue = *queues_[index];
+        std::lock_guard<std::mutex> lock(queue.mtx);
+        queue.retired = true;
+        leftover_deadlines.swap(queue.deadlines);
+        for (size_t p = 0; p < Levels; ++p) {
+            auto& level = queue.queues[p];
+            while (!level.empty()) {
+                leftover[p].push_back(std::move(level.front()));
+                level.pop_front();
+            }
+        }
+        queue.nonempty.store(0, std::memory_order_relaxed);
+    }
+
+    // 2. 不再是 worker: 以外部提交者的身份按原优先级转交，并唤醒活跃的 worker
+    detail::tls_priority_worker = {};
+    for (DeadlineEntry& entry : leftover_deadlines) {
+        push_deadline_task(entry.deadline, std::move(entry.task));
+    }
+    for (size_t p = 0; p < Levels; ++p) {
+        if (!leftover[p].empty()) {
+            enqueue_bulk(static_cast<Priority>(p), leftover[p].size(),
+                         [&](size_t i) -> InlineTask&& {
+                             return std::move(leftover[p][i]);
+                         });
+        }
+    }
 }
 
 }    // namespace parallel
@@ -0,0 +1,57 @@
+#include "thread_sched.h"
+
+#include <algorithm>
+
+#include "cpu_topology.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace parallel {
+
+AppliedSched apply_thread_sched(const ThreadSchedParams& params) {
+    AppliedSched applied;
+#ifdef __linux__
+    if (params.realtime_priority > 0) {
+        sched_param param{};
+        param.sched_priority = params.realtime_priority;
+        applied.realtime =
+            pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+    }
+
+    // SCHED_FIFO 线程不看 nice 值，只有没切换成实时调度时才设置。
+    // Linux 上 nice 是线程级别的: 以线程 id 作为 PRIO_PROCESS 的参数
+    if (!applied.realtime && params.nice != 0) {
+        applied.nice = setpriority(PRIO_PROCESS,
+                                   static_cast<id_t>(gettid()),
+                                   params.nice) == 0;
+    }
+
+    if (!params.cpus.empty()) {
+        // 只在允许的范围内收窄，不尝试越过 cgroup 的限制 (那样会直接失败)
+        std::vector<int> allowed = allowed_cpus();
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        bool any = false;
+        for (int cpu : params.cpus) {
+            if (std::find(allowed.begin(), allowed.end(), cpu) !=
+                allowed.end()) {
+                CPU_SET(cpu, &set);
+                any = true;
+            }
+        }
+        applied.affinity =
+            any && pthread_setaffinity_np(pthread_self(), sizeof(set),
+                                          &set) == 0;
+    }
+#else
+    (void)params;
+#endif
+    return applied;
+}
+
+}    // namespace parallel
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+
+namespace parallel {
+
+/**
+ * @brief 一个 worker 线程的操作系统调度参数 (Linux)
+ *
+ * 默认值表示什么都不改。各项互相独立，失败的项保持原样，不影响其他项。
+ */
+struct ThreadSchedParams {
+    // SCHED_FIFO 优先级 (1..99)，0 表示不使用实时调度。
+    // 没有权限 (CAP_SYS_NICE / RLIMIT_RTPRIO) 时退回到下面的 nice 值
+    int realtime_priority = 0;
+
+    // nice 值 (-20..19)，0 表示不修改。降低 nice (提高优先级) 同样需要权限
+    int nice = 0;
+
+    // 允许运行的逻辑 CPU，空表示不限制。先与线程当前允许的 CPU 取交集
+    // (cgroup cpuset 或 taskset 的限制)，交集为空时不修改亲和性
+    std::vector<int> cpus;
+};
+
+// apply_thread_sched 实际生效的项
+struct AppliedSched {
+    bool realtime = false;
+    bool nice = false;
+    bool affinity = false;
+};
+
+// 把调度参数应用到当前线程。不支持的平台上什么都不做
+AppliedSched apply_thread_sched(const ThreadSchedParams& params);
+
+}    // namespace parallel
@@ -0,0 +1,361 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+#include <stdexcept>
+
+namespace parallel {
+
+TimerWheel::TimerWheel(uint64_t now) : current_(now) { heads_.fill(kNil); }
+
+TimerWheel::~TimerWheel() = default;
+
+uint32_t TimerWheel::allocate() {
+    if (free_head_ != kNil) {
+        uint32_t index = free_head_;
+        free_head_ = node(index).next;
+        return index;
+    }
+    if (allocated_ == kNil) {
+        throw std::length_error("too many pending timers");
+    }
+    if ((allocated_ >> kChunkBits) == chunks_.size()) {
+        chunks_.push_back(std::make_unique<Node[]>(size_t{1} << kChunkBits));
+    }
+    return allocated_++;
+}
+
+void TimerWheel::release(uint32_t index) {
+    Node& n = node(index);
+    n.task.reset();
+    n.periodic.reset();
+    n.bucket = kNoBucket;
+    if (++n.generation == 0) {
+        n.generation = 1;    // 编号永远不为 0 (kInvalidTimer)
+    }
+    n.next = free_head_;
+    free_head_ = index;
+}
+
+TimerId TimerWheel::add(uint64_t expires, uint32_t tag, InlineTask task) {
+    uint32_t index = allocate();
+    Node& n = node(index);
+    n.task = std::move(task);
+    n.expires = expires;
+    n.period = 0;
+    n.tag = tag;
+    place(index);
+    ++size_;
+    return (uint64_t{n.generation} << 32) | index;
+}
+
+TimerId TimerWheel::add_periodic(uint64_t first, uint64_t period,
+                                 uint32_t tag,
+                                 std::shared_ptr<detail::PeriodicBody> body) {
+    uint32_t index = allocate();
+    Node& n = node(index);
+    n.periodic = std::move(body);
+    n.expires = first;
+    n.period = std::max<uint64_t>(period, 1);
+    n.tag = tag;
+    place(index);
+    ++size_;
+    return (uint64_t{n.generation} << 32) | index;
+}
+
+bool TimerWheel::cancel(TimerId id, InlineTask& removed) {
+    uint32_t index = static_cast<uint32_t>(id);
+    uint32_t generation = static_cast<uint32_t>(id >> 32);
+    if (index >= allocated_) {
+        return false;
+    }
+    Node& n = node(index);
+    if (n.generation != generation || n.bucket == kNoBucket) {
+        return false;
+    }
+    unlink(index);
+    removed = std::move(n.task);
+    if (n.periodic) {
+        n.periodic->cancelled.store(true, std::memory_order_release);
+    }
+    release(index);
+    --size_;
+    return true;
+}
+
+void TimerWheel::place(uint32_t index) {
+    Node& n = node(index);
+    // 已经过去的 tick 放进当前槽，下一次 advance 就会执行
+    uint64_t expires = std::max(n.expires, current_);
+    uint64_t delta = expires - current_;
+
+    int level = 0;
+    while (level < kLevels - 1 &&
+           delta >= (uint64_t{1} << (kSlotBits * (level + 1)))) {
+        ++level;
+    }
+    if (delta >= (uint64_t{1} << (kSlotBits * kLevels))) {
+        // 超出整个时间轮的范围: 先放在最顶层最远的槽，cascade 时再按剩余时间分层
+        expires = current_ + (uint64_t{1} << (kSlotBits * kLevels)) - 1;
+    }
+    size_t slot = (expires >> (kSlotBits * level)) & kSlotMask;
+    size_t bucket = static_cast<size_t>(level) * kSlots + slot;
+
+    n.bucket = static_cast<uint16_t>(bucket);
+    n.prev = kNil;
+    n.next = heads_[bucket];
+    if (n.next != kNil) {
+        node(n.next).prev = index;
+    }
+    heads_[bucket] = index;
+    occupied_[level][slot / 64] |= uint64_t{1} << (slot % 64);
+    ++level_size_[level];
+}
+
+void TimerWheel::unlink(uint32_t index) {
+    Node& n = node(index);
+    size_t bucket = n.bucket;
+    if (n.prev != kNil) {
+        node(n.prev).next = n.next;
+    } else {
+        heads_[bucket] = n.next;
+    }
+    if (n.next != kNil) {
+        node(n.next).prev = n.prev;
+    }
+    size_t level = bucket / kSlots;
+    size_t slot = bucket % kSlots;
+    if (heads_[bucket] == kNil) {
+        occupied_[level][slot / 64] &= ~(uint64_t{1} << (slot % 64));
+    }
+    --level_size_[level];
+    n.bucket = kNoBucket;
+}
+
+uint32_t TimerWheel::take_bucket(size_t bucket) {
+    uint32_t head = heads_[bucket];
+    size_t level = bucket / kSlots;
+    size_t slot = bucket % kSlots;
+    heads_[bucket] = kNil;
+    occupied_[level][slot / 64] &= ~(uint64_t{1} << (slot % 64));
+    for (uint32_t i = head; i != kNil; i = node(i).next) {
+        node(i).bucket = kNoBucket;
+        --level_size_[level];
+    }
+    return head;
+}
+
+void TimerWheel::fire_current(std::vector<std::vector<InlineTask>>& out) {
+    for (uint32_t i = take_bucket(current_ & kSlotMask); i != kNil;) {
+        Node& n = node(i);
+        uint32_t next = n.next;
+        if (n.periodic) {
+            // 上一次还在执行 (或者还在队列里) 时跳过这个周期
+            if (!n.periodic->running.exchange(true,
+                                              std::memory_order_acq_rel)) {
+                out[n.tag].push_back(detail::PeriodicFire{n.periodic});
+            }
+            n.expires += n.period;
+            if (n.expires <= current_) {
+                n.expires = current_ + n.period;    // 落后太多: 不补发
+            }
+            place(i);
+        } else {
+            out[n.tag].push_back(std::move(n.task));
+            release(i);
+            --size_;
+        }
+        i = next;
+    }
+}
+
+void TimerWheel::advance(uint64_t now,
+                         std::vector<std::vector<InlineTask>>& out) {
+    while (current_ <= now) {
+        if (size_ == 0) {
+            current_ = now + 1;
+            return;
+        }
+        size_t index = current_ & kSlotMask;
+        if (index == 0) {
+            // 第 0 层转完一圈: 把上一层对应的槽重新分配到下面各层；
+            // 上一层也转完一圈时继续往上
+            for (int level = 1; level < kLevels; ++level) {
+                size_t slot = (current_ >> (kSlotBits * level)) & kSlotMask;
+                for (uint32_t i = take_bucket(level * kSlots + slot);
+                     i != kNil;) {
+                    uint32_t next = node(i).next;
+                    place(i);
+                    i = next;
+                }
+                if (slot != 0) {
+                    break;
+                }
+            }
+        } else if (level_size_[0] == 0) {
+            // 第 0 层是空的: 直接跳到下一次 cascade (或者 now 之后)
+            current_ = std::min(now + 1, (current_ | kSlotMask) + 1);
+            continue;
+        }
+        fire_current(out);
+        ++current_;
+    }
+}
+
+std::optional<uint64_t> TimerWheel::next_due() const {
+    if (size_ == 0) {
+        return std::nullopt;
+    }
+    uint64_t due = std::numeric_limits<uint64_t>::max();
+
+    // 第 0 层的定时器都在接下来的 kSlots 个 tick 内: 按位图找当前槽之后第一个非空槽
+    if (level_size_[0] > 0) {
+        size_t start = current_ & kSlotMask;
+        size_t step = 0;
+        while (step < kSlots) {
+            size_t slot = (start + step) & kSlotMask;
+            uint64_t word = occupied_[0][slot / 64] >> (slot % 64);
+            if (word != 0) {
+                step += static_cast<size_t>(std::countr_zero(word));
+                break;
+            }
+            step += 64 - slot % 64;    // 跳到下一个字
+        }
+        due = current_ + step;
+    }
+
+    // 上层的定时器要等下一次 cascade 才会落到第 0 层
+    if (size_ > level_size_[0]) {
+        due = std::min(due, (current_ + kSlotMask) & ~kSlotMask);
+    }
+    return due;
+}
+
+void TimerWheel::rebase(uint64_t now) {
+    if (size_ == 0) {
+        current_ = std::max(current_, now);
+    }
+}
+
+TimerService::TimerService(uint32_t tags, Dispatch dispatch,
+                           TimerClock::duration tick)
+    : tags_(std::max<uint32_t>(tags, 1)),
+      dispatch_(std::move(dispatch)),
+      tick_ns_(static_cast<uint64_t>(std::max<int64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(tick).count(),
+          1))),
+      wheel_(now_tick()),
+      due_(tags_) {}
+
+TimerService::~TimerService() { shutdown(); }
+
+uint64_t TimerService::due_tick(TimerClock::time_point when) const {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  when.time_since_epoch())
+                  .count();
+    uint64_t value = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+    return (value + tick_ns_ - 1) / tick_ns_;
+}
+
+uint64_t TimerService::now_tick() const {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  TimerClock::now().time_since_epoch())
+                  .count();
+    return (ns > 0 ? static_cast<uint64_t>(ns) : 0) / tick_ns_;
+}
+
+void TimerService::start_or_wake(uint64_t expires) {
+    if (!thread_.joinable()) {
+        thread_ = std::thread([this] { run(); });
+    } else if (expires < wake_tick_) {
+        cv_.notify_one();
+    }
+}
+
+TimerId TimerService::add(TimerClock::time_point when, uint32_t tag,
+                          InlineTask task) {
+    uint64_t expires = due_tick(when);
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (stop_) {
+        return kInvalidTimer;
+    }
+    wheel_.rebase(now_tick());
+    TimerId id = wheel_.add(expires, std::min(tag, tags_ - 1), std::move(task));
+    start_or_wake(expires);
+    return id;
+}
+
+TimerId TimerService::add_periodic(TimerClock::duration period, uint32_t tag,
+                                   InlineTask fn) {
+    auto body = std::make_shared<detail::PeriodicBody>(std::move(fn));
+    uint64_t ticks = due_tick(TimerClock::time_point(period));
+    uint64_t expires = due_tick(TimerClock::now() + period);
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (stop_) {
+        return kInvalidTimer;
+    }
+    wheel_.rebase(now_tick());
+    TimerId id = wheel_.add_periodic(expires, ticks, std::min(tag, tags_ - 1),
+                                     std::move(body));
+    start_or_wake(expires);
+    return id;
+}
+
+bool TimerService::cancel(TimerId id) {
+    InlineTask removed;    // 在锁外析构 (被丢弃的 Promise 可能触发 then() 回调)
+    std::lock_guard<std::mutex> lock(mtx_);
+    return wheel_.cancel(id, removed);
+}
+
+size_t TimerService::pending() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return wheel_.size();
+}
+
+void TimerService::shutdown() {
+    TimerWheel dropped;
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+        std::swap(dropped, wheel_);
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void TimerService::run() {
+    std::unique_lock<std::mutex> lock(mtx_);
+    while (!stop_) {
+        wheel_.advance(now_tick(), due_);
+
+        if (std::any_of(due_.begin(), due_.end(),
+                        [](const auto& tasks) { return !tasks.empty(); })) {
+            // 到期的任务在锁外整批交出，期间的 add / cancel 不会被阻塞
+            wake_tick_ = 0;
+            lock.unlock();
+            for (uint32_t tag = 0; tag < tags_; ++tag) {
+                if (!due_[tag].empty()) {
+                    dispatch_(tag, due_[tag]);
+                    due_[tag].clear();
+                }
+            }
+            lock.lock();
+            continue;
+        }
+
+        std::optional<uint64_t> next = wheel_.next_due();
+        wake_tick_ = next.value_or(UINT64_MAX);
+        if (next) {
+            auto wake = TimerClock::time_point(
+                std::chrono::nanoseconds(*next * tick_ns_));
+            cv_.wait_until(lock, wake);
+        } else {
+            cv_.wait(lock);
+        }
+    }
+}
+
+}    // namespace parallel
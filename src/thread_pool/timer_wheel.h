@@ -0,0 +1,217 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "inline_task.h"
+
+namespace parallel {
+
+// 定时任务使用的时钟 (与 Deadline / latency_now 相同的单调时钟)
+using TimerClock = std::chrono::steady_clock;
+
+// 定时器编号: post_after / submit_every 返回，cancel_timer 用它取消。0 不是有效编号
+using TimerId = uint64_t;
+
+inline constexpr TimerId kInvalidTimer = 0;
+
+namespace detail {
+
+// submit_every 的任务体: 每个周期由定时器线程投递一次 PeriodicFire
+struct PeriodicBody {
+    explicit PeriodicBody(InlineTask f) : fn(std::move(f)) {}
+
+    InlineTask fn;
+    std::atomic<bool> running{false};      // 上一次还没执行完时跳过这个周期
+    std::atomic<bool> cancelled{false};    // 已经投递、还没开始的那一次也不再执行
+};
+
+struct PeriodicFire {
+    std::shared_ptr<PeriodicBody> body;
+
+    void operator()() {
+        if (!body->cancelled.load(std::memory_order_acquire)) {
+            body->fn();
+        }
+        body->running.store(false, std::memory_order_release);
+    }
+};
+
+}    // namespace detail
+
+// shared_ptr 只是两个指针，按字节搬走不影响引用计数
+template <>
+struct is_trivially_relocatable<detail::PeriodicFire> : std::true_type {};
+
+/**
+ * @brief 分层时间轮 (Hierarchical Timing Wheel)，单位是 tick，本身不加锁
+ *
+ * **结构**:
+ * - 4 层，每层 256 个槽。第 0 层的槽对应接下来的 256 个 tick，第 k 层的槽覆盖 256^k 个 tick，
+ *   合起来覆盖 2^32 个 tick (1ms 的 tick 约 49 天)，更远的定时器先放在最顶层，到时再重新分层。
+ * - 每个槽是一个侵入式双向链表，节点按块分配、用空闲链表复用，于是插入和取消都是 O(1)，
+ *   也没有逐个定时器的堆分配。
+ * - 第 0 层每转完一圈，把上一层的一个槽重新分配到下面各层 (cascade)；到期检查只看当前槽。
+ *
+ * **编号**: 节点下标 + 代数。节点回收时代数加一，过期的编号不会取消到复用后的定时器。
+ */
+class TimerWheel {
+   public:
+    static constexpr int kLevels = 4;
+    static constexpr int kSlotBits = 8;
+    static constexpr size_t kSlots = size_t{1} << kSlotBits;
+
+    // now: 下一个要处理的 tick
+    explicit TimerWheel(uint64_t now = 0);
+    ~TimerWheel();
+
+    TimerWheel(TimerWheel&&) noexcept = default;
+    TimerWheel& operator=(TimerWheel&&) noexcept = default;
+
+    // 在第 expires 个 tick 执行 task (已经过去的 tick 按下一个 tick 处理)，任务投递到 out[tag]
+    TimerId add(uint64_t expires, uint32_t tag, InlineTask task);
+
+    // 从第 first 个 tick 开始，每 period 个 tick 投递一次 body (period 为 0 按 1 处理)
+    TimerId add_periodic(uint64_t first, uint64_t period, uint32_t tag,
+                         std::shared_ptr<detail::PeriodicBody> body);
+
+    /**
+     * @brief 取消还没到期的定时器
+     * @param removed 收到被取消的一次性任务，由调用者在锁外析构
+     * @return 编号无效、已经到期 (一次性) 或已取消时返回 false
+     */
+    bool cancel(TimerId id, InlineTask& removed);
+
+    /**
+     * @brief 处理直到第 now 个 tick (含) 的所有槽，到期的任务按 tag 追加到 out
+     *
+     * 周期任务按原来的节奏重新插入；落后超过一个周期时不补发，从下一个 tick 重新计算。
+     */
+    void advance(uint64_t now, std::vector<std::vector<InlineTask>>& out);
+
+    // 下一个需要处理的 tick 的下界 (也可能是下一次 cascade 的时刻)，没有定时器时为空
+    std::optional<uint64_t> next_due() const;
+
+    // 空的时间轮直接跳到 now，之后的插入按新的时刻分层
+    void rebase(uint64_t now);
+
+    size_t size() const { return size_; }
+
+   private:
+    static constexpr uint32_t kNil = UINT32_MAX;
+    static constexpr uint16_t kNoBucket = UINT16_MAX;
+    static constexpr size_t kChunkBits = 12;    // 每块 4096 个节点
+    static constexpr uint64_t kSlotMask = kSlots - 1;
+
+    struct Node {
+        InlineTask task;
+        std::shared_ptr<detail::PeriodicBody> periodic;    // 周期任务才有
+        uint64_t expires = 0;
+        uint64_t period = 0;
+        uint32_t prev = kNil;
+        uint32_t next = kNil;    // 所在槽的链表，空闲时是空闲链表
+        uint32_t generation = 1;
+        uint32_t tag = 0;
+        uint16_t bucket = kNoBucket;    // level * kSlots + slot，不在时间轮里时为 kNoBucket
+    };
+
+    Node& node(uint32_t index) {
+        return chunks_[index >> kChunkBits][index & ((1u << kChunkBits) - 1)];
+    }
+
+    uint32_t allocate();
+    void release(uint32_t index);
+
+    // 按 expires 与 current_ 的距离选择层和槽，挂到链表头
+    void place(uint32_t index);
+    void unlink(uint32_t index);
+
+    // 取走整个槽的链表，返回链表头
+    uint32_t take_bucket(size_t bucket);
+
+    // 处理第 0 层 current_ 对应的槽
+    void fire_current(std::vector<std::vector<InlineTask>>& out);
+
+    std::vector<std::unique_ptr<Node[]>> chunks_;
+    uint32_t allocated_ = 0;    // 已经用过的节点下标上界
+    uint32_t free_head_ = kNil;
+    size_t size_ = 0;
+
+    uint64_t current_;
+    std::array<uint32_t, kLevels * kSlots> heads_;
+    // 每层一个槽非空位图，next_due 用它跳过空槽
+    std::array<std::array<uint64_t, kSlots / 64>, kLevels> occupied_{};
+    std::array<size_t, kLevels> level_size_{};
+};
+
+/**
+ * @brief 定时器线程: 持有一个 TimerWheel，到期的任务按 tag 整批交给 dispatch
+ *
+ * 第一次添加定时器时才启动线程。线程只在下一个可能到期的 tick 醒来 (没有定时器时一直等待)，
+ * dispatch 在锁外调用，同一个 tag 一次到期的任务一起交出，由线程池整批放进 worker 队列。
+ */
+class TimerService {
+   public:
+    // tag: add 时指定的分组 (例如优先级)，due 中的任务被取走后由 TimerService 清空
+    using Dispatch =
+        std::function<void(uint32_t tag, std::vector<InlineTask>& due)>;
+
+    TimerService(uint32_t tags, Dispatch dispatch,
+                 TimerClock::duration tick = std::chrono::milliseconds(1));
+    ~TimerService();
+
+    TimerService(const TimerService&) = delete;
+    TimerService& operator=(const TimerService&) = delete;
+
+    // 在 when 之后把 task 交给 dispatch。已经 shutdown 时丢弃任务并返回 kInvalidTimer
+    TimerId add(TimerClock::time_point when, uint32_t tag, InlineTask task);
+
+    // 每隔 period 交出一次 fn (第一次在 period 之后)，上一次还没执行完时跳过该周期
+    TimerId add_periodic(TimerClock::duration period, uint32_t tag,
+                         InlineTask fn);
+
+    // 取消定时器: 一次性任务被丢弃，周期任务不再投递
+    bool cancel(TimerId id);
+
+    // 还没到期的定时器数 (周期任务算一个)
+    size_t pending() const;
+
+    // 停止定时器线程并丢弃所有未到期的任务 (析构时自动调用，可以重复调用)
+    void shutdown();
+
+   private:
+    void run();
+
+    // 时刻换算成 tick: 到期时刻向上取整，当前时刻向下取整，保证不会提前执行
+    uint64_t due_tick(TimerClock::time_point when) const;
+    uint64_t now_tick() const;
+
+    // 新定时器比定时器线程计划醒来的时刻更早时叫醒它 (调用者持有 mtx_)
+    void start_or_wake(uint64_t expires);
+
+    const uint32_t tags_;
+    const Dispatch dispatch_;
+    const uint64_t tick_ns_;
+
+    mutable std::mutex mtx_;
+    std::condition_variable cv_;
+    TimerWheel wheel_;
+    uint64_t wake_tick_ = UINT64_MAX;    // 定时器线程计划醒来的 tick
+    bool stop_ = false;
+    std::thread thread_;
+
+    // 只由定时器线程在锁外使用
+    std::vector<std::vector<InlineTask>> due_;
+};
+
+}    // namespace parallel
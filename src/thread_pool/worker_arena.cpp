@@ -0,0 +1,48 @@
+#include "worker_arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace parallel {
+
+size_t WorkerArena::used() const noexcept {
+    size_t bytes = offset_;
+    for (size_t i = 0; i < current_ && i < blocks_.size(); ++i) {
+        bytes += blocks_[i].size;
+    }
+    return bytes;
+}
+
+size_t WorkerArena::reserved() const noexcept {
+    size_t bytes = 0;
+    for (const Block& block : blocks_) {
+        bytes += block.size;
+    }
+    return bytes;
+}
+
+void* WorkerArena::do_allocate(size_t bytes, size_t alignment) {
+    for (;;) {
+        // 在已有的块里找位置: 当前块放不下就换下一块 (rewind 之后后面的块都是空的)
+        for (; current_ < blocks_.size(); ++current_, offset_ = 0) {
+            Block& block = blocks_[current_];
+            auto base = reinterpret_cast<uintptr_t>(block.data.get());
+            size_t start =
+                ((base + offset_ + alignment - 1) & ~(alignment - 1)) - base;
+            if (start <= block.size && bytes <= block.size - start) {
+                offset_ = start + bytes;
+                return block.data.get() + start;
+            }
+        }
+
+        // 所有块都用完了: 追加一块，大小翻倍 (至少放得下这次请求)
+        size_t size = blocks_.empty() ? block_size_ : blocks_.back().size * 2;
+        size = std::max(size, bytes + alignment);
+        blocks_.push_back(
+            {std::make_unique_for_overwrite<std::byte[]>(size), size});
+        current_ = blocks_.size() - 1;
+        offset_ = 0;
+    }
+}
+
+}    // namespace parallel
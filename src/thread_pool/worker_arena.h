@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+namespace parallel {
+
+/**
+ * @brief worker 私有的单调 (bump) 内存区，供正在执行的任务分配临时对象
+ *
+ * **问题**: 任务里的临时容器 (vector / string / map) 都向全局堆申请内存，
+ * 多个 worker 同时 malloc/free 会争抢分配器的锁和缓存行。
+ *
+ * **做法**:
+ * 1.  每个 worker 线程拥有一个 arena，任务通过 `current_worker_arena()` 拿到它。
+ *     它是一个 `std::pmr::memory_resource`，可以直接交给 `std::pmr::vector` 等容器。
+ * 2.  分配只是在当前内存块里推进偏移量；`deallocate` 什么也不做。
+ * 3.  线程池在每个任务开始前记下位置 (`checkpoint`)，任务结束后退回去 (`rewind`)，
+ *     整个任务用到的内存一次性“释放”。嵌套执行的任务 (help_until_ready 等) 退回到的是
+ *     自己开始时的位置，不会覆盖外层任务的数据。
+ * 4.  内存块不归还: 用满后按两倍大小追加新块，之后一直复用。稳态下不触发任何堆分配。
+ *
+ * 从 arena 分配的内存只在当前任务返回之前有效，不要把它交给其他任务或保存到任务之外。
+ * 不是线程安全的，只能在所属 worker 线程上使用。
+ */
+class WorkerArena final : public std::pmr::memory_resource {
+   public:
+    static constexpr size_t kDefaultBlockSize = 64 * 1024;
+
+    // 分配位置: 第几个内存块的第几个字节
+    struct Checkpoint {
+        size_t block = 0;
+        size_t offset = 0;
+    };
+
+    // 第一个内存块在第一次分配时才申请，从不使用 arena 的 worker 没有额外开销
+    explicit WorkerArena(size_t block_size = kDefaultBlockSize)
+        : block_size_(block_size == 0 ? kDefaultBlockSize : block_size) {}
+
+    WorkerArena(const WorkerArena&) = delete;
+    WorkerArena& operator=(const WorkerArena&) = delete;
+
+    Checkpoint checkpoint() const noexcept { return {current_, offset_}; }
+
+    // 退回到之前的位置: 之后分配的内存全部作废 (内存块保留，下次复用)
+    void rewind(Checkpoint mark) noexcept {
+        current_ = mark.block;
+        offset_ = mark.offset;
+    }
+
+    void reset() noexcept { rewind({}); }
+
+    // 从 reset 以来已经用掉的字节数 (包括对齐填充和跳过的块尾)
+    size_t used() const noexcept;
+
+    // 已经向堆申请的总字节数
+    size_t reserved() const noexcept;
+
+   private:
+    void* do_allocate(size_t bytes, size_t alignment) override;
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(
+        const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        size_t size;
+    };
+
+    size_t block_size_;
+    std::vector<Block> blocks_;
+    size_t current_ = 0;    // 正在分配的块
+    size_t offset_ = 0;     // 块内的下一个空闲字节
+};
+
+namespace detail {
+
+// 当前线程所属 worker 的 arena。由 worker 在启动时设置，其他线程为 nullptr
+inline thread_local WorkerArena* tls_worker_arena = nullptr;
+
+// worker 线程启动时安装自己的 arena，线程退出时恢复
+class ScopedWorkerArena {
+   public:
+    explicit ScopedWorkerArena(WorkerArena* arena) noexcept
+        : saved_(std::exchange(tls_worker_arena, arena)) {}
+    ~ScopedWorkerArena() { tls_worker_arena = saved_; }
+
+    ScopedWorkerArena(const ScopedWorkerArena&) = delete;
+    ScopedWorkerArena& operator=(const ScopedWorkerArena&) = delete;
+
+   private:
+    WorkerArena* saved_;
+};
+
+}    // namespace detail
+
+/**
+ * @brief 当前 worker 的 arena
+ * @return 不在 ThreadPoolFast / ThreadPoolPriority 的 worker 线程上时返回 nullptr
+ */
+inline WorkerArena* current_worker_arena() noexcept {
+    return detail::tls_worker_arena;
+}
+
+// 当前 worker 的 arena；不在 worker 线程上时退回到默认的堆内存资源
+inline std::pmr::memory_resource* current_memory_resource() noexcept {
+    if (WorkerArena* arena = current_worker_arena()) {
+        return arena;
+    }
+    return std::pmr::get_default_resource();
+}
+
+/**
+ * @brief 作用域结束时把 arena 退回到作用域开始时的位置
+ *
+ * 线程池用它包住每个任务；任务内部也可以用它更早地回收内存，
+ * 例如长循环的每一轮、或者每一组子任务之间。arena 为 nullptr 时什么也不做。
+ */
+class ArenaScope {
+   public:
+    explicit ArenaScope(WorkerArena* arena = current_worker_arena()) noexcept
+        : arena_(arena) {
+        if (arena_ != nullptr) {
+            mark_ = arena_->checkpoint();
+        }
+    }
+
+    ~ArenaScope() {
+        if (arena_ != nullptr) {
+            arena_->rewind(mark_);
+        }
+    }
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+   private:
+    WorkerArena* arena_;
+    WorkerArena::Checkpoint mark_;
+};
+
+}    // namespace parallel
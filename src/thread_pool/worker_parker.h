@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace parallel {
+
+/**
+ * @brief 空闲 worker 的休眠/唤醒器 (Event Count，基于 futex)
+ *
+ * **为什么不用 condition_variable + wait_for(10ms)**:
+ * 1.  定时轮询: 每个空闲线程每秒醒来 100 次，池子越大，空转的 CPU 越多。
+ * 2.  无条件 notify: 即使没有人在睡，每次 submit 也要付一次 notify 的开销。
+ * 3.  超时只是为了兜底“丢失唤醒”，本身说明协议不严密。
+ *
+ * **协议 (两阶段休眠)**:
+ * - worker: `prepare_park()` 登记为休眠者并读出 `epoch_` → 再检查一遍所有队列和停止标志
+ *   → 确实没事可做才 `park(key)`；发现有活就 `cancel_park()`。
+ * - 提交者: 先把任务放进队列，再 `notify(n)`。没有休眠者时只是一个 fence + 一次读，
+ *   **不进入内核**；有休眠者时推进 `epoch_` 并唤醒。
+ *
+ * **为什么不会丢失唤醒**: 双方都在“写自己的数据”与“读对方的数据”之间放了一个
+ * seq_cst 屏障 (worker: 登记休眠者 → 检查队列；提交者: 入队 → 读休眠者数量)。
+ * 两个屏障在全序 S 中总有先后: 要么 worker 的再检查能看到新任务，
+ * 要么提交者能看到 worker 已登记，从而推进 `epoch_`，使 `park(key)` 立即返回。
+ * 因此休眠不再需要超时。
+ */
+class WorkerParker {
+   public:
+    // [Worker] 第一阶段: 登记为休眠者，返回当前 epoch。之后调用者必须再检查一次是否有任务
+    uint32_t prepare_park() noexcept {
+        sleepers_.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return epoch_.load(std::memory_order_acquire);
+    }
+
+    // [Worker] 再检查时发现了任务 (或收到停止信号)，撤销登记
+    void cancel_park() noexcept {
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // [Worker] 第二阶段: 在 epoch 仍等于 key 时休眠 (Linux 上是 futex wait)
+    void park(uint32_t key) noexcept {
+        epoch_.wait(key, std::memory_order_acquire);
+        sleepers_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief [提交者] 任务入队之后调用，最多唤醒 count 个休眠者
+     *
+     * 快路径: 没有休眠者时直接返回，不触发任何系统调用。
+     */
+    void notify(size_t count = 1) noexcept {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        size_t sleepers = sleepers_.load(std::memory_order_relaxed);
+        if (sleepers == 0) {
+            return;
+        }
+        epoch_.fetch_add(1, std::memory_order_release);
+        if (count >= sleepers) {
+            epoch_.notify_all();
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                epoch_.notify_one();
+            }
+        }
+    }
+
+    // 无条件唤醒所有休眠者 (析构线程池时使用)
+    void notify_all() noexcept {
+        epoch_.fetch_add(1, std::memory_order_release);
+        epoch_.notify_all();
+    }
+
+    // 当前登记的休眠者数量 (仅供统计/测试，只是一个快照)
+    size_t sleepers() const noexcept {
+        return sleepers_.load(std::memory_order_relaxed);
+    }
+
+    // [Worker] 自旋等待的开始/结束 (见 IdleBackoff)。自旋者不需要唤醒，只计入空闲数
+    void begin_spinning() noexcept {
+        spinners_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void end_spinning() noexcept {
+        spinners_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    // 空闲的 worker 数量: 休眠者 + 自旋者 (快照)
+    size_t idle() const noexcept {
+        return sleepers_.load(std::memory_order_relaxed) +
+               spinners_.load(std::memory_order_relaxed);
+    }
+
+   private:
+    // 两个计数器分别被 worker 和提交者高频访问，放在不同的 Cache Line
+    alignas(64) std::atomic<uint32_t> epoch_{0};
+    alignas(64) std::atomic<size_t> sleepers_{0};
+    alignas(64) std::atomic<size_t> spinners_{0};
+};
+
+}    // namespace parallel